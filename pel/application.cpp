@@ -1,14 +1,27 @@
 #include "application.hpp"
 //
+#include <filesystem>
+#include <future>
+#include <optional>
+//
 #include "camera.hpp"
+#include "contour_hierarchy.hpp"
 #include "contours_shader.hpp"
 #include "flat_shader.hpp"
+#include "frame_capture.hpp"
+#include "illumination_worker.hpp"
+#include "image_space_lines.hpp"
+#include "line_renderer.hpp"
+#include "memory_usage.hpp"
+#include "mesh_clusters.hpp"
+#include "mesh_deformation.hpp"
 #include "model.hpp"
+#include "model_loader.hpp"
 #include "photic_extremum_lines.hpp"
 #include "photic_extremum_lines_shader.hpp"
+#include "scene.hpp"
 #include "shader.hpp"
 #include "silhouette_shader.hpp"
-#include "stl_loader.hpp"
 #include "toon_shader.hpp"
 #include "vertex_light_shader.hpp"
 #include "vertex_light_variation_shader.hpp"
@@ -40,18 +53,50 @@ float azimuth = 0;
 // Mouse Interaction
 vec2 old_mouse_pos;
 vec2 mouse_pos;
-bool view_should_update = true;
+
+// Dirty State
+// Every state change only marks the parts of the pipeline that depend on it.
+// 'update()' then does the minimal amount of work to bring them up to date.
+// Changing the threshold, for example, must not recompute the illumination.
+struct {
+  bool geometry = true;          // mesh buffers and illumination buffer layout
+  bool camera = true;            // view and projection matrices
+  bool light = true;             // light direction and illumination data
+  bool surface_uniforms = true;  // uniforms of the surface shader
+  bool line_uniforms = true;     // uniforms of the line and contour shaders
+} dirty;
 
 camera cam{};
 
 shader_program shader{};
 shader_program line_shader{};
 shader_program contour_shader{};
+// Segments emitted by the line and contour shaders are captured
+// and drawn as quads whose width does not depend on the driver.
+// Both get their own renderer because segment counts of a capture
+// are only used by later captures of the same renderer.
+line_renderer lines{};
+line_renderer contour_lines{};
+line_renderer::options line_options{};
+// Photic extremum lines are extracted per face or per pixel.
+// The comparison shows object space on the left
+// and image space on the right half of the window.
+enum class line_space { object, image, comparison };
+line_space pel_space = line_space::object;
+image_space_lines image_lines{};
 bool surface_shading_enabled = true;
+// The current surface shader visualizes the illumination data.
+bool surface_shows_illumination = false;
 bool pels_enabled = true;
 bool contours_enabled = true;
 model mesh{};
 
+// Background Loading
+model_loader loader{};
+bool loading = false;
+// Raw triangle soup shown until the prepared mesh is available
+model preview{};
+
 vec3 aabb_min{};
 vec3 aabb_max{};
 float bounding_radius;
@@ -60,6 +105,65 @@ vector<illumination_info> illumination_data{};
 vector<gradient_info> gradient_data{};
 vertex_buffer illumination_buffer;
 
+// Culling of the original mesh
+// Only clusters inside the view frustum are drawn and illuminated.
+// Contours are only drawn for clusters whose normal cone allows them.
+vector<mesh_cluster> clusters{};
+vertex_face_adjacency adjacency{};
+vector<uint32_t> visible_clusters{};
+size_t visible_faces = 0;
+model::face_ranges visible_ranges{};
+model::face_ranges contour_ranges{};
+// Clusters with valid data after the last request for the original mesh
+vector<bool> illuminated_clusters{};
+
+// Contours of the original mesh can alternatively be extracted on the CPU.
+// Only nodes of the hierarchy that may contain a contour are visited.
+contour_hierarchy contours{};
+bool cpu_contours_enabled = false;
+vector<vec3> contour_segments{};
+line_renderer contour_segment_lines{};
+
+// Coarser Levels of Detail
+// They are only used to compute the illumination data while orbiting.
+// Their results are prolonged to the original mesh which is always drawn.
+vector<mesh_level> coarse_levels{};
+// Levels are given by their index. Zero refers to the original mesh.
+size_t requested_level = 0;
+// While orbiting, the illumination data is computed on the finest level
+// whose estimated computation time does not exceed this budget in seconds.
+float illumination_time_budget = 1 / 60.0f;
+bool orbiting = false;
+// While orbiting, cached illumination data of nearby light directions
+// is interpolated instead of computing new data, if available.
+bool illumination_blending = true;
+// Jacobi sweeps that smooth the light field of noisy meshes
+size_t light_smoothing = 0;
+
+// Animation with fixed topology
+// Its frames are chosen by the elapsed time. Only vertices that moved
+// since the last frame are updated and uploaded. A new frame is only
+// applied when the illumination of the previous one has arrived.
+// So frames are skipped if the illumination lags behind.
+mesh_animation animation{};
+mesh_deformation deformation{};
+bool animation_playing = false;
+float animation_rate = 30;
+size_t animation_frame = 0;
+system_clock::time_point animation_start{};
+
+// Scene files describe assemblies of many meshes.
+// They replace the single mesh and are drawn without culling
+// and without coarser levels of detail.
+std::future<scene_description> scene_loader{};
+std::optional<scene> assembly{};
+
+// Rendered frames are written to numbered images while recording.
+std::optional<frame_capture> recording{};
+size_t recordings = 0;
+
+illumination_worker worker{};
+
 float threshold = 0.01;
 float threshold_shift = -1 / log(threshold);
 float line_shift = 0.001;
@@ -68,6 +172,26 @@ bool illumination_should_update = true;
 
 bool control_key_pressed = false;
 
+// 'draw' renders the geometry with the given program which is bound.
+void render_photic_extremum_lines(
+    const std::function<void(shader_program&)>& draw) {
+  const auto width = cam.screen_width();
+  const auto height = cam.screen_height();
+  const bool comparison = pel_space == line_space::comparison;
+  if (comparison) {
+    glEnable(GL_SCISSOR_TEST);
+    glScissor(0, 0, width / 2, height);
+  }
+  if (pel_space != line_space::image) {
+    lines.capture(line_shader, [&] { draw(line_shader); });
+    lines.render(cam, line_options);
+  }
+  if (comparison) glScissor(width / 2, 0, width - width / 2, height);
+  if (pel_space != line_space::object)
+    image_lines.render(cam, threshold, draw);
+  glDisable(GL_SCISSOR_TEST);
+}
+
 }  // namespace
 
 void init() {
@@ -86,8 +210,24 @@ void init() {
       surface_shading_enabled = !surface_shading_enabled;
     if ((key == GLFW_KEY_U) && (action == GLFW_PRESS))
       illumination_should_update = !illumination_should_update;
-
-    view_should_update = true;
+    if ((key == GLFW_KEY_K) && (action == GLFW_PRESS)) {
+      cpu_contours_enabled = !cpu_contours_enabled;
+      dirty.camera = true;
+    }
+    if ((key == GLFW_KEY_G) && (action == GLFW_PRESS)) {
+      pel_space = line_space((int(pel_space) + 1) % 3);
+      dirty.light = true;
+    }
+    if ((key == GLFW_KEY_B) && (action == GLFW_PRESS))
+      illumination_blending = !illumination_blending;
+    if ((key == GLFW_KEY_R) && (action == GLFW_PRESS)) toggle_recording();
+    if ((key == GLFW_KEY_M) && (action == GLFW_PRESS)) toggle_animation();
+    if ((key == GLFW_KEY_Y) && (action == GLFW_PRESS))
+      print_memory_report(cout);
+    if ((key == GLFW_KEY_RIGHT_BRACKET) && (action == GLFW_PRESS))
+      adjust_light_smoothing(1);
+    if ((key == GLFW_KEY_LEFT_BRACKET) && (action == GLFW_PRESS))
+      adjust_light_smoothing(-1);
   });
 
   glfwSetScrollCallback(window, [](GLFWwindow* window, double x, double y) {
@@ -113,6 +253,7 @@ void run() {
     process_events();
     update();
     render();
+    if (recording) recording->capture();
 
     glfwSwapBuffers(window);
   }
@@ -132,7 +273,6 @@ void setup() {
   // glClearColor(0.0, 0.5, 0.8, 1.0);
   glClearColor(1.0, 1.0, 1.0, 1.0);
   glPointSize(3.0f);
-  glLineWidth(2.5f);
 }
 
 void process_events() {
@@ -147,8 +287,8 @@ void process_events() {
   const auto mouse_move = mouse_pos - old_mouse_pos;
 
   // Left mouse button should rotate the camera by using spherical coordinates.
-  if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS)
-    turn(mouse_move);
+  orbiting = glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS;
+  if (orbiting) turn(mouse_move);
 
   // Right mouse button should translate the camera.
   if (glfwGetMouseButton(window, GLFW_MOUSE_BUTTON_RIGHT) == GLFW_PRESS)
@@ -160,68 +300,175 @@ void process_events() {
 
   if (glfwGetKey(window, GLFW_KEY_W) == GLFW_PRESS) {
     shader = wireframe_shader();
-    view_should_update = true;
+    set_surface_shader();
   }
   if (glfwGetKey(window, GLFW_KEY_V) == GLFW_PRESS) {
     shader = viewer_shader();
-    view_should_update = true;
+    set_surface_shader();
   }
   if (glfwGetKey(window, GLFW_KEY_T) == GLFW_PRESS) {
     shader = toon_shader();
-    view_should_update = true;
+    set_surface_shader();
   }
   if (glfwGetKey(window, GLFW_KEY_N) == GLFW_PRESS) {
     shader = white_shader();
-    view_should_update = true;
+    set_surface_shader();
   }
   if (glfwGetKey(window, GLFW_KEY_F) == GLFW_PRESS) {
     shader = flat_shader();
-    view_should_update = true;
+    set_surface_shader();
   }
   if (glfwGetKey(window, GLFW_KEY_P) == GLFW_PRESS) {
     shader = vertex_light_shader();
-    view_should_update = true;
+    set_surface_shader(true);
   }
   if (glfwGetKey(window, GLFW_KEY_O) == GLFW_PRESS) {
     shader = vertex_light_variation_shader();
-    view_should_update = true;
+    set_surface_shader(true);
   }
   if (glfwGetKey(window, GLFW_KEY_I) == GLFW_PRESS) {
     shader = vertex_light_variation_slope_shader();
-    view_should_update = true;
+    set_surface_shader(true);
   }
 }
 
 void resize(int width, int height) {
+  // Images of one recording share their size.
+  if (recording) toggle_recording();
   glViewport(0, 0, width, height);
   cam.set_screen_resolution(width, height);
-  view_should_update = true;
+  dirty.camera = true;
 }
 
 void update() {
-  if (view_should_update) {
+  if (loading) update_loading();
+  if (scene_loader.valid()) update_scene_loading();
+  if (animation_playing) update_animation();
+  if (dirty.geometry) {
+    update_geometry();
+    dirty.geometry = false;
+  }
+  if (dirty.camera) {
     update_view();
-    view_should_update = false;
+    update_culling();
+    if (cpu_contours_enabled) update_contour_segments();
+    dirty.camera = false;
+  }
+  if (dirty.surface_uniforms) {
+    update_surface_uniforms();
+    dirty.surface_uniforms = false;
+  }
+  if (dirty.line_uniforms) {
+    update_line_uniforms();
+    dirty.line_uniforms = false;
   }
+  // Keep the light marked as dirty while updates are disabled
+  // such that re-enabling them brings the illumination up to date.
+  if (illumination_needed()) {
+    if (dirty.light) {
+      update_illumination_data();
+      dirty.light = false;
+    } else if (!orbiting && requested_level) {
+      // The camera stopped. So refine to full resolution.
+      update_illumination_data();
+    }
+  }
+  // The worker finishes asynchronously.
+  // Until then, the previous illumination data is rendered.
+  if (worker.fetch()) upload_illumination_data();
+  if (assembly) assembly->update();
 }
 
 void render() {
   glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-  if (surface_shading_enabled) {
+  if (assembly) {
+    if (surface_shading_enabled) assembly->render(shader);
+    if (pels_enabled)
+      render_photic_extremum_lines(
+          [&](shader_program& program) { assembly->draw(program); });
+    if (contours_enabled) {
+      contour_lines.capture(contour_shader,
+                            [&] { assembly->draw(contour_shader); });
+      contour_lines.render(cam, line_options);
+    }
+    return;
+  }
+  if (loading && mesh.faces.empty()) {
+    // There is no illumination data for the preview.
+    // So only the surface can be rendered.
     shader.bind();
-    mesh.render();
+    preview.render();
+    return;
   }
-  if (pels_enabled) {
-    line_shader.bind();
-    mesh.render();
+  if (surface_shading_enabled) {
+    shader.bind();
+    mesh.render(visible_ranges);
   }
+  if (pels_enabled)
+    render_photic_extremum_lines(
+        [&](shader_program&) { mesh.render(visible_ranges); });
   if (contours_enabled) {
-    contour_shader.bind();
-    mesh.render();
+    if (cpu_contours_enabled) {
+      contour_segment_lines.render(cam, line_options);
+    } else {
+      contour_lines.capture(contour_shader,
+                            [&] { mesh.render(contour_ranges); });
+      contour_lines.render(cam, line_options);
+    }
+  }
+}
+
+void cleanup() {
+  recording.reset();
+  assembly.reset();
+}
+
+void toggle_recording() {
+  if (recording) {
+    recording->finish();
+    const auto stats = recording->stats();
+    cout << "Recorded " << stats.encoded << " frames. Encoders blocked "
+         << "rendering for " << stats.blocked_time << " s." << endl;
+    recording.reset();
+    return;
   }
+  frame_capture::options opts{};
+  opts.output_prefix = "recording-" + to_string(recordings++);
+  recording.emplace(cam.screen_width(), cam.screen_height(), opts);
 }
 
-void cleanup() {}
+void toggle_animation() {
+  if (animation.frame_count() < 2) return;
+  animation_playing = !animation_playing;
+  // Continue with the current frame.
+  animation_start = system_clock::now() -
+                    std::chrono::duration_cast<system_clock::duration>(
+                        duration<float>(animation_frame / animation_rate));
+}
+
+void update_animation() {
+  // Wait for the illumination of the current frame.
+  if (illumination_needed() && (worker.data_geometry() != worker.geometry()))
+    return;
+  const auto time =
+      duration<float>(system_clock::now() - animation_start).count();
+  const auto frame = size_t(time * animation_rate) % animation.frame_count();
+  if (frame == animation_frame) return;
+  animation_frame = frame;
+
+  // The worker reads the geometry. So it must not run during the update.
+  worker.stop();
+  deformation.apply(animation.frame(frame), mesh, gradient_data, adjacency,
+                    illumination_data, clusters);
+  worker.resume();
+  mesh.update_vertices(deformation.vertices);
+  contours = contour_hierarchy{clusters};
+
+  // Cluster bounds and all illumination data have changed.
+  illuminated_clusters.assign(clusters.size(), false);
+  dirty.camera = true;
+  dirty.light = true;
+}
 
 void update_view() {
   // Computer camera position by using spherical coordinates.
@@ -240,6 +487,50 @@ void update_view() {
   // auto t = vec3(cam.view_matrix() * vec4(cam.direction(), 0.0f));
   // cout << t.x << ", " << t.y << ", " << t.z << endl;
 
+  // All shaders receive the camera matrices as uniforms.
+  dirty.surface_uniforms = true;
+  dirty.line_uniforms = true;
+}
+
+void update_culling() {
+  const frustum view_frustum{cam.projection_matrix() * cam.view_matrix()};
+  const auto eye = cam.position();
+  visible_clusters.clear();
+  visible_faces = 0;
+  visible_ranges.clear();
+  contour_ranges.clear();
+  bool missing = false;
+  for (size_t i = 0; i < clusters.size(); ++i) {
+    const auto& cluster = clusters[i];
+    if (!view_frustum.intersects(cluster.center, cluster.radius)) continue;
+    visible_clusters.push_back(i);
+    visible_faces += cluster.face_count;
+    visible_ranges.add(cluster.first_face, cluster.face_count);
+    if (may_contain_contour(cluster, eye))
+      contour_ranges.add(cluster.first_face, cluster.face_count);
+    missing = missing || !illuminated_clusters[i];
+  }
+  // Clusters that became visible need to be illuminated.
+  // Moving away or panning inside the illuminated region is free.
+  if (missing) dirty.light = true;
+}
+
+void update_contour_segments() {
+  contour_segments.clear();
+  const auto stats = contours.extract(mesh, cam.position(), contour_segments);
+  contour_segment_lines.assign(contour_segments);
+  // Only report the statistics for views that are kept.
+  if (orbiting) return;
+  cout << "contour extraction:\n"
+       << "visited nodes = " << stats.visited_nodes << " / "
+       << stats.node_count << '\n'
+       << "tested faces = " << stats.tested_faces << " / " << stats.face_count
+       << '\n'
+       << "segments = " << stats.segments << '\n'
+       << endl;
+}
+
+void update_surface_uniforms() {
   shader.bind();
   shader  //
       .set("projection", cam.projection_matrix())
@@ -248,6 +539,10 @@ void update_view() {
       // 0.0f)))
       .set("viewport", scale(mat4{1.0f}, {cam.screen_width() / 2.0f,
                                           cam.screen_height() / 2.0f, 1.0f}));
+}
+
+void update_line_uniforms() {
+  line_options.threshold = threshold;
 
   contour_shader.bind();
   contour_shader  //
@@ -262,8 +557,35 @@ void update_view() {
       .set("view", cam.view_matrix())
       .set("threshold", threshold)
       .set("shift", line_shift);
+}
 
-  if (illumination_should_update) update_illumination_data();
+void update_geometry() {
+  memory_stage stage{"mesh buffers"};
+  mesh.setup(shader);
+  mesh.update(animation.frame_count() ? GL_DYNAMIC_DRAW : GL_STATIC_DRAW);
+
+  // The buffer is only allocated here.
+  // Illumination updates overwrite its content.
+  illumination_buffer.allocate(mesh.vertices.size() * sizeof(illumination_info),
+                               nullptr, GL_DYNAMIC_DRAW);
+  setup_illumination_locations(illumination_buffer, shader);
+  setup_illumination_locations(illumination_buffer, line_shader);
+  if (assembly) {
+    assembly->setup(shader);
+    assembly->setup(line_shader);
+  }
+
+  dirty.light = true;
+}
+
+void set_surface_shader(bool shows_illumination) {
+  // A new surface shader does not change the illumination data.
+  // Only its attributes and uniforms need to be set up.
+  surface_shows_illumination = shows_illumination;
+  mesh.handle.bind();
+  setup_illumination_locations(illumination_buffer, shader);
+  if (assembly) assembly->setup(shader);
+  dirty.surface_uniforms = true;
 }
 
 void turn(const vec2& mouse_move) {
@@ -271,145 +593,238 @@ void turn(const vec2& mouse_move) {
   azimuth += mouse_move.x * 0.01;
   constexpr float bound = pi / 2 - 1e-5f;
   altitude = std::clamp(altitude, -bound, bound);
-  view_should_update = true;
+  // The light direction is given by the camera direction.
+  dirty.camera = true;
+  dirty.light = true;
 }
 
 void shift(const vec2& mouse_move) {
   const auto shift = mouse_move.x * cam.right() + mouse_move.y * cam.up();
   const auto scale = 1.3f * cam.pixel_size() * radius;
   origin += scale * shift;
-  view_should_update = true;
+  dirty.camera = true;
 }
 
 void zoom(const vec2& mouse_scroll) {
   radius *= exp(-0.1f * float(mouse_scroll.y));
-  view_should_update = true;
+  dirty.camera = true;
 }
 
 void adjust_threshold(float x) {
   threshold_shift *= exp(-0.01f * x);
   threshold = exp(-1.0f / threshold_shift);
-  view_should_update = true;
+  dirty.line_uniforms = true;
 }
 
 void adjust_shift(float x) {
   line_shift *= exp(-0.01f * x);
-  view_should_update = true;
+  dirty.line_uniforms = true;
+}
+
+void adjust_light_smoothing(int x) {
+  light_smoothing = std::max(0, int(light_smoothing) + x);
+  worker.set_light_smoothing(light_smoothing);
+  if (assembly) assembly->set_light_smoothing(light_smoothing);
+  cout << "Light smoothing: " << light_smoothing << " iterations" << endl;
+  dirty.light = true;
 }
 
 void fit_view() {
-  // AABB computation
-  aabb_min = mesh.vertices[0].position;
-  aabb_max = mesh.vertices[0].position;
-  for (size_t i = 1; i < size(mesh.vertices); ++i) {
-    aabb_min = min(aabb_min, mesh.vertices[i].position);
-    aabb_max = max(aabb_max, mesh.vertices[i].position);
+  if (assembly) {
+    std::tie(aabb_min, aabb_max) = assembly->bounds();
+  } else {
+    // Fit the preview as long as the mesh has not been loaded.
+    const auto& vertices = mesh.vertices.empty() ? preview.vertices  //
+                                                 : mesh.vertices;
+    if (vertices.empty()) return;
+
+    // AABB computation
+    aabb_min = vertices[0].position;
+    aabb_max = vertices[0].position;
+    for (size_t i = 1; i < size(vertices); ++i) {
+      aabb_min = min(aabb_min, vertices[i].position);
+      aabb_max = max(aabb_max, vertices[i].position);
+    }
   }
   origin = 0.5f * (aabb_max + aabb_min);
   bounding_radius = 0.5f * length(aabb_max - aabb_min);
   radius = 0.5f * length(aabb_max - aabb_min) *
            (1.0f / tan(0.5f * cam.vfov() * pi / 180.0f));
   cam.set_near_and_far(1e-4f * radius, 2 * radius);
-  view_should_update = true;
+  dirty.camera = true;
 }
 
 void set_z_as_up() {
   right = {1, 0, 0};
   front = {0, -1, 0};
   up = {0, 0, 1};
-  view_should_update = true;
+  dirty.camera = true;
+  dirty.light = true;
 }
 
 void set_y_as_up() {
   right = {1, 0, 0};
   front = {0, 0, 1};
   up = {0, 1, 0};
-  view_should_update = true;
+  dirty.camera = true;
+  dirty.light = true;
 }
 
-void load_model(czstring file_path) {
-  auto start = system_clock::now();
-  stl_binary_format stl_data{file_path};
-  auto end = system_clock::now();
-  auto time = duration<float>(end - start).count();
-  cout << "stl file:\n"
-       << "load time = " << time << " s" << '\n'
-       << "triangle count = " << stl_data.triangles.size() << '\n'
-       << endl;
+void load_model(czstring file_path, vector<string> frame_paths) {
+  animation_playing = false;
+  if (std::filesystem::path{file_path}.extension() == ".scene") {
+    load_scene(file_path);
+    return;
+  }
+  assembly.reset();
+  // Loading and preparation run in the background.
+  // 'update_loading()' takes care of the results.
+  loader.start(file_path, std::move(frame_paths));
+  loading = true;
+  preview.vertices.clear();
+  preview.faces.clear();
+}
 
-  start = system_clock::now();
-  transform(stl_data, mesh);
-  end = system_clock::now();
-  time = duration<float>(end - start).count();
-  cout << "mesh transform:\n"
-       << "time = " << time << " s" << '\n'
-       << "vertices = " << mesh.vertices.size() << '\n'
-       << "faces = " << mesh.faces.size() << '\n'
-       << endl;
+void update_loading() {
+  const auto preview_was_empty = preview.vertices.empty();
+  if (loader.fetch_preview(preview.vertices)) {
+    for (auto i = preview.faces.size(); i < preview.vertices.size() / 3; ++i)
+      preview.faces.push_back(
+          {uint32_t(3 * i), uint32_t(3 * i + 1), uint32_t(3 * i + 2)});
+    preview.setup(shader);
+    preview.update();
+    if (preview_was_empty) fit_view();
+  }
 
-  fit_view();
-  mesh.setup(shader);
-  mesh.update();
+  if (!loader.ready()) {
+    const auto title = "Photic Extremum Lines (" + string(loader.stage()) +
+                       " " + std::to_string(int(100 * loader.progress())) +
+                       " %)";
+    glfwSetWindowTitle(window, title.c_str());
+    return;
+  }
 
-  illumination_data.resize(mesh.vertices.size());
-  gradient_data.resize(mesh.faces.size());
-  compute_voronoi_weights(mesh, gradient_data);
-  compute_vertex_voronoi_area(mesh, gradient_data, illumination_data);
-  compute_vertex_tangent_system(mesh, gradient_data, illumination_data);
+  loading = false;
+  glfwSetWindowTitle(window, "Photic Extremum Lines");
+  auto data = loader.take();
+
+  // The worker references the mesh.
+  worker.stop();
+  mesh.vertices = std::move(data.geometry.vertices);
+  mesh.faces = std::move(data.geometry.faces);
+  gradient_data = std::move(data.gradient_data);
+  illumination_data = std::move(data.illumination_data);
+  clusters = std::move(data.clusters);
+  adjacency = std::move(data.adjacency);
+  contours = std::move(data.contours);
+  animation = std::move(data.animation);
+  animation_frame = 0;
+  deformation = {};
+  illuminated_clusters.assign(clusters.size(), false);
+  coarse_levels = std::move(data.levels);
+  vector<illumination_worker::input> levels{
+      {&mesh, &gradient_data, &illumination_data, &adjacency, &clusters}};
+  for (const auto& coarse : coarse_levels)
+    levels.push_back({&coarse.geometry, &coarse.gradient_data,
+                      &coarse.illumination_data, &coarse.adjacency, nullptr,
+                      &coarse.vertex_map});
+  worker.start(std::move(levels));
+
+  // Without any preview, the view has not been fitted yet.
+  if (preview.vertices.empty()) fit_view();
+  preview.vertices.clear();
+  preview.faces.clear();
+
+  dirty.geometry = true;
+  dirty.camera = true;
 }
 
-void setup_illumination_locations(const shader_program& shader) {
-  illumination_buffer.bind();
-  {
-    const auto location = glGetAttribLocation(shader, "l");
-    glEnableVertexAttribArray(location);
-    glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE,
-                          sizeof(illumination_info),
-                          (void*)offsetof(illumination_info, light));
-  }
-  {
-    const auto location = glGetAttribLocation(shader, "lg");
-    glEnableVertexAttribArray(location);
-    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE,
-                          sizeof(illumination_info),
-                          (void*)offsetof(illumination_info, light_gradient));
-  }
-  {
-    const auto location = glGetAttribLocation(shader, "lv");
-    glEnableVertexAttribArray(location);
-    glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE,
-                          sizeof(illumination_info),
-                          (void*)offsetof(illumination_info, light_variation));
-  }
-  {
-    const auto location = glGetAttribLocation(shader, "lvs");
-    glEnableVertexAttribArray(location);
-    glVertexAttribPointer(
-        location, 1, GL_FLOAT, GL_FALSE, sizeof(illumination_info),
-        (void*)offsetof(illumination_info, light_variation_slope));
-  }
+void load_scene(czstring file_path) {
+  // Parts are loaded and prepared in the background.
+  // 'update_scene_loading()' takes care of the results.
+  scene_loader =
+      std::async(std::launch::async, [path = string{file_path}] {
+        set_memory_stage("scene loading");
+        return load_scene_description(path.c_str());
+      });
+  glfwSetWindowTitle(window, "Photic Extremum Lines (loading scene)");
+}
+
+void update_scene_loading() {
+  using namespace std::chrono_literals;
+  if (scene_loader.wait_for(0s) != std::future_status::ready) return;
+  glfwSetWindowTitle(window, "Photic Extremum Lines");
+
+  // The scene replaces the single mesh.
+  worker.stop();
+  mesh.vertices.clear();
+  mesh.faces.clear();
+  clusters.clear();
+  contours = {};
+  coarse_levels.clear();
   {
-    const auto location = glGetAttribLocation(shader, "lvc");
-    glEnableVertexAttribArray(location);
-    glVertexAttribPointer(
-        location, 1, GL_FLOAT, GL_FALSE, sizeof(illumination_info),
-        (void*)offsetof(illumination_info, light_variation_curve));
+    memory_stage stage{"scene buffers"};
+    assembly.emplace(scene_loader.get());
   }
+  assembly->set_light_smoothing(light_smoothing);
+  const auto stats = assembly->stats();
+  cout << "scene:\n"
+       << "parts = " << stats.parts << '\n'
+       << "instances = " << stats.instances << '\n'
+       << "groups = " << stats.groups << '\n'
+       << "faces = " << stats.faces << '\n'
+       << "illuminated faces = " << stats.illuminated_faces << '\n'
+       << "prepared data = " << mebibytes(stats.prepared_memory) << " MiB ("
+       << mebibytes(stats.unshared_memory) << " MiB without sharing)\n"
+       << endl;
+  print_memory_report(cout);
+  cout << endl;
+
+  fit_view();
+  dirty.geometry = true;
+  dirty.camera = true;
+}
+
+auto illumination_needed() -> bool {
+  // Lines in image space do not need the illumination of the mesh.
+  // Surface shaders that visualize it still do.
+  if (!illumination_should_update) return false;
+  if (surface_shading_enabled && surface_shows_illumination) return true;
+  return pels_enabled && (pel_space != line_space::image);
 }
 
 void update_illumination_data() {
-  compute_vertex_light(cam.direction(), mesh, illumination_data);
-  compute_vertex_light_gradient(mesh, gradient_data, illumination_data);
-  compute_vertex_light_variation_slope(mesh, gradient_data, illumination_data);
-  compute_vertex_light_variation_curve(mesh, gradient_data, illumination_data);
+  if (assembly) {
+    assembly->request(cam.direction());
+    return;
+  }
+  requested_level = orbiting ? interactive_level() : 0;
+  const auto blend = orbiting && illumination_blending;
+  // Only a snapshot of the light direction is handed over to the worker.
+  if (requested_level) {
+    worker.request(cam.direction(), requested_level, {}, blend);
+    return;
+  }
+  illuminated_clusters.assign(clusters.size(), false);
+  for (auto i : visible_clusters) illuminated_clusters[i] = true;
+  worker.request(cam.direction(), 0, visible_clusters, blend);
+}
 
-  setup_illumination_locations(shader);
-  setup_illumination_locations(line_shader);
+auto interactive_level() -> size_t {
+  for (size_t i = 0; i < coarse_levels.size(); ++i) {
+    // Only the visible part of the original mesh is illuminated.
+    const auto faces =
+        i ? coarse_levels[i - 1].geometry.faces.size() : visible_faces;
+    if (worker.estimated_time(faces) <= illumination_time_budget) return i;
+  }
+  return coarse_levels.size();
+}
 
+void upload_illumination_data() {
+  const auto& data = worker.data();
   illumination_buffer.bind();
-  glBufferData(GL_ARRAY_BUFFER,
-               illumination_data.size() * sizeof(illumination_data[0]),
-               illumination_data.data(), GL_DYNAMIC_DRAW);
+  glBufferSubData(GL_ARRAY_BUFFER, 0, data.size() * sizeof(data[0]),
+                  data.data());
 }
 
 }  // namespace application
@@ -1,4 +1,5 @@
 #pragma once
+#include "buffer.hpp"
 #include "glfw_context.hpp"
 #include "glfw_window.hpp"
 #include "shader.hpp"
@@ -15,8 +16,17 @@ void resize(int width, int height);
 void update();
 void render();
 void cleanup();
+void toggle_recording();
+void toggle_animation();
+void update_animation();
 
 void update_view();
+void update_culling();
+void update_contour_segments();
+void update_surface_uniforms();
+void update_line_uniforms();
+void update_geometry();
+void set_surface_shader(bool shows_illumination = false);
 void turn(const vec2& mouse_move);
 void shift(const vec2& mouse_move);
 void zoom(const vec2& mouse_scroll);
@@ -24,11 +34,19 @@ void fit_view();
 void set_z_as_up();
 void set_y_as_up();
 
-void load_model(czstring file_path);
+// Further files with the same topology are played back as animation.
+// Files with the extension '.scene' are loaded as assembly.
+void load_model(czstring file_path, vector<string> frame_paths = {});
+void update_loading();
+void load_scene(czstring file_path);
+void update_scene_loading();
+auto illumination_needed() -> bool;
 void update_illumination_data();
-void setup_illumination_locations(const shader_program& shader);
+auto interactive_level() -> size_t;
+void upload_illumination_data();
 
 void adjust_threshold(float x);
 void adjust_shift(float x);
+void adjust_light_smoothing(int x);
 
 }  // namespace application
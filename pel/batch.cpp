@@ -0,0 +1,624 @@
+#include <filesystem>
+#include <mutex>
+//
+#include "bulk_reader.hpp"
+#include "contour_hierarchy.hpp"
+#include "egl_context.hpp"
+#include "face_bvh.hpp"
+#include "frame_capture.hpp"
+#include "hidden_lines.hpp"
+#include "memory_usage.hpp"
+#include "mesh_hierarchy.hpp"
+#include "mesh_deformation.hpp"
+#include "model_loader.hpp"
+#include "offscreen_renderer.hpp"
+#include "out_of_core.hpp"
+#include "parallel.hpp"
+#include "png_image.hpp"
+#include "polylines.hpp"
+#include "service.hpp"
+#include "viewpoint_search.hpp"
+
+namespace {
+
+// Renders frames of a full orbit around the mesh into numbered images.
+void render_orbit(czstring mesh_path,
+                  const string& output_prefix,
+                  int width,
+                  int height,
+                  int frames,
+                  std::string_view shading,
+                  std::string_view format) {
+  egl_context context{};
+  const prepared_mesh mesh{mesh_path};
+  offscreen_renderer renderer{width, height};
+  renderer.set_surface_shader(named_surface_shader(shading));
+  renderer.set_mesh(mesh);
+
+  frame_capture::options opts{};
+  opts.output_prefix = output_prefix;
+  if (format == "raw")
+    opts.format = frame_capture::image_format::raw;
+  else if (format != "png")
+    throw runtime_error("Unknown image format '" + string(format) + "'.");
+  frame_capture capture{width, height, opts};
+
+  const auto start = system_clock::now();
+  for (int i = 0; i < frames; ++i) {
+    const auto cam =
+        orbit_camera(mesh.geometry, width, height, 2 * pi * i / frames);
+    renderer.render(cam, {});
+    renderer.bind_for_reading();
+    capture.capture();
+  }
+  capture.finish();
+  const auto time = duration<float>(system_clock::now() - start).count();
+  const auto stats = capture.stats();
+  cout << "Rendered " << frames << " frames in " << time
+       << " s. Encoders blocked rendering for " << stats.blocked_time << " s."
+       << endl;
+}
+
+// Prints how the number of line segments and the computation time
+// depend on the number of light smoothing iterations.
+void report_light_smoothing(czstring mesh_path,
+                            size_t max_iterations,
+                            float threshold) {
+  const prepared_mesh mesh{mesh_path};
+  const auto light_dir = orbit_camera(mesh.geometry, 1, 1, 0).direction();
+  auto data = mesh.illumination_data;
+  vector<line_segment> segments{};
+  float base_time = 0;
+  cout << "iterations  segments  time [ms]  per iteration [ms]\n";
+  for (size_t k = 0; k <= max_iterations; ++k) {
+    // The fastest of several runs is least disturbed by other processes.
+    auto time = std::numeric_limits<float>::infinity();
+    for (int run = 0; run < 3; ++run) {
+      const auto start = system_clock::now();
+      compute_illumination(light_dir, mesh.geometry, mesh.gradient_data,
+                           mesh.adjacency, data, k);
+      time = std::min(
+          time, duration<float>(system_clock::now() - start).count() * 1000);
+    }
+    if (!k) base_time = time;
+    segments.clear();
+    extract_photic_extremum_lines(mesh.geometry, data, threshold, segments);
+    cout << std::setw(10) << k << std::setw(10) << segments.size()
+         << std::setw(11) << time << std::setw(20)
+         << (k ? (time - base_time) / k : 0.0f) << '\n';
+  }
+}
+
+// Compares the illumination over all faces with the one over the
+// regular faces only. Degenerate faces get zero weights but their
+// gradients still divide by a vanishing determinant.
+void report_degenerate_faces(czstring mesh_path, size_t runs) {
+  const prepared_mesh mesh{mesh_path};
+  const vertex_face_adjacency all_faces{mesh.geometry};
+  const auto light_dir = orbit_camera(mesh.geometry, 1, 1, 0).direction();
+  auto data = mesh.illumination_data;
+
+  // The fastest of several runs is least disturbed by other processes.
+  const auto measure = [&](const vertex_face_adjacency& adjacency) {
+    auto time = std::numeric_limits<float>::infinity();
+    for (size_t run = 0; run < std::max<size_t>(1, runs); ++run) {
+      const auto start = system_clock::now();
+      compute_illumination(light_dir, mesh.geometry, mesh.gradient_data,
+                           adjacency, data);
+      time = std::min(time,
+                      duration<float>(system_clock::now() - start).count());
+    }
+    size_t invalid = 0;
+    for (const auto& x : data)
+      invalid += !std::isfinite(x.light_variation) ||
+                 !std::isfinite(x.light_variation_slope) ||
+                 !std::isfinite(x.light_variation_curve);
+    return std::pair{time, invalid};
+  };
+  const auto [all_time, all_invalid] = measure(all_faces);
+  const auto [time, invalid] = measure(mesh.adjacency);
+
+  const auto faces = mesh.geometry.faces.size();
+  const auto dropped = dropped_face_count(mesh.geometry, mesh.adjacency);
+  cout << "faces = " << faces << '\n'
+       << "degenerate faces = " << dropped << " ("
+       << 100.0f * dropped / faces << " %)\n"
+       << "non-finite vertices = " << all_invalid << " -> " << invalid
+       << '\n'
+       << "illumination time = " << all_time * 1000 << " ms -> "
+       << time * 1000 << " ms\n"
+       << "throughput = " << faces / all_time / 1e6f << " -> "
+       << faces / time / 1e6f << " Mfaces/s" << endl;
+}
+
+// Moves a bump across the mesh by a displacement buffer for every frame
+// and compares incremental updates with a full preparation.
+void report_deformation(czstring mesh_path, size_t frames) {
+  prepared_mesh mesh{mesh_path};
+  auto& vertices = mesh.geometry.vertices;
+  const auto rest = vertices;
+  const auto n = rest.size();
+  vec3 aabb_min = rest[0].position;
+  vec3 aabb_max = rest[0].position;
+  for (const auto& v : rest) {
+    aabb_min = min(aabb_min, v.position);
+    aabb_max = max(aabb_max, v.position);
+  }
+  const auto radius = length(aabb_max - aabb_min) / 2;
+  const auto sigma = 0.05f * radius;
+  const auto amplitude = 0.02f * radius;
+
+  vector<vec3> positions(n);
+  mesh_deformation deformation{};
+  float total_time = 0;
+  size_t reclassified_faces = 0;
+  cout << "frame  moved vertices  updated vertices  updated faces  time [ms]\n";
+  for (size_t k = 0; k < frames; ++k) {
+    // Displacements vanish outside the bump.
+    const auto center = rest[k * n / frames].position;
+    parallel_for(size_t{0}, n, [&](size_t i) {
+      const auto d = rest[i].position - center;
+      const auto w = exp(-dot(d, d) / (2 * sigma * sigma));
+      positions[i] = rest[i].position;
+      if (w > 1e-3f) positions[i] += amplitude * w * rest[i].normal;
+    });
+    const auto start = system_clock::now();
+    const auto stats =
+        deformation.apply(positions, mesh.geometry, mesh.gradient_data,
+                          mesh.adjacency, mesh.illumination_data);
+    const auto time =
+        duration<float>(system_clock::now() - start).count() * 1000;
+    total_time += time;
+    reclassified_faces += stats.reclassified_faces;
+    cout << std::setw(5) << k << std::setw(16) << stats.moved_vertices
+         << std::setw(18) << stats.updated_vertices << std::setw(15)
+         << stats.updated_faces << std::setw(11) << time << '\n';
+  }
+
+  // Full preparation of the last frame as reference
+  auto reference = mesh.geometry;
+  vector<gradient_info> gradient_data(reference.faces.size());
+  vector<illumination_info> illumination_data(n);
+  const auto start = system_clock::now();
+  compute_vertex_normals(reference);
+  compute_voronoi_weights(reference, gradient_data);
+  const auto adjacency = gradient_adjacency(reference);
+  compute_vertex_voronoi_area(reference, gradient_data, adjacency,
+                              illumination_data);
+  compute_vertex_tangent_system(reference, gradient_data, illumination_data);
+  const auto full_time =
+      duration<float>(system_clock::now() - start).count() * 1000;
+
+  float area_error = 0;
+  float normal_error = 0;
+  float tangent_error = 0;
+  for (size_t i = 0; i < n; ++i) {
+    const auto& x = mesh.illumination_data[i];
+    const auto& normal = vertices[i].normal;
+    area_error = std::max(area_error,
+                          std::abs(x.voronoi_area -
+                                   illumination_data[i].voronoi_area) /
+                              illumination_data[i].voronoi_area);
+    normal_error = std::max(normal_error,
+                            distance(normal, reference.vertices[i].normal));
+    // Tangent systems are only unique up to a rotation.
+    tangent_error = std::max(
+        {tangent_error, std::abs(dot(x.u, normal)), std::abs(dot(x.v, normal)),
+         std::abs(length(x.u) - 1), std::abs(dot(x.u, x.v))});
+  }
+  cout << "mean update time = " << total_time / frames << " ms\n"
+       << "full preparation time = " << full_time << " ms\n"
+       << "reclassified faces = " << reclassified_faces << '\n'
+       << "adjacency matches = "
+       << ((adjacency.face_indices == mesh.adjacency.face_indices) ? "yes"
+                                                                   : "no")
+       << '\n'
+       << "max relative Voronoi area error = " << area_error << '\n'
+       << "max normal error = " << normal_error << '\n'
+       << "max tangent system error = " << tangent_error << endl;
+}
+
+// Loads all mesh files of a directory and its subdirectories once
+// sequentially and twice by the bulk reader, with and without io_uring.
+// Files that fail to load are reported but do not stop the others.
+void report_bulk_loading(czstring directory,
+                         size_t memory_budget,
+                         size_t queue_depth) {
+  vector<string> paths{};
+  for (const auto& entry :
+       std::filesystem::recursive_directory_iterator{directory}) {
+    if (!entry.is_regular_file()) continue;
+    auto extension = entry.path().extension().string();
+    for (auto& c : extension) c = std::tolower(static_cast<unsigned char>(c));
+    if ((extension == ".stl") || (extension == ".obj") ||
+        (extension == ".ply"))
+      paths.push_back(entry.path().string());
+  }
+  std::ranges::sort(paths);
+  cout << "files = " << paths.size() << '\n';
+
+  struct totals {
+    size_t faces{};
+    size_t vertices{};
+    vector<string> errors{};
+  };
+  const auto load = [&](totals& t, std::mutex& mutex, size_t i,
+                        auto&& load_geometry) {
+    mesh_geometry mesh{};
+    try {
+      load_geometry(mesh);
+    } catch (const std::exception& e) {
+      std::scoped_lock lock{mutex};
+      t.errors.push_back(paths[i] + ": " + e.what());
+      return;
+    }
+    std::scoped_lock lock{mutex};
+    t.faces += mesh.faces.size();
+    t.vertices += mesh.vertices.size();
+  };
+  const auto print = [&](czstring name, const totals& t, float time,
+                         size_t bytes, size_t peak_memory) {
+    cout << std::setw(10) << name << std::setw(11) << time * 1000
+         << std::setw(10) << paths.size() / time << std::setw(10)
+         << bytes / time / (1 << 20) << std::setw(11)
+         << peak_memory / float(1 << 20) << std::setw(11) << t.faces
+         << std::setw(8) << t.errors.size() << '\n';
+  };
+
+  cout << "    reader  time [ms]   files/s     MiB/s  peak [MiB]      faces"
+          "  errors\n";
+  {
+    totals t{};
+    std::mutex mutex{};
+    size_t bytes = 0;
+    const auto start = system_clock::now();
+    for (size_t i = 0; i < paths.size(); ++i) {
+      bytes += std::filesystem::file_size(paths[i]);
+      load(t, mutex, i, [&](mesh_geometry& mesh) {
+        load_mesh_file(paths[i].c_str(), mesh);
+      });
+    }
+    print("sequential", t,
+          duration<float>(system_clock::now() - start).count(), bytes, 0);
+  }
+  for (const bool use_io_uring : {false, true}) {
+    totals t{};
+    std::mutex mutex{};
+    bulk_read_options options{};
+    options.memory_budget = memory_budget;
+    options.queue_depth = queue_depth;
+    options.use_io_uring = use_io_uring;
+    const auto start = system_clock::now();
+    const auto stats = read_files(
+        paths,
+        [&](size_t i, std::string_view content) {
+          load(t, mutex, i, [&](mesh_geometry& mesh) {
+            load_mesh_data(paths[i].c_str(), content, mesh);
+          });
+        },
+        options);
+    print(stats.io_uring ? "io_uring" : "tasks", t,
+          duration<float>(system_clock::now() - start).count(), stats.bytes,
+          stats.peak_memory);
+    if (use_io_uring && !stats.io_uring)
+      cout << "io_uring is not available.\n";
+    if (use_io_uring)
+      for (const auto& error : t.errors) cout << error << '\n';
+  }
+}
+
+// Searches the best views of the mesh and renders them into numbered
+// images in the order of their scores. Meshes with more than 'max_faces'
+// faces are searched on the finest coarse level that is small enough.
+void render_best_views(czstring mesh_path,
+                       const string& output_prefix,
+                       int width,
+                       int height,
+                       size_t count,
+                       size_t max_faces) {
+  egl_context context{};
+  const prepared_mesh mesh{mesh_path};
+
+  viewpoint_search_options options{};
+  options.count = count;
+  const auto start = system_clock::now();
+  vector<viewpoint> views{};
+  size_t faces = mesh.geometry.faces.size();
+  // Levels are built until one has less than twice the given face count.
+  const auto levels = (faces > max_faces)
+                          ? build_mesh_hierarchy(mesh.geometry, max_faces / 2)
+                          : vector<mesh_level>{};
+  if (!levels.empty()) {
+    auto it = std::ranges::find_if(levels, [&](const auto& x) {
+      return x.geometry.faces.size() <= max_faces;
+    });
+    const auto& level = (it != end(levels)) ? *it : levels.back();
+    faces = level.geometry.faces.size();
+    views = search_viewpoints(level.geometry, level.gradient_data,
+                              level.adjacency, level.illumination_data,
+                              options);
+  } else {
+    views = search_viewpoints(mesh.geometry, mesh.gradient_data,
+                              mesh.adjacency, mesh.illumination_data, options);
+  }
+  const auto time = duration<float>(system_clock::now() - start).count();
+  cout << "Searched " << faces << " faces in " << time << " s.\n"
+       << "view   azimuth  altitude     score     lines  contours      area\n";
+  for (size_t i = 0; i < views.size(); ++i) {
+    const auto& v = views[i];
+    cout << std::setw(4) << i << std::setw(10) << v.azimuth * 180 / pi
+         << std::setw(10) << v.altitude * 180 / pi << std::setw(10)
+         << v.score << std::setw(10) << v.line_length << std::setw(10)
+         << v.contour_length << std::setw(10) << v.visible_area << '\n';
+  }
+
+  offscreen_renderer renderer{width, height};
+  renderer.set_mesh(mesh);
+  frame_capture::options opts{};
+  opts.output_prefix = output_prefix;
+  frame_capture capture{width, height, opts};
+  for (const auto& v : views) {
+    // The orbit camera keeps the y-axis up and so it
+    // can not look straight up or down.
+    const auto altitude = std::clamp(v.altitude, -0.49f * pi, 0.49f * pi);
+    renderer.render(orbit_camera(mesh.geometry, width, height, v.azimuth,
+                                 altitude),
+                    {});
+    renderer.bind_for_reading();
+    capture.capture();
+  }
+  capture.finish();
+}
+
+// Renders one view with photic extremum lines in object space on the left
+// and in image space on the right side of the image. Then, prints the
+// time per frame of both modes without surface shading and contours.
+void compare_line_modes(czstring mesh_path,
+                        czstring png_path,
+                        int width,
+                        int height,
+                        float azimuth,
+                        float altitude) {
+  egl_context context{};
+  const prepared_mesh mesh{mesh_path};
+  offscreen_renderer renderer{width, height};
+  renderer.set_mesh(mesh);
+  const auto cam = orbit_camera(mesh.geometry, width, height, azimuth,
+                                altitude);
+
+  offscreen_renderer::options object_space{};
+  offscreen_renderer::options image_space{};
+  image_space.image_space = true;
+
+  vector<uint8_t> pixels(size_t(2 * width) * height * 4);
+  const auto row = size_t(width) * 4;
+  for (int side = 0; side < 2; ++side) {
+    renderer.render(cam, side ? image_space : object_space);
+    const auto frame = renderer.read_pixels();
+    for (int y = 0; y < height; ++y)
+      std::ranges::copy(frame.subspan(y * row, row),
+                        &pixels[(2 * y + side) * row]);
+  }
+  write_png(png_path, 2 * width, height, pixels);
+
+  const auto frame_time = [&](offscreen_renderer::options opts) {
+    opts.surface_shading = false;
+    opts.contours = false;
+    constexpr int frames = 10;
+    renderer.render(cam, opts);
+    glFinish();
+    const auto start = system_clock::now();
+    for (int i = 0; i < frames; ++i) renderer.render(cam, opts);
+    glFinish();
+    return duration<float>(system_clock::now() - start).count() / frames;
+  };
+  cout << "faces = " << mesh.geometry.faces.size() << '\n'
+       << "object space = " << frame_time(object_space) << " s / frame\n"
+       << "image space = " << frame_time(image_space) << " s / frame" << endl;
+}
+
+// Writes the visible photic extremum lines and contours of one view
+// into an SVG file. Hidden parts are removed by rays against a BVH.
+void write_line_drawing(czstring mesh_path,
+                        czstring svg_path,
+                        int width,
+                        int height,
+                        float azimuth,
+                        float altitude) {
+  mesh_geometry geometry{};
+  load_mesh_file(mesh_path, geometry);
+  // The contour hierarchy needs the faces in the order of the clusters.
+  const auto clusters = build_mesh_clusters(geometry);
+  const prepared_mesh mesh{std::move(geometry)};
+  const contour_hierarchy contours{clusters};
+  const auto cam =
+      orbit_camera(mesh.geometry, width, height, azimuth, altitude);
+
+  constexpr float threshold = 0.01f;
+  auto data = mesh.illumination_data;
+  compute_illumination(cam.direction(), mesh.geometry, mesh.gradient_data,
+                       mesh.adjacency, data);
+  vector<line_segment> segments{};
+  extract_photic_extremum_lines(mesh.geometry, data, threshold, segments);
+  vector<vec3> points{};
+  contours.extract(mesh.geometry, cam.position(), points);
+  vector<line_segment> contour_segments{};
+  for (size_t i = 0; i + 1 < points.size(); i += 2)
+    contour_segments.push_back({points[i], points[i + 1], 1, 1});
+
+  auto start = system_clock::now();
+  const face_bvh bvh{mesh.geometry};
+  const auto build_time =
+      duration<float>(system_clock::now() - start).count();
+
+  // Offsets and tolerances are relative to the size of the mesh.
+  auto aabb_min = mesh.geometry.vertices[0].position;
+  auto aabb_max = aabb_min;
+  for (const auto& v : mesh.geometry.vertices) {
+    aabb_min = min(aabb_min, v.position);
+    aabb_max = max(aabb_max, v.position);
+  }
+  const auto size = distance(aabb_min, aabb_max);
+  hidden_line_options options{};
+  options.offset = 1e-4f * size;
+  start = system_clock::now();
+  vector<line_segment> visible{};
+  remove_hidden_lines(bvh, cam.position(), segments, visible, options);
+  vector<line_segment> visible_contours{};
+  remove_hidden_lines(bvh, cam.position(), contour_segments,
+                      visible_contours, options);
+  const auto visibility_time =
+      duration<float>(system_clock::now() - start).count();
+
+  auto lines = chain_line_segments(visible, 1e-6f * size);
+  auto contour_lines = chain_line_segments(visible_contours, 1e-6f * size);
+  lines.insert(end(lines), std::make_move_iterator(begin(contour_lines)),
+               std::make_move_iterator(end(contour_lines)));
+  write_svg_lines(svg_path, lines, cam, threshold);
+
+  const auto stats = bvh.stats();
+  cout << "faces = " << stats.faces << '\n'
+       << "BVH nodes = " << stats.nodes << ", leaves = " << stats.leaves
+       << ", depth = " << stats.depth << '\n'
+       << "BVH build time = " << build_time << " s\n"
+       << "line segments = " << segments.size() << " -> " << visible.size()
+       << '\n'
+       << "contour segments = " << contour_segments.size() << " -> "
+       << visible_contours.size() << '\n'
+       << "visibility time = " << visibility_time << " s\n"
+       << "polylines = " << lines.size() << endl;
+}
+
+// Loads, prepares and renders a mesh once and prints the
+// memory that has been allocated by every stage on the way.
+void report_memory(czstring mesh_path, int width, int height) {
+  mesh_geometry geometry{};
+  {
+    memory_stage stage{"loading"};
+    load_mesh_file(mesh_path, geometry);
+  }
+  const auto mesh = [&] {
+    memory_stage stage{"preparing"};
+    return prepared_mesh{std::move(geometry)};
+  }();
+  memory_stage setup{"renderer setup"};
+  egl_context context{};
+  offscreen_renderer renderer{width, height};
+  renderer.set_mesh(mesh);
+  {
+    memory_stage stage{"rendering"};
+    renderer.render(orbit_camera(mesh.geometry, width, height, 0), {});
+    renderer.read_pixels();
+  }
+  print_memory_report(cout);
+}
+
+// Runs the mode given by the arguments.
+// Returns false if they do not describe any mode.
+bool run_mode(int argc, char* argv[]) {
+  const auto mode = (argc > 1) ? std::string_view{argv[1]} : "";
+  if ((argc == 4) && (mode == "--out-of-core")) {
+    const auto lines = extract_photic_extremum_lines_out_of_core(argv[2]);
+    write_obj_lines(argv[3], lines);
+    return true;
+  }
+  if (((argc == 3) || (argc == 4)) && (mode == "--serve")) {
+    service_options options{};
+    options.socket_path = argv[2];
+    if (argc == 4) options.memory_budget = std::stoull(argv[3]) << 20;
+    run_service(options);
+    return true;
+  }
+  if ((argc >= 6) && (argc <= 9) && (mode == "--render")) {
+    render_orbit(argv[2], argv[3], std::stoi(argv[4]), std::stoi(argv[5]),
+                 (argc > 6) ? std::stoi(argv[6]) : 1,
+                 (argc > 7) ? argv[7] : "viewer",
+                 (argc > 8) ? argv[8] : "png");
+    return true;
+  }
+  if ((argc >= 3) && (argc <= 5) && (mode == "--smoothing-report")) {
+    report_light_smoothing(argv[2], (argc > 3) ? std::stoul(argv[3]) : 8,
+                           (argc > 4) ? std::stof(argv[4]) : 0.01f);
+    return true;
+  }
+  if (((argc == 3) || (argc == 4)) && (mode == "--degenerate-report")) {
+    report_degenerate_faces(argv[2], (argc > 3) ? std::stoul(argv[3]) : 5);
+    return true;
+  }
+  if (((argc == 3) || (argc == 4)) && (mode == "--deform-report")) {
+    report_deformation(argv[2], (argc > 3) ? std::stoul(argv[3]) : 30);
+    return true;
+  }
+  if ((argc >= 6) && (argc <= 8) && (mode == "--svg")) {
+    write_line_drawing(argv[2], argv[3], std::stoi(argv[4]),
+                       std::stoi(argv[5]),
+                       (argc > 6) ? std::stof(argv[6]) * pi / 180 : 0.0f,
+                       (argc > 7) ? std::stof(argv[7]) * pi / 180 : 0.0f);
+    return true;
+  }
+  if ((argc >= 6) && (argc <= 8) && (mode == "--compare-lines")) {
+    compare_line_modes(argv[2], argv[3], std::stoi(argv[4]),
+                       std::stoi(argv[5]),
+                       (argc > 6) ? std::stof(argv[6]) * pi / 180 : 0.0f,
+                       (argc > 7) ? std::stof(argv[7]) * pi / 180 : 0.0f);
+    return true;
+  }
+  if ((argc >= 6) && (argc <= 8) && (mode == "--best-views")) {
+    render_best_views(argv[2], argv[3], std::stoi(argv[4]),
+                      std::stoi(argv[5]), (argc > 6) ? std::stoul(argv[6]) : 4,
+                      (argc > 7) ? std::stoul(argv[7]) : 1 << 15);
+    return true;
+  }
+  if ((argc >= 3) && (argc <= 5) && (mode == "--bulk-load")) {
+    report_bulk_loading(argv[2],
+                        ((argc > 3) ? std::stoull(argv[3]) : 256) << 20,
+                        (argc > 4) ? std::stoul(argv[4]) : 64);
+    return true;
+  }
+  if (((argc == 3) || (argc == 5)) && (mode == "--memory-report")) {
+    report_memory(argv[2], (argc > 3) ? std::stoi(argv[3]) : 1024,
+                  (argc > 4) ? std::stoi(argv[4]) : 768);
+    return true;
+  }
+  return false;
+}
+
+}  // namespace
+
+// Batch processing without any window
+// Failures and invalid arguments lead to a non-zero exit status.
+int main(int argc, char* argv[]) {
+  try {
+    if (run_mode(argc, argv)) return 0;
+  } catch (const std::exception& e) {
+    std::cerr << "error: " << e.what() << endl;
+    return 1;
+  }
+  std::cerr << "usage:\n"
+            << argv[0] << " --out-of-core <binary STL file> <OBJ output file>\n"
+            << argv[0] << " --serve <socket path> [<memory budget in MiB>]\n"
+            << argv[0]
+            << " --render <mesh file> <output prefix> <width> <height>"
+               " [<frames> [<surface shader> [png|raw]]]\n"
+            << argv[0]
+            << " --smoothing-report <mesh file>"
+               " [<max iterations> [<threshold>]]\n"
+            << argv[0] << " --deform-report <mesh file> [<frames>]\n"
+            << argv[0] << " --degenerate-report <mesh file> [<runs>]\n"
+            << argv[0]
+            << " --bulk-load <directory>"
+               " [<memory budget in MiB> [<queue depth>]]\n"
+            << argv[0]
+            << " --best-views <mesh file> <output prefix> <width> <height>"
+               " [<count> [<max faces>]]\n"
+            << argv[0]
+            << " --svg <mesh file> <SVG output file> <width> <height>"
+               " [<azimuth> [<altitude>]]\n"
+            << argv[0]
+            << " --compare-lines <mesh file> <PNG output file> <width> <height>"
+               " [<azimuth> [<altitude>]]\n"
+            << argv[0] << " --memory-report <mesh file> [<width> <height>]\n"
+            << "environment:\n"
+            << "PEL_THREADS=<thread count> PEL_CORES=<cores, e.g. 0-3,8>\n";
+  return 1;
+}
@@ -1,20 +1,29 @@
 #pragma once
+#include "memory_usage.hpp"
 #include "utility.hpp"
 
 template <auto buffer_type>
 class buffer {
  public:
   buffer() { glGenBuffers(1, &handle); }
-  ~buffer() { glDeleteBuffers(1, &handle); }
+  ~buffer() {
+    remove_gpu_memory(stage, bytes);
+    glDeleteBuffers(1, &handle);
+  }
 
   // Copying is not allowed.
   buffer(const buffer&) = delete;
   buffer& operator=(const buffer&) = delete;
 
   // Moving
-  buffer(buffer&& x) : handle{x.handle} { x.handle = 0; }
+  buffer(buffer&& x) : handle{x.handle}, bytes{x.bytes}, stage{x.stage} {
+    x.handle = 0;
+    x.bytes = 0;
+  }
   buffer& operator=(buffer&& x) {
     swap(handle, x.handle);
+    swap(bytes, x.bytes);
+    swap(stage, x.stage);
     return *this;
   }
 
@@ -22,9 +31,27 @@ class buffer {
 
   void bind() const { glBindBuffer(buffer_type, handle); }
 
+  // Creates the data store and counts its size for the current memory
+  // stage. The copy target is used such that the element buffer of the
+  // bound vertex array and the bound array buffer stay unchanged.
+  void allocate(size_t size, const void* data, GLenum usage) {
+    glBindBuffer(GL_COPY_WRITE_BUFFER, handle);
+    glBufferData(GL_COPY_WRITE_BUFFER, size, data, usage);
+    remove_gpu_memory(stage, bytes);
+    bytes = size;
+    stage = current_memory_stage();
+    add_gpu_memory(stage, bytes);
+  }
+
+  // Size of the data store in bytes
+  auto size() const noexcept -> size_t { return bytes; }
+
   // private:
   GLuint handle{};  // value zero is ignored
+  size_t bytes{};
+  memory_stage_id stage{};
 };
 
 using vertex_buffer = buffer<GL_ARRAY_BUFFER>;
 using element_buffer = buffer<GL_ELEMENT_ARRAY_BUFFER>;
+using pixel_pack_buffer = buffer<GL_PIXEL_PACK_BUFFER>;
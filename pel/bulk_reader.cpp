@@ -0,0 +1,458 @@
+#include "bulk_reader.hpp"
+//
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <system_error>
+//
+#include <fcntl.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+//
+#include "task_scheduler.hpp"
+
+using namespace std;
+
+namespace {
+
+// Single reads are limited such that their length fits into a request.
+constexpr size_t max_read_size = size_t{1} << 30;
+
+// Sum of all buffers that are being read or consumed
+// or number of files that are open at the same time
+class budget {
+ public:
+  explicit budget(size_t limit) : limit{limit} {}
+
+  bool try_acquire(size_t bytes) {
+    scoped_lock lock{mutex};
+    if (!fits(bytes)) return false;
+    used += bytes;
+    peak = max(peak, used);
+    return true;
+  }
+
+  void release(size_t bytes) {
+    {
+      scoped_lock lock{mutex};
+      used -= bytes;
+    }
+    scheduler().notify();
+  }
+
+  // Helps executing pending tasks of the group until the given amount fits.
+  void wait(size_t bytes, const task_group& tasks) {
+    scheduler().wait(&tasks, [&] {
+      scoped_lock lock{mutex};
+      return fits(bytes);
+    });
+  }
+
+  auto peak_usage() const -> size_t {
+    scoped_lock lock{mutex};
+    return peak;
+  }
+
+ private:
+  bool fits(size_t bytes) const noexcept {
+    return !used || (used + bytes <= limit);
+  }
+
+  size_t limit{};
+  size_t used{};
+  size_t peak{};
+  mutable std::mutex mutex{};
+};
+
+// Open file together with the buffer for its content
+struct file_read {
+  file_read() = default;
+  ~file_read() {
+    if (fd != -1) close(fd);
+  }
+
+  // Copying is not allowed.
+  file_read(const file_read&) = delete;
+  file_read& operator=(const file_read&) = delete;
+
+  // Moving
+  file_read(file_read&& x)
+      : index{x.index},
+        fd{exchange(x.fd, -1)},
+        size{x.size},
+        done{x.done},
+        buffer{std::move(x.buffer)} {}
+  file_read& operator=(file_read&& x) {
+    swap(index, x.index);
+    swap(fd, x.fd);
+    swap(size, x.size);
+    swap(done, x.done);
+    swap(buffer, x.buffer);
+    return *this;
+  }
+
+  size_t index{};
+  int fd = -1;
+  size_t size{};
+  size_t done{};
+  unique_ptr<char[]> buffer{};
+};
+
+auto open_file(size_t index, const string& path) -> file_read {
+  file_read result{};
+  result.index = index;
+  result.fd = open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (result.fd == -1)
+    throw runtime_error("Failed to open file '" + path + "'.");
+  struct stat info;
+  if (fstat(result.fd, &info) == -1)
+    throw runtime_error("Failed to get size of file '" + path + "'.");
+  result.size = info.st_size;
+  return result;
+}
+
+// Closes the file and consumes its content on the scheduler.
+// The memory is released after the buffer has been freed.
+void finish(file_read&& file,
+            task_group& tasks,
+            budget& memory,
+            const function<void(size_t, string_view)>& consume) {
+  close(exchange(file.fd, -1));
+  tasks.run([&, file = make_shared<file_read>(std::move(file))] {
+    const auto size = file->size;
+    try {
+      consume(file->index, string_view{file->buffer.get(), size});
+    } catch (...) {
+      file->buffer.reset();
+      memory.release(size);
+      throw;
+    }
+    file->buffer.reset();
+    memory.release(size);
+  });
+}
+
+// Minimal io_uring instance that is only used for reads.
+// The rings are set up by raw system calls and memory mappings.
+// So the project does not depend on liburing.
+class io_ring {
+ public:
+  explicit io_ring(unsigned entries) {
+    io_uring_params params{};
+    fd = syscall(__NR_io_uring_setup, entries, &params);
+    if (fd < 0)
+      throw system_error(errno, system_category(), "Failed to set up io_uring");
+    try {
+      map_rings(params);
+    } catch (...) {
+      unmap_rings();
+      close(fd);
+      throw;
+    }
+  }
+
+  ~io_ring() {
+    unmap_rings();
+    close(fd);
+  }
+
+  // Copying is not allowed.
+  io_ring(const io_ring&) = delete;
+  io_ring& operator=(const io_ring&) = delete;
+
+  // For now, moving is not allowed.
+  io_ring(io_ring&&) = delete;
+  io_ring& operator=(io_ring&&) = delete;
+
+  auto capacity() const noexcept -> unsigned { return entries; }
+
+  // The caller must not queue more reads than the capacity
+  // whose completions have not been processed.
+  void push_read(int file, char* data, size_t bytes, size_t offset,
+                 uint64_t user_data) noexcept {
+    const auto tail = *sq_tail;
+    const auto i = tail & *sq_mask;
+    auto& e = sqes[i];
+    memset(&e, 0, sizeof(e));
+    e.opcode = IORING_OP_READ;
+    e.fd = file;
+    e.addr = reinterpret_cast<uint64_t>(data);
+    e.len = static_cast<uint32_t>(min(bytes, max_read_size));
+    e.off = offset;
+    e.user_data = user_data;
+    sq_array[i] = i;
+    // The kernel must see the entry before the new tail.
+    atomic_ref{*sq_tail}.store(tail + 1, memory_order_release);
+    ++queued;
+  }
+
+  // Submits all queued reads and waits for the given number of completions.
+  void submit(unsigned wait_count) {
+    while (queued || wait_count) {
+      const auto result =
+          syscall(__NR_io_uring_enter, fd, queued, wait_count,
+                  wait_count ? IORING_ENTER_GETEVENTS : 0u, nullptr, 0);
+      if (result < 0) {
+        if (errno == EINTR) continue;
+        throw system_error(errno, system_category(),
+                           "Failed to enter io_uring");
+      }
+      queued -= result;
+      wait_count = 0;
+    }
+  }
+
+  // Calls the given function with the user data and the result
+  // of every completion that has not been processed before.
+  void for_each_completion(auto&& f) {
+    auto head = *cq_head;
+    const auto tail = atomic_ref{*cq_tail}.load(memory_order_acquire);
+    for (; head != tail; ++head) {
+      // The entry is copied because the kernel reuses it after advancing.
+      // Advancing first keeps a throwing function from
+      // leaving the completion in the queue.
+      const auto c = cqes[head & *cq_mask];
+      atomic_ref{*cq_head}.store(head + 1, memory_order_release);
+      f(c.user_data, c.res);
+    }
+  }
+
+ private:
+  void map_rings(const io_uring_params& params) {
+    entries = params.sq_entries;
+    sq_size = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    cq_size = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    // Newer kernels map both rings at once.
+    const bool single_map = params.features & IORING_FEAT_SINGLE_MMAP;
+    if (single_map) sq_size = cq_size = max(sq_size, cq_size);
+    sq_ptr = map(sq_size, IORING_OFF_SQ_RING);
+    cq_ptr = single_map ? sq_ptr : map(cq_size, IORING_OFF_CQ_RING);
+    sqes_size = params.sq_entries * sizeof(io_uring_sqe);
+    sqes = static_cast<io_uring_sqe*>(map(sqes_size, IORING_OFF_SQES));
+
+    const auto sq = static_cast<char*>(sq_ptr);
+    sq_tail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    sq_mask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    sq_array = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    const auto cq = static_cast<char*>(cq_ptr);
+    cq_head = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    cq_tail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    cq_mask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  }
+
+  auto map(size_t bytes, off_t offset) -> void* {
+    const auto p = mmap(nullptr, bytes, PROT_READ | PROT_WRITE,
+                        MAP_SHARED | MAP_POPULATE, fd, offset);
+    if (p == MAP_FAILED)
+      throw system_error(errno, system_category(), "Failed to map io_uring");
+    return p;
+  }
+
+  void unmap_rings() noexcept {
+    if (sqes) munmap(sqes, sqes_size);
+    if (cq_ptr && (cq_ptr != sq_ptr)) munmap(cq_ptr, cq_size);
+    if (sq_ptr) munmap(sq_ptr, sq_size);
+  }
+
+  int fd = -1;
+  unsigned entries{};
+  unsigned queued{};
+  void* sq_ptr = nullptr;
+  void* cq_ptr = nullptr;
+  size_t sq_size{};
+  size_t cq_size{};
+  io_uring_sqe* sqes = nullptr;
+  size_t sqes_size{};
+  unsigned* sq_tail{};
+  unsigned* sq_mask{};
+  unsigned* sq_array{};
+  unsigned* cq_head{};
+  unsigned* cq_tail{};
+  unsigned* cq_mask{};
+  io_uring_cqe* cqes{};
+};
+
+// Every slot of the ring holds one file with at most one read in flight.
+// Reads that return less than requested are continued at their end.
+void read_with_ring(io_ring& ring,
+                    span<const string> paths,
+                    task_group& tasks,
+                    budget& memory,
+                    const function<void(size_t, string_view)>& consume,
+                    bulk_read_statistics& stats) {
+  vector<file_read> slots(ring.capacity());
+  vector<uint64_t> free_slots{};
+  for (size_t i = slots.size(); i > 0; --i) free_slots.push_back(i - 1);
+  size_t in_flight = 0;
+  size_t next = 0;
+  optional<file_read> pending{};
+
+  const auto push = [&](uint64_t slot) {
+    auto& file = slots[slot];
+    ring.push_read(file.fd, file.buffer.get() + file.done,
+                   file.size - file.done, file.done, slot);
+    ++in_flight;
+  };
+
+  const auto complete = [&](uint64_t slot, int result) {
+    --in_flight;
+    auto& file = slots[slot];
+    const auto& path = paths[file.index];
+    if (result < 0)
+      throw system_error(-result, system_category(),
+                         "Failed to read file '" + path + "'");
+    if (result == 0)
+      throw runtime_error("File '" + path + "' has been truncated.");
+    file.done += result;
+    if (file.done < file.size) {
+      push(slot);
+      return;
+    }
+    free_slots.push_back(slot);
+    finish(std::move(file), tasks, memory, consume);
+  };
+
+  try {
+    while ((next < paths.size()) || pending || in_flight) {
+      // Start new reads while there are free slots and enough memory.
+      while (!free_slots.empty()) {
+        if (!pending) {
+          if (next == paths.size()) break;
+          pending = open_file(next, paths[next]);
+          ++next;
+        }
+        if (!memory.try_acquire(pending->size)) break;
+        ++stats.files;
+        stats.bytes += pending->size;
+        if (!pending->size) {
+          finish(std::move(*pending), tasks, memory, consume);
+          pending.reset();
+          continue;
+        }
+        pending->buffer = make_unique_for_overwrite<char[]>(pending->size);
+        const auto slot = free_slots.back();
+        free_slots.pop_back();
+        slots[slot] = std::move(*pending);
+        pending.reset();
+        push(slot);
+      }
+
+      if (in_flight) {
+        ring.submit(1);
+        ring.for_each_completion(complete);
+      } else if (pending) {
+        memory.wait(pending->size, tasks);
+      }
+    }
+  } catch (...) {
+    // The kernel may still write into the buffers of reads in flight.
+    // So all of them have to be completed before the buffers are freed.
+    try {
+      while (in_flight) {
+        ring.submit(1);
+        ring.for_each_completion([&](uint64_t, int) { --in_flight; });
+      }
+    } catch (...) {
+    }
+    throw;
+  }
+}
+
+// Fallback for kernels without io_uring
+// Every file is read by a task on its own. Like the queue depth of
+// the ring, the number of open files is limited. Otherwise, thousands
+// of files would exceed the limit of file descriptors.
+void read_with_tasks(span<const string> paths,
+                     task_group& tasks,
+                     budget& memory,
+                     const function<void(size_t, string_view)>& consume,
+                     bulk_read_statistics& stats,
+                     size_t queue_depth) {
+  budget open_files{queue_depth};
+  // Tasks refer to the limit of open files.
+  // So they have to be finished before it is destroyed.
+  try {
+    for (size_t i = 0; i < paths.size(); ++i) {
+      open_files.wait(1, tasks);
+      open_files.try_acquire(1);
+      auto file = open_file(i, paths[i]);
+      memory.wait(file.size, tasks);
+      memory.try_acquire(file.size);
+      ++stats.files;
+      stats.bytes += file.size;
+      tasks.run([&, file = make_shared<file_read>(std::move(file))] {
+        const auto& path = paths[file->index];
+        try {
+          file->buffer = make_unique_for_overwrite<char[]>(file->size);
+          while (file->done < file->size) {
+            const auto result =
+                pread(file->fd, file->buffer.get() + file->done,
+                      min(file->size - file->done, max_read_size), file->done);
+            if (result < 0) {
+              if (errno == EINTR) continue;
+              throw system_error(errno, system_category(),
+                                 "Failed to read file '" + path + "'");
+            }
+            if (result == 0)
+              throw runtime_error("File '" + path + "' has been truncated.");
+            file->done += result;
+          }
+        } catch (...) {
+          close(exchange(file->fd, -1));
+          open_files.release(1);
+          file->buffer.reset();
+          memory.release(file->size);
+          throw;
+        }
+        // Consumption is started as task of its own.
+        // So reading and consuming can be stolen independently.
+        finish(std::move(*file), tasks, memory, consume);
+        open_files.release(1);
+      });
+    }
+  } catch (...) {
+    try {
+      tasks.wait();
+    } catch (...) {
+    }
+    throw;
+  }
+  tasks.wait();
+}
+
+}  // namespace
+
+auto read_files(
+    span<const string> paths,
+    const function<void(size_t index, string_view content)>& consume,
+    const bulk_read_options& options) -> bulk_read_statistics {
+  bulk_read_statistics stats{};
+  budget memory{options.memory_budget};
+  // Tasks refer to the budget. So they have to be finished before.
+  task_group tasks{};
+
+  optional<io_ring> ring{};
+  if (options.use_io_uring) {
+    try {
+      ring.emplace(static_cast<unsigned>(
+          bit_ceil(clamp<size_t>(options.queue_depth, 1, 4096))));
+    } catch (const system_error&) {
+      // Seccomp filters of containers often forbid io_uring.
+    }
+  }
+
+  stats.io_uring = ring.has_value();
+  if (ring)
+    read_with_ring(*ring, paths, tasks, memory, consume, stats);
+  else
+    read_with_tasks(paths, tasks, memory, consume, stats,
+                    clamp<size_t>(options.queue_depth, 1, 4096));
+  tasks.wait();
+  stats.peak_memory = memory.peak_usage();
+  return stats;
+}
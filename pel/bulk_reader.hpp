@@ -0,0 +1,35 @@
+#pragma once
+#include <functional>
+//
+#include "utility.hpp"
+
+struct bulk_read_options {
+  // Maximum number of files whose reads are in flight at the same time
+  size_t queue_depth = 64;
+  // Upper bound for the sum of all buffers that are being read or consumed.
+  // A file larger than the budget is only read when no other buffer is alive.
+  size_t memory_budget = size_t{256} << 20;
+  // Without io_uring, every file is read by a task of the scheduler.
+  bool use_io_uring = true;
+};
+
+struct bulk_read_statistics {
+  size_t files{};
+  size_t bytes{};
+  size_t peak_memory{};
+  bool io_uring{};
+};
+
+// Reads the whole content of many files asynchronously. Files are opened
+// in the given order and their reads are kept in flight by io_uring.
+// If the kernel does not provide io_uring, tasks of the scheduler read
+// the files instead. As soon as the content of a file is complete,
+// a task is started that calls the given function with the index of
+// the file and its content. The content is only valid during the call.
+// Its buffer is freed afterwards and only then counts no longer against
+// the memory budget. So the consumption throttles the reading.
+// The first error of reading or consuming is rethrown.
+auto read_files(
+    std::span<const string> paths,
+    const std::function<void(size_t index, std::string_view content)>& consume,
+    const bulk_read_options& options = {}) -> bulk_read_statistics;
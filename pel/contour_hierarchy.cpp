@@ -0,0 +1,119 @@
+#include "contour_hierarchy.hpp"
+
+using namespace std;
+
+namespace {
+
+auto merge(const mesh_cluster& x, const mesh_cluster& y) -> mesh_cluster {
+  mesh_cluster result{};
+  // Clusters of the same parent are stored consecutively.
+  result.first_face = x.first_face;
+  result.face_count = x.face_count + y.face_count;
+
+  // Smallest sphere containing both spheres
+  const auto d = distance(x.center, y.center);
+  if (d + y.radius <= x.radius) {
+    result.center = x.center;
+    result.radius = x.radius;
+  } else if (d + x.radius <= y.radius) {
+    result.center = y.center;
+    result.radius = y.radius;
+  } else {
+    result.radius = (d + x.radius + y.radius) / 2;
+    result.center =
+        x.center + (result.radius - x.radius) / d * (y.center - x.center);
+  }
+
+  // Smallest cone containing both cones
+  const auto phi = acos(clamp(dot(x.cone_axis, y.cone_axis), -1.0f, 1.0f));
+  if (phi + y.cone_angle <= x.cone_angle) {
+    result.cone_axis = x.cone_axis;
+    result.cone_angle = x.cone_angle;
+  } else if (phi + x.cone_angle <= y.cone_angle) {
+    result.cone_axis = y.cone_axis;
+    result.cone_angle = y.cone_angle;
+  } else {
+    const auto angle = (phi + x.cone_angle + y.cone_angle) / 2;
+    if ((angle >= pi) || (sin(phi) < 1e-6f)) {
+      result.cone_axis = x.cone_axis;
+      result.cone_angle = pi;
+    } else {
+      // Rotate the first axis towards the second one.
+      const auto t = (angle - x.cone_angle) / phi;
+      result.cone_axis = normalize(sin((1 - t) * phi) * x.cone_axis +
+                                   sin(t * phi) * y.cone_axis);
+      result.cone_angle = angle;
+    }
+  }
+  return result;
+}
+
+}  // namespace
+
+contour_hierarchy::contour_hierarchy(const vector<mesh_cluster>& clusters) {
+  if (clusters.empty()) return;
+  levels.push_back(clusters);
+  while (levels.back().size() > 1) {
+    const auto& children = levels.back();
+    vector<mesh_cluster> parents{};
+    parents.reserve((children.size() + 1) / 2);
+    for (size_t i = 0; i + 1 < children.size(); i += 2)
+      parents.push_back(merge(children[i], children[i + 1]));
+    if (children.size() % 2) parents.push_back(children.back());
+    levels.push_back(std::move(parents));
+  }
+}
+
+auto contour_hierarchy::extract(const mesh_geometry& mesh,
+                                vec3 eye,
+                                vector<vec3>& segments) const -> statistics {
+  statistics stats{};
+  stats.face_count = mesh.faces.size();
+  for (const auto& level : levels) stats.node_count += level.size();
+  if (levels.empty()) return stats;
+
+  const auto first_segment = segments.size();
+  vector<pair<size_t, size_t>> stack{{levels.size() - 1, 0}};
+  while (!stack.empty()) {
+    const auto [k, i] = stack.back();
+    stack.pop_back();
+    ++stats.visited_nodes;
+    const auto& node = levels[k][i];
+    if (!may_contain_contour(node, eye)) continue;
+
+    if (k > 0) {
+      const auto& children = levels[k - 1];
+      if (2 * i + 1 < children.size()) stack.push_back({k - 1, 2 * i + 1});
+      stack.push_back({k - 1, 2 * i});
+      continue;
+    }
+
+    // The view transformation is rigid. Hence, the signs of the shader
+    // given in view space equal the ones in world space.
+    stats.tested_faces += node.face_count;
+    for (auto j = node.first_face; j < node.first_face + node.face_count;
+         ++j) {
+      const auto& f = mesh.faces[j];
+      const auto& a = mesh.vertices[f[0]].position;
+      const auto& b = mesh.vertices[f[1]].position;
+      const auto& c = mesh.vertices[f[2]].position;
+      const auto sa = dot(mesh.vertices[f[0]].normal, a - eye);
+      const auto sb = dot(mesh.vertices[f[1]].normal, b - eye);
+      const auto sc = dot(mesh.vertices[f[2]].normal, c - eye);
+
+      // Interpolation in clip space equals interpolation in world space
+      // because the projection is linear in homogeneous coordinates.
+      const auto size = segments.size();
+      if (sa * sb < 0)
+        segments.push_back((abs(sb) * a + abs(sa) * b) / (abs(sa) + abs(sb)));
+      if (sa * sc < 0)
+        segments.push_back((abs(sc) * a + abs(sa) * c) / (abs(sa) + abs(sc)));
+      if (sb * sc < 0)
+        segments.push_back((abs(sc) * b + abs(sb) * c) / (abs(sb) + abs(sc)));
+      // Like the geometry shader, single points are no line strip.
+      if (segments.size() - size == 1) segments.pop_back();
+    }
+  }
+  stats.segments = (segments.size() - first_segment) / 2;
+  return stats;
+}
@@ -0,0 +1,34 @@
+#pragma once
+#include "mesh_clusters.hpp"
+#include "model.hpp"
+#include "utility.hpp"
+
+// Hierarchy of bounding spheres and normal cones over the clusters of a mesh
+// in the style of Sander et al. "Silhouette Clipping".
+// Its nodes are merged pairwise from the Morton ordered clusters.
+// Subtrees that can not contain a contour for the current eye point are
+// skipped. Hence, the extraction time mainly depends on the contour length.
+class contour_hierarchy {
+ public:
+  struct statistics {
+    size_t visited_nodes{};
+    size_t node_count{};
+    size_t tested_faces{};
+    size_t face_count{};
+    size_t segments{};
+  };
+
+  contour_hierarchy() = default;
+  explicit contour_hierarchy(const vector<mesh_cluster>& clusters);
+
+  // Appends contour segments as pairs of points to 'segments'.
+  // The points are interpolated like in the contour shader.
+  auto extract(const mesh_geometry& mesh,
+               vec3 eye,
+               vector<vec3>& segments) const -> statistics;
+
+ private:
+  // The first level consists of the clusters. The children of
+  // node 'i' on level 'k' are the nodes '2i' and '2i + 1' on level 'k - 1'.
+  vector<vector<mesh_cluster>> levels{};
+};
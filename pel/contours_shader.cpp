@@ -1,4 +1,6 @@
 #include "contours_shader.hpp"
+//
+#include "line_renderer.hpp"
 
 namespace {
 
@@ -7,17 +9,21 @@ constexpr czstring vertex_shader_text =
 
     "uniform mat4 projection;"
     "uniform mat4 view;"
+    "uniform mat4 model = mat4(1.0);"
 
     "layout (location = 0) in vec3 p;"
     "layout (location = 1) in vec3 n;"
+    "layout (location = 7) in vec3 offset;"
 
     "out vec3 position;"
     "out vec3 normal;"
 
     "void main(){"
-    "  gl_Position = projection * view * vec4(p, 1.0);"
-    "  position = vec3(view * vec4(p, 1.0));"
-    "  normal = vec3(view * vec4(n, 0.0));"
+    "  vec4 x = model * vec4(p, 1.0) + vec4(offset, 0.0);"
+    "  vec3 m = normalize(mat3(model) * n);"
+    "  gl_Position = projection * view * x;"
+    "  position = vec3(view * x);"
+    "  normal = vec3(view * vec4(m, 0.0));"
     "}";
 
 constexpr czstring geometry_shader_text =
@@ -31,6 +37,8 @@ constexpr czstring geometry_shader_text =
     "in vec3 position[];"
     "in vec3 normal[];"
 
+    "out float strength;"
+
     "void main(){"
     "  vec4 a = gl_in[0].gl_Position;"
     "  vec4 b = gl_in[1].gl_Position;"
@@ -42,14 +50,17 @@ constexpr czstring geometry_shader_text =
 
     "  if (sa * sb < 0) {"
     "    gl_Position = ((abs(sb) * a + abs(sa) * b) / (abs(sa) + abs(sb)));"
+    "    strength = 1.0;"
     "    EmitVertex();"
     "  }"
     "  if (sa * sc < 0) {"
     "    gl_Position = ((abs(sc) * a + abs(sa) * c) / (abs(sa) + abs(sc)));"
+    "    strength = 1.0;"
     "    EmitVertex();"
     "  }"
     "  if (sb * sc < 0) {"
     "    gl_Position = ((abs(sc) * b + abs(sb) * c) / (abs(sb) + abs(sc)));"
+    "    strength = 1.0;"
     "    EmitVertex();"
     "  }"
     "  EndPrimitive();"
@@ -68,5 +79,7 @@ auto contours_shader() -> shader_program {
   vertex_shader vs{vertex_shader_text};
   geometry_shader gs{geometry_shader_text};
   fragment_shader fs{fragment_shader_text};
-  return shader_program{vs, gs, fs};
+  shader_program shader{vs, gs, fs};
+  shader.capture(line_capture_varyings);
+  return shader;
 }
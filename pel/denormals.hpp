@@ -0,0 +1,37 @@
+#pragma once
+#if defined(__SSE__)
+#include <xmmintrin.h>
+#endif
+//
+#include "utility.hpp"
+
+// Sets flush-to-zero and denormals-are-zero for the calling thread
+// and restores the previous mode when the object is destroyed.
+// Tiny intermediate results of the illumination kernels then become zero
+// instead of taking the slow microcode path of subnormal numbers.
+// Without SSE, the floating-point mode is left unchanged.
+class denormals_as_zero {
+ public:
+#if defined(__SSE__)
+  denormals_as_zero() noexcept : mode{_mm_getcsr()} {
+    // Bit 15 enables flush-to-zero and bit 6 denormals-are-zero.
+    _mm_setcsr(mode | 0x8040);
+  }
+  ~denormals_as_zero() { _mm_setcsr(mode); }
+#else
+  denormals_as_zero() noexcept = default;
+#endif
+
+  // Copying is not allowed.
+  denormals_as_zero(const denormals_as_zero&) = delete;
+  denormals_as_zero& operator=(const denormals_as_zero&) = delete;
+
+  // For now, moving is not allowed.
+  denormals_as_zero(denormals_as_zero&&) = delete;
+  denormals_as_zero& operator=(denormals_as_zero&&) = delete;
+
+ private:
+#if defined(__SSE__)
+  unsigned int mode;
+#endif
+};
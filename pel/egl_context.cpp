@@ -0,0 +1,74 @@
+#include "egl_context.hpp"
+
+using namespace std;
+
+namespace {
+
+// The surfaceless platform of Mesa does not need any display server.
+// Other implementations fall back to their default display.
+auto surfaceless_display() -> EGLDisplay {
+  const auto get_platform_display =
+      reinterpret_cast<PFNEGLGETPLATFORMDISPLAYEXTPROC>(
+          eglGetProcAddress("eglGetPlatformDisplayEXT"));
+  if (get_platform_display) {
+    const auto display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA,
+                                              EGL_DEFAULT_DISPLAY, nullptr);
+    if (display != EGL_NO_DISPLAY) return display;
+  }
+  return eglGetDisplay(EGL_DEFAULT_DISPLAY);
+}
+
+}  // namespace
+
+void egl_context::init() {
+  display = surfaceless_display();
+  if (display == EGL_NO_DISPLAY)
+    throw runtime_error("Failed to get EGL display.");
+  if (!eglInitialize(display, nullptr, nullptr))
+    throw runtime_error("Failed to initialize EGL.");
+
+  try {
+    if (!eglBindAPI(EGL_OPENGL_API))
+      throw runtime_error("Failed to bind OpenGL API for EGL.");
+
+    // The default surface type would require window support.
+    const EGLint config_attributes[] = {EGL_SURFACE_TYPE, EGL_PBUFFER_BIT,
+                                        EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+                                        EGL_NONE};
+    EGLConfig config;
+    EGLint configs;
+    if (!eglChooseConfig(display, config_attributes, &config, 1, &configs) ||
+        !configs)
+      throw runtime_error("Failed to choose EGL configuration.");
+
+    const EGLint context_attributes[] = {
+        EGL_CONTEXT_MAJOR_VERSION,
+        3,
+        EGL_CONTEXT_MINOR_VERSION,
+        3,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK,
+        EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE};
+    context =
+        eglCreateContext(display, config, EGL_NO_CONTEXT, context_attributes);
+    if (context == EGL_NO_CONTEXT)
+      throw runtime_error("Failed to create EGL context.");
+
+    if (!eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, context))
+      throw runtime_error("Failed to make EGL context current.");
+  } catch (...) {
+    free();
+    throw;
+  }
+
+  glbinding::initialize(eglGetProcAddress);
+}
+
+void egl_context::free() {
+  if (context != EGL_NO_CONTEXT) {
+    eglMakeCurrent(display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+    eglDestroyContext(display, context);
+    context = EGL_NO_CONTEXT;
+  }
+  eglTerminate(display);
+}
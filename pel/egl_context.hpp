@@ -0,0 +1,31 @@
+#pragma once
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+//
+#include "utility.hpp"
+
+// OpenGL 3.3 core context without any window or surface.
+// Rendering is only possible into framebuffer objects.
+// It enables rendering on machines without a window system,
+// for example by Mesa's software rasterizer llvmpipe.
+// We use this class for RAII functionality and exception safety.
+class egl_context {
+ public:
+  egl_context() { init(); }
+  ~egl_context() { free(); }
+
+  // Copying is not allowed.
+  egl_context(const egl_context&) = delete;
+  egl_context& operator=(const egl_context&) = delete;
+
+  // For now, moving is not allowed.
+  egl_context(egl_context&&) = delete;
+  egl_context& operator=(egl_context&&) = delete;
+
+ private:
+  void init();
+  void free();
+
+  EGLDisplay display{EGL_NO_DISPLAY};
+  EGLContext context{EGL_NO_CONTEXT};
+};
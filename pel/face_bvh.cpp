@@ -0,0 +1,327 @@
+#include "face_bvh.hpp"
+//
+#include <algorithm>
+#include <atomic>
+#include <limits>
+//
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace {
+
+constexpr size_t bin_count = 16;
+// Ranges with more faces are binned in parallel
+// and their children are built as tasks.
+constexpr size_t parallel_size = size_t{1} << 15;
+// Deeper nodes are split at their median such that
+// the depth of the tree stays bounded for the traversal stack.
+constexpr size_t max_sah_depth = 64;
+constexpr size_t max_depth = 128;
+
+struct aabb {
+  vec3 min{numeric_limits<float>::infinity()};
+  vec3 max{-numeric_limits<float>::infinity()};
+
+  void grow(vec3 p) noexcept {
+    min = glm::min(min, p);
+    max = glm::max(max, p);
+  }
+  void grow(const aabb& x) noexcept {
+    min = glm::min(min, x.min);
+    max = glm::max(max, x.max);
+  }
+  auto area() const noexcept -> float {
+    const auto d = max - min;
+    return (d.x < 0) ? 0.0f : d.x * d.y + d.y * d.z + d.z * d.x;
+  }
+};
+
+struct bin {
+  aabb bounds{};
+  size_t count{};
+};
+
+using bins = array<array<bin, bin_count>, 3>;
+
+// Bounds of the faces and of their centroids
+using range_bounds = pair<aabb, aabb>;
+
+template <typename T, typename F, typename G>
+auto reduce(uint32_t first, uint32_t last, T init, F&& f, G&& combine) -> T {
+  if (last - first < parallel_size) return f(first, last);
+  return parallel_reduce(first, last, init, f, combine);
+}
+
+}  // namespace
+
+struct face_bvh::builder {
+  void build(uint32_t index, uint32_t first, uint32_t last, size_t depth) {
+    const auto [bounds, centroid_bounds] = reduce(
+        first, last, range_bounds{},
+        [&](size_t b, size_t e) {
+          range_bounds r{};
+          for (auto i = b; i < e; ++i) {
+            r.first.grow(face_bounds[indices[i]]);
+            r.second.grow(centroids[indices[i]]);
+          }
+          return r;
+        },
+        [](range_bounds x, const range_bounds& y) {
+          x.first.grow(y.first);
+          x.second.grow(y.second);
+          return x;
+        });
+    auto& n = nodes[index];
+    n.aabb_min = bounds.min;
+    n.aabb_max = bounds.max;
+
+    const auto count = last - first;
+    if (count <= 2) {
+      make_leaf(n, first, count);
+      return;
+    }
+
+    const auto mid = split(first, last, depth, bounds, centroid_bounds);
+    if (mid == first) {
+      make_leaf(n, first, count);
+      return;
+    }
+
+    const auto children = node_count.fetch_add(2);
+    n.index = children;
+    n.count = 0;
+    if (count < parallel_size) {
+      build(children, first, mid, depth + 1);
+      build(children + 1, mid, last, depth + 1);
+      return;
+    }
+    task_group tasks{};
+    tasks.run([&, children, first, mid, depth] {
+      build(children, first, mid, depth + 1);
+    });
+    build(children + 1, mid, last, depth + 1);
+    tasks.wait();
+  }
+
+  // Partitions the range and returns the first index of the second child.
+  // Returns 'first' if the range should become a leaf.
+  auto split(uint32_t first,
+             uint32_t last,
+             size_t depth,
+             const aabb& bounds,
+             const aabb& centroid_bounds) -> uint32_t {
+    const auto count = last - first;
+    const auto extent = centroid_bounds.max - centroid_bounds.min;
+    const auto median = first + count / 2;
+    const bool degenerate = !(max(extent.x, max(extent.y, extent.z)) > 0);
+    if (degenerate || (depth >= max_sah_depth)) {
+      if (count <= max_leaf_size) return first;
+      // Equal centroids can not be separated by their position.
+      if (degenerate) return median;
+      const auto axis =
+          (extent.x > extent.y) ? ((extent.x > extent.z) ? 0 : 2)
+                                : ((extent.y > extent.z) ? 1 : 2);
+      nth_element(&indices[first], &indices[median], &indices[0] + last,
+                  [&](uint32_t i, uint32_t j) {
+                    return centroids[i][axis] < centroids[j][axis];
+                  });
+      return median;
+    }
+
+    vec3 scale{};
+    for (int axis = 0; axis < 3; ++axis)
+      if (extent[axis] > 0) scale[axis] = bin_count / extent[axis];
+    const auto bin_index = [&](uint32_t face, int axis) {
+      const auto x =
+          (centroids[face][axis] - centroid_bounds.min[axis]) * scale[axis];
+      return min(size_t(x), bin_count - 1);
+    };
+    const auto b = reduce(
+        first, last, bins{},
+        [&](size_t begin, size_t end) {
+          bins r{};
+          for (auto i = begin; i < end; ++i)
+            for (int axis = 0; axis < 3; ++axis) {
+              auto& x = r[axis][bin_index(indices[i], axis)];
+              x.bounds.grow(face_bounds[indices[i]]);
+              ++x.count;
+            }
+          return r;
+        },
+        [](bins x, const bins& y) {
+          for (int axis = 0; axis < 3; ++axis)
+            for (size_t k = 0; k < bin_count; ++k) {
+              x[axis][k].bounds.grow(y[axis][k].bounds);
+              x[axis][k].count += y[axis][k].count;
+            }
+          return x;
+        });
+
+    // The cost of a split is given relative to the cost of testing one
+    // triangle. Traversing a node is assumed to cost as much.
+    float best_cost = numeric_limits<float>::infinity();
+    int best_axis = 0;
+    size_t best_split = 0;
+    for (int axis = 0; axis < 3; ++axis) {
+      // Sweep from the right to get the cost of all right sides.
+      array<float, bin_count> right_cost{};
+      aabb right{};
+      size_t right_count = 0;
+      for (size_t k = bin_count - 1; k > 0; --k) {
+        right.grow(b[axis][k].bounds);
+        right_count += b[axis][k].count;
+        right_cost[k] = right.area() * right_count;
+      }
+      aabb left{};
+      size_t left_count = 0;
+      for (size_t k = 1; k < bin_count; ++k) {
+        left.grow(b[axis][k - 1].bounds);
+        left_count += b[axis][k - 1].count;
+        if (!left_count || (left_count == count)) continue;
+        const auto cost = left.area() * left_count + right_cost[k];
+        if (cost < best_cost) {
+          best_cost = cost;
+          best_axis = axis;
+          best_split = k;
+        }
+      }
+    }
+    const auto area = bounds.area();
+    const auto split_cost = 1 + ((area > 0) ? best_cost / area : 0.0f);
+    if (!isfinite(best_cost)) return (count <= max_leaf_size) ? first : median;
+    if ((split_cost >= count) && (count <= max_leaf_size)) return first;
+
+    const auto it = partition(&indices[first], &indices[0] + last,
+                              [&](uint32_t face) {
+                                return bin_index(face, best_axis) < best_split;
+                              });
+    return it - &indices[0];
+  }
+
+  void make_leaf(face_bvh::node& n, uint32_t first, uint32_t count) noexcept {
+    n.index = first;
+    n.count = count;
+  }
+
+  size_t max_leaf_size{};
+  vector<aabb> face_bounds{};
+  vector<vec3> centroids{};
+  vector<uint32_t> indices{};
+  vector<face_bvh::node> nodes{};
+  atomic<uint32_t> node_count{1};
+};
+
+face_bvh::face_bvh(const mesh_geometry& mesh, size_t max_leaf_size) {
+  const auto n = mesh.faces.size();
+  if (!n) return;
+
+  builder b{};
+  b.max_leaf_size = max(max_leaf_size, size_t{2});
+  b.face_bounds.resize(n);
+  b.centroids.resize(n);
+  b.indices.resize(n);
+  // A binary tree with at least one face per leaf has less than 2n nodes.
+  b.nodes.resize(2 * n);
+  parallel_for(size_t{0}, n, [&](size_t i) {
+    aabb box{};
+    for (auto j : mesh.faces[i]) box.grow(mesh.vertices[j].position);
+    b.face_bounds[i] = box;
+    b.centroids[i] = 0.5f * (box.min + box.max);
+    b.indices[i] = i;
+  });
+  b.build(0, 0, n, 0);
+  b.nodes.resize(b.node_count);
+  b.nodes.shrink_to_fit();
+  nodes = std::move(b.nodes);
+
+  triangles.resize(n);
+  parallel_for(size_t{0}, n, [&](size_t i) {
+    const auto& f = mesh.faces[b.indices[i]];
+    const auto a = mesh.vertices[f[0]].position;
+    triangles[i] = {a, mesh.vertices[f[1]].position - a,
+                    mesh.vertices[f[2]].position - a};
+  });
+}
+
+bool face_bvh::occluded(vec3 origin,
+                        vec3 dir,
+                        float max_distance) const noexcept {
+  if (nodes.empty()) return false;
+  // Division by zero gives infinities that the slab test handles.
+  const auto inv_dir = 1.0f / dir;
+  const auto hits = [&](const node& x, float& distance) {
+    const auto t0 = (x.aabb_min - origin) * inv_dir;
+    const auto t1 = (x.aabb_max - origin) * inv_dir;
+    const auto entry = glm::min(t0, t1);
+    const auto exit = glm::max(t0, t1);
+    distance = max(max(entry.x, entry.y), max(entry.z, 0.0f));
+    return distance <= min(min(exit.x, exit.y), min(exit.z, max_distance));
+  };
+  const auto intersects = [&](const triangle& x) {
+    // Möller-Trumbore
+    const auto p = cross(dir, x.ac);
+    const auto det = dot(x.ab, p);
+    if (det == 0) return false;
+    const auto inv_det = 1.0f / det;
+    const auto s = origin - x.a;
+    const auto u = dot(s, p) * inv_det;
+    if ((u < 0) || (u > 1)) return false;
+    const auto q = cross(s, x.ab);
+    const auto v = dot(dir, q) * inv_det;
+    if ((v < 0) || (u + v > 1)) return false;
+    const auto t = dot(x.ac, q) * inv_det;
+    return (t > 0) && (t < max_distance);
+  };
+
+  float distance;
+  if (!hits(nodes[0], distance)) return false;
+  uint32_t stack[max_depth];
+  size_t size = 0;
+  uint32_t current = 0;
+  while (true) {
+    const auto& x = nodes[current];
+    if (x.count) {
+      for (auto i = x.index; i < x.index + x.count; ++i)
+        if (intersects(triangles[i])) return true;
+    } else {
+      // Both children are tested before descending
+      // such that the nearer one is visited first.
+      float d0, d1;
+      const bool h0 = hits(nodes[x.index], d0);
+      const bool h1 = hits(nodes[x.index + 1], d1);
+      if (h0 && h1) {
+        const auto near = (d1 < d0) ? x.index + 1 : x.index;
+        stack[size++] = (near == x.index) ? x.index + 1 : x.index;
+        current = near;
+        continue;
+      }
+      if (h0 || h1) {
+        current = h0 ? x.index : x.index + 1;
+        continue;
+      }
+    }
+    if (!size) return false;
+    current = stack[--size];
+  }
+}
+
+auto face_bvh::stats() const -> statistics {
+  statistics result{};
+  result.nodes = nodes.size();
+  result.faces = triangles.size();
+  if (nodes.empty()) return result;
+  vector<pair<uint32_t, size_t>> stack{{0, 1}};
+  while (!stack.empty()) {
+    const auto [i, depth] = stack.back();
+    stack.pop_back();
+    result.depth = max(result.depth, depth);
+    if (nodes[i].count) {
+      ++result.leaves;
+      continue;
+    }
+    stack.push_back({nodes[i].index, depth + 1});
+    stack.push_back({nodes[i].index + 1, depth + 1});
+  }
+  return result;
+}
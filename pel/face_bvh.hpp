@@ -0,0 +1,52 @@
+#pragma once
+#include "model.hpp"
+#include "utility.hpp"
+
+// Bounding volume hierarchy over the faces of a mesh for occlusion queries.
+// Nodes are split where the surface area heuristic, evaluated on bins of
+// the face centroids along all three axes, is minimal. Large ranges are
+// binned in parallel and the children of large nodes are built as tasks.
+// Faces are copied in the order of the leaves such that every leaf
+// references a contiguous range of precomputed triangles.
+class face_bvh {
+ public:
+  struct statistics {
+    size_t nodes{};
+    size_t leaves{};
+    size_t depth{};
+    size_t faces{};
+  };
+
+  face_bvh() = default;
+  explicit face_bvh(const mesh_geometry& mesh, size_t max_leaf_size = 8);
+
+  // Returns true if a face intersects the ray from the origin in the
+  // normalized direction at a distance in the open interval (0, max).
+  bool occluded(vec3 origin, vec3 dir, float max_distance) const noexcept;
+
+  auto stats() const -> statistics;
+
+ private:
+  struct builder;
+
+  // Inner nodes store the index of their first child and a count of zero.
+  // The second child directly follows the first one.
+  // Leaves store the range of their triangles.
+  struct node {
+    vec3 aabb_min;
+    uint32_t index;
+    vec3 aabb_max;
+    uint32_t count;
+  };
+  static_assert(sizeof(node) == 32);
+
+  // First vertex and edges as needed by the intersection test
+  struct triangle {
+    vec3 a;
+    vec3 ab;
+    vec3 ac;
+  };
+
+  vector<node> nodes{};
+  vector<triangle> triangles{};
+};
@@ -0,0 +1,153 @@
+#include "frame_capture.hpp"
+//
+#include <sstream>
+//
+#include "png_image.hpp"
+
+using namespace std;
+
+namespace {
+
+// Raw frames store 8-bit RGBA pixels with the top row first.
+void write_raw(czstring file_path,
+               int width,
+               int height,
+               std::span<const uint8_t> pixels) {
+  ofstream file{file_path, ios::binary};
+  if (!file)
+    throw runtime_error("Failed to open file '"s + file_path +
+                        "' for writing.");
+  const auto row_size = size_t(width) * 4;
+  for (int i = height - 1; i >= 0; --i)
+    file.write(reinterpret_cast<const char*>(pixels.data() + i * row_size),
+               row_size);
+  if (!file)
+    throw runtime_error("Failed to write file '"s + file_path + "'.");
+}
+
+}  // namespace
+
+frame_capture::frame_capture(int width, int height, const options& opts)
+    : w{width},
+      h{height},
+      opts{opts},
+      ring(std::max<size_t>(1, opts.ring_size)) {
+  const auto size = size_t(w) * h * 4;
+  memory_stage stage{"capture buffers"};
+  for (auto& s : ring) s.buffer.allocate(size, nullptr, GL_STREAM_READ);
+}
+
+frame_capture::~frame_capture() {
+  // Frames still on the GPU are lost if the context is already gone.
+  // Only wait for the encoders in this case.
+  unique_lock lock{mutex};
+  encoded.wait(lock, [this] { return queued_frames == 0; });
+  for (auto& s : ring)
+    if (s.fence) glDeleteSync(s.fence);
+}
+
+void frame_capture::capture() {
+  // Retrieve finished frames as early as possible to free their slots.
+  for (size_t i = 0; i < ring.size(); ++i) {
+    auto& s = ring[(next_frame + i) % ring.size()];
+    if (!s.fence) continue;
+    if (glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0) ==
+        GL_TIMEOUT_EXPIRED)
+      break;
+    retrieve(s);
+  }
+
+  auto& s = ring[next_frame % ring.size()];
+  if (s.fence) retrieve(s);
+  s.frame = next_frame++;
+  s.buffer.bind();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  s.fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, {});
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+}
+
+void frame_capture::finish() {
+  for (size_t i = 0; i < ring.size(); ++i) {
+    auto& s = ring[(next_frame + i) % ring.size()];
+    if (s.fence) retrieve(s);
+  }
+  unique_lock lock{mutex};
+  encoded.wait(lock, [this] { return queued_frames == 0; });
+  if (error) rethrow_exception(std::exchange(error, nullptr));
+}
+
+auto frame_capture::stats() -> statistics {
+  scoped_lock lock{mutex};
+  return counters;
+}
+
+void frame_capture::retrieve(slot& s) {
+  const auto size = size_t(w) * h * 4;
+  {
+    // Back-pressure: wait for encoders before mapping another frame.
+    // The render thread does not encode frames itself because that
+    // would stall rendering for much longer than the wait.
+    const auto start = system_clock::now();
+    unique_lock lock{mutex};
+    encoded.wait(lock,
+                 [this] { return queued_frames < opts.max_queued_frames; });
+    ++queued_frames;
+    ++counters.captured;
+    counters.blocked_time +=
+        duration<float>(system_clock::now() - start).count();
+    if (error) {
+      --queued_frames;
+      rethrow_exception(std::exchange(error, nullptr));
+    }
+  }
+
+  while (glClientWaitSync(s.fence, GL_SYNC_FLUSH_COMMANDS_BIT,
+                          1'000'000'000) == GL_TIMEOUT_EXPIRED)
+    ;
+  glDeleteSync(s.fence);
+  s.fence = {};
+
+  vector<uint8_t> pixels(size);
+  s.buffer.bind();
+  const auto data =
+      glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, size, GL_MAP_READ_BIT);
+  if (data) {
+    memcpy(pixels.data(), data, size);
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+  }
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  if (!data) {
+    {
+      scoped_lock lock{mutex};
+      --queued_frames;
+    }
+    throw runtime_error("Failed to map pixel buffer of captured frame.");
+  }
+
+  scheduler().submit([this, frame = s.frame, pixels = std::move(pixels)] {
+    encode(frame, std::move(pixels));
+  });
+}
+
+void frame_capture::encode(size_t frame, vector<uint8_t> pixels) {
+  ostringstream path{};
+  path << opts.output_prefix << '-' << setw(4) << setfill('0') << frame
+       << ((opts.format == image_format::png) ? ".png" : ".rgba");
+  exception_ptr failure{};
+  try {
+    if (opts.format == image_format::png)
+      write_png(path.str().c_str(), w, h, pixels);
+    else
+      write_raw(path.str().c_str(), w, h, pixels);
+  } catch (...) {
+    failure = current_exception();
+  }
+  // The capture may be destroyed as soon as the last frame is written.
+  // So it must not be accessed after the mutex is released.
+  scoped_lock lock{mutex};
+  --queued_frames;
+  ++counters.encoded;
+  if (failure && !error) error = failure;
+  encoded.notify_all();
+}
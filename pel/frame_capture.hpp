@@ -0,0 +1,83 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+//
+#include "buffer.hpp"
+#include "task_scheduler.hpp"
+#include "utility.hpp"
+
+// Writes rendered frames to numbered image files without stalling rendering.
+// Every frame is read back asynchronously into a ring of pixel buffer objects.
+// A fence tells when its transfer has finished such that mapping the buffer,
+// typically some frames later, does not wait for the GPU.
+// Encoding tasks of the process-wide scheduler then write them to disk.
+// If they fall behind by too many frames, capturing blocks
+// to keep the memory usage of queued frames bounded.
+class frame_capture {
+ public:
+  enum class image_format { png, raw };
+
+  struct options {
+    string output_prefix = "frame";
+    image_format format = image_format::png;
+    // Number of frames in flight on the GPU
+    size_t ring_size = 3;
+    // Number of frames that may wait for encoding
+    size_t max_queued_frames = 8;
+  };
+
+  struct statistics {
+    size_t captured{};
+    size_t encoded{};
+    // Seconds that the render thread was blocked by encoders
+    float blocked_time{};
+  };
+
+  frame_capture(int width, int height, const options& opts);
+  ~frame_capture();
+
+  // Copying is not allowed.
+  frame_capture(const frame_capture&) = delete;
+  frame_capture& operator=(const frame_capture&) = delete;
+
+  // For now, moving is not allowed.
+  frame_capture(frame_capture&&) = delete;
+  frame_capture& operator=(frame_capture&&) = delete;
+
+  auto width() const noexcept { return w; }
+  auto height() const noexcept { return h; }
+
+  // Starts the readback of the framebuffer bound for reading.
+  // Requires the OpenGL context that created the capture to be current.
+  void capture();
+
+  // Reads back all remaining frames and waits until they are written.
+  // Also requires the OpenGL context to be current.
+  void finish();
+
+  auto stats() -> statistics;
+
+ private:
+  struct slot {
+    pixel_pack_buffer buffer{};
+    GLsync fence{};
+    size_t frame{};
+  };
+
+  // Maps the buffer of the slot and hands its frame to the encoders.
+  void retrieve(slot& s);
+  void encode(size_t frame, vector<uint8_t> pixels);
+
+  int w;
+  int h;
+  options opts;
+  vector<slot> ring;
+  size_t next_frame{};
+
+  std::mutex mutex{};
+  std::condition_variable encoded{};
+  size_t queued_frames{};
+  statistics counters{};
+  // Failures of encoders are rethrown on the render thread.
+  std::exception_ptr error{};
+};
@@ -0,0 +1,57 @@
+#pragma once
+#include "utility.hpp"
+
+class framebuffer {
+ public:
+  framebuffer() { glGenFramebuffers(1, &handle); }
+  ~framebuffer() { glDeleteFramebuffers(1, &handle); }
+
+  // Copying is not allowed.
+  framebuffer(const framebuffer&) = delete;
+  framebuffer& operator=(const framebuffer&) = delete;
+
+  // Moving
+  framebuffer(framebuffer&& x) : handle{x.handle} { x.handle = 0; }
+  framebuffer& operator=(framebuffer&& x) {
+    swap(handle, x.handle);
+    return *this;
+  }
+
+  operator GLuint() const { return handle; }
+
+  void bind(GLenum target = GL_FRAMEBUFFER) const {
+    glBindFramebuffer(target, handle);
+  }
+
+  bool complete() const {
+    return glCheckFramebufferStatus(GL_FRAMEBUFFER) ==
+           GL_FRAMEBUFFER_COMPLETE;
+  }
+
+  // private:
+  GLuint handle{};  // value zero is ignored
+};
+
+class renderbuffer {
+ public:
+  renderbuffer() { glGenRenderbuffers(1, &handle); }
+  ~renderbuffer() { glDeleteRenderbuffers(1, &handle); }
+
+  // Copying is not allowed.
+  renderbuffer(const renderbuffer&) = delete;
+  renderbuffer& operator=(const renderbuffer&) = delete;
+
+  // Moving
+  renderbuffer(renderbuffer&& x) : handle{x.handle} { x.handle = 0; }
+  renderbuffer& operator=(renderbuffer&& x) {
+    swap(handle, x.handle);
+    return *this;
+  }
+
+  operator GLuint() const { return handle; }
+
+  void bind() const { glBindRenderbuffer(GL_RENDERBUFFER, handle); }
+
+  // private:
+  GLuint handle{};  // value zero is ignored
+};
@@ -0,0 +1,133 @@
+#include "geodesic_grid.hpp"
+//
+#include <queue>
+
+using namespace std;
+
+geodesic_grid::geodesic_grid(size_t subdivisions) {
+  // Icosahedron
+  const auto t = (1 + std::sqrt(5.0f)) / 2;
+  directions = {{-1, t, 0}, {1, t, 0},  {-1, -t, 0}, {1, -t, 0},
+                {0, -1, t}, {0, 1, t},  {0, -1, -t}, {0, 1, -t},
+                {t, 0, -1}, {t, 0, 1},  {-t, 0, -1}, {-t, 0, 1}};
+  for (auto& d : directions) d = normalize(d);
+  antipodes.resize(directions.size());
+  for (size_t i = 0; i < directions.size(); ++i)
+    for (size_t j = 0; j < directions.size(); ++j)
+      if (dot(directions[i], directions[j]) < -0.99f) antipodes[i] = j;
+  vector<array<uint32_t, 3>> faces{
+      {0, 11, 5}, {0, 5, 1},  {0, 1, 7},   {0, 7, 10}, {0, 10, 11},
+      {1, 5, 9},  {5, 11, 4}, {11, 10, 2}, {10, 7, 6}, {7, 1, 8},
+      {3, 9, 4},  {3, 4, 2},  {3, 2, 6},   {3, 6, 8},  {3, 8, 9},
+      {4, 9, 5},  {2, 4, 11}, {6, 2, 10},  {8, 6, 7},  {9, 8, 1}};
+
+  // Every subdivision splits all triangles into four
+  // by inserting the projected midpoints of their edges.
+  const auto edge = [](uint32_t i, uint32_t j) {
+    return (uint64_t(std::min(i, j)) << 32) | std::max(i, j);
+  };
+  for (size_t s = 0; s < subdivisions; ++s) {
+    std::unordered_map<uint64_t, uint32_t> midpoints{};
+    const auto midpoint = [&](uint32_t i, uint32_t j) {
+      const auto [it, inserted] = midpoints.try_emplace(edge(i, j), 0);
+      if (inserted) {
+        it->second = directions.size();
+        directions.push_back(normalize(directions[i] + directions[j]));
+      }
+      return it->second;
+    };
+    vector<array<uint32_t, 3>> subdivided{};
+    subdivided.reserve(4 * faces.size());
+    for (const auto& [a, b, c] : faces) {
+      const auto ab = midpoint(a, b);
+      const auto bc = midpoint(b, c);
+      const auto ca = midpoint(c, a);
+      subdivided.push_back({a, ab, ca});
+      subdivided.push_back({b, bc, ab});
+      subdivided.push_back({c, ca, bc});
+      subdivided.push_back({ab, bc, ca});
+    }
+    faces = std::move(subdivided);
+
+    // The antipode of a midpoint is the midpoint of the antipodal edge.
+    antipodes.resize(directions.size());
+    for (const auto& [key, m] : midpoints) {
+      const auto i = antipodes[key >> 32];
+      const auto j = antipodes[key & 0xffffffff];
+      antipodes[m] = midpoints.at(edge(i, j));
+    }
+  }
+
+  // Every edge is shared by two faces and is added in both directions.
+  neighbor_offsets.assign(directions.size() + 1, 0);
+  for (const auto& f : faces)
+    for (auto i : f) neighbor_offsets[i + 1] += 2;
+  for (size_t i = 0; i < directions.size(); ++i)
+    neighbor_offsets[i + 1] += neighbor_offsets[i];
+  neighbor_indices.resize(neighbor_offsets.back());
+  auto fill = neighbor_offsets;
+  for (const auto& f : faces)
+    for (size_t k = 0; k < 3; ++k) {
+      neighbor_indices[fill[f[k]]++] = f[(k + 1) % 3];
+      neighbor_indices[fill[f[k]]++] = f[(k + 2) % 3];
+    }
+  uint32_t size = 0;
+  for (size_t i = 0; i < directions.size(); ++i) {
+    const auto first = begin(neighbor_indices) + neighbor_offsets[i];
+    const auto last = begin(neighbor_indices) + neighbor_offsets[i + 1];
+    sort(first, last);
+    const auto unique_last = unique(first, last);
+    neighbor_offsets[i] = size;
+    for (auto it = first; it != unique_last; ++it)
+      neighbor_indices[size++] = *it;
+  }
+  neighbor_offsets.back() = size;
+  neighbor_indices.resize(size);
+
+  const auto& [a, b, c] = faces[0];
+  angle = acos(std::clamp(dot(directions[a], directions[b]), -1.0f, 1.0f));
+}
+
+auto geodesic_grid::nearest(vec3 dir) const noexcept -> size_t {
+  // In a Delaunay triangulation, every direction that is not the nearest
+  // one has a neighbor that is closer. The walk starts at the nearest
+  // vertex of the icosahedron and takes O(2^subdivisions) steps.
+  size_t result = 0;
+  for (size_t i = 1; i < 12; ++i)
+    if (dot(directions[i], dir) > dot(directions[result], dir)) result = i;
+  for (auto improved = true; improved;) {
+    improved = false;
+    for (auto j : neighbors(result)) {
+      if (dot(directions[j], dir) <= dot(directions[result], dir)) continue;
+      result = j;
+      improved = true;
+    }
+  }
+  return result;
+}
+
+auto geodesic_grid::nearest(vec3 dir, size_t count) const -> vector<size_t> {
+  // The closest directions form a connected subgraph that contains
+  // the nearest one. So they are visited in order of their distance
+  // by a best-first search starting from it.
+  count = std::min(count, directions.size());
+  vector<size_t> result{};
+  result.reserve(count);
+  vector<size_t> visited{nearest(dir)};
+  const auto closer = [&](size_t i, size_t j) {
+    return dot(directions[i], dir) < dot(directions[j], dir);
+  };
+  priority_queue<size_t, vector<size_t>, decltype(closer)> queue{closer};
+  queue.push(visited[0]);
+  while (result.size() < count) {
+    const auto i = queue.top();
+    queue.pop();
+    result.push_back(i);
+    for (auto j : neighbors(i)) {
+      if (find(begin(visited), end(visited), j) != end(visited)) continue;
+      visited.push_back(j);
+      queue.push(j);
+    }
+  }
+  return result;
+}
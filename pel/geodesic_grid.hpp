@@ -0,0 +1,37 @@
+#pragma once
+#include "utility.hpp"
+
+// Vertices of a subdivided icosahedron projected onto the unit sphere.
+// They are nearly uniformly distributed over the sphere and,
+// like the icosahedron, symmetric with respect to the origin.
+// Their triangulation is a spherical Delaunay triangulation.
+// So nearest directions are found by walking along its edges.
+class geodesic_grid {
+ public:
+  explicit geodesic_grid(size_t subdivisions);
+
+  auto size() const noexcept -> size_t { return directions.size(); }
+  auto direction(size_t i) const noexcept -> vec3 { return directions[i]; }
+  // Index of the direction pointing to the opposite side
+  auto antipode(size_t i) const noexcept -> size_t { return antipodes[i]; }
+  // Angle between neighboring directions in radians
+  auto spacing() const noexcept -> float { return angle; }
+
+  // Index of the direction that is closest to the given unit vector
+  auto nearest(vec3 dir) const noexcept -> size_t;
+  // Indices of the 'count' closest directions sorted by their distance
+  auto nearest(vec3 dir, size_t count) const -> vector<size_t>;
+
+  // Indices of the directions that share an edge with the given one
+  auto neighbors(size_t i) const noexcept -> std::span<const uint32_t> {
+    return {neighbor_indices.data() + neighbor_offsets[i],
+            neighbor_indices.data() + neighbor_offsets[i + 1]};
+  }
+
+ private:
+  vector<vec3> directions{};
+  vector<uint32_t> antipodes{};
+  vector<uint32_t> neighbor_offsets{};
+  vector<uint32_t> neighbor_indices{};
+  float angle{};
+};
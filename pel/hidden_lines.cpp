@@ -0,0 +1,69 @@
+#include "hidden_lines.hpp"
+//
+#include "parallel.hpp"
+
+using namespace std;
+
+void remove_hidden_lines(const face_bvh& bvh,
+                         vec3 eye,
+                         const vector<line_segment>& segments,
+                         vector<line_segment>& visible,
+                         const hidden_line_options& options) {
+  const auto samples = max<size_t>(options.samples, 1);
+
+  // Every block appends to its own list. So they only have to be
+  // concatenated in order afterwards.
+  vector<vector<line_segment>> parts(8 * thread_count());
+  parallel_for_blocks(
+      size_t{0}, segments.size(), parts.size(),
+      [&](size_t first, size_t last, size_t block) {
+        auto& result = parts[block];
+        for (auto i = first; i < last; ++i) {
+          const auto& s = segments[i];
+          const auto point = [&](float t) { return mix(s.start, s.end, t); };
+          const auto is_visible = [&](float t) {
+            const auto p = point(t);
+            const auto d = eye - p;
+            const auto distance = length(d);
+            if (!(distance > options.offset)) return true;
+            const auto dir = d / distance;
+            return !bvh.occluded(p + options.offset * dir, dir,
+                                 distance - options.offset);
+          };
+          const auto add_part = [&](float t0, float t1) {
+            if (!(t1 > t0)) return;
+            result.push_back({point(t0), point(t1),
+                              lerp(s.start_strength, s.end_strength, t0),
+                              lerp(s.start_strength, s.end_strength, t1)});
+          };
+
+          auto visible_before = is_visible(0);
+          float part_start = 0;
+          for (size_t k = 1; k <= samples; ++k) {
+            const auto t0 = float(k - 1) / samples;
+            const auto t1 = float(k) / samples;
+            const auto visible_now = is_visible(t1);
+            if (visible_now == visible_before) continue;
+            // The visibility of 'a' equals the one at the start
+            // of the interval and the visibility of 'b' the one at its end.
+            auto a = t0;
+            auto b = t1;
+            for (size_t j = 0; j < options.refinement_steps; ++j) {
+              const auto m = (a + b) / 2;
+              if (is_visible(m) == visible_before)
+                a = m;
+              else
+                b = m;
+            }
+            if (visible_before)
+              add_part(part_start, a);
+            else
+              part_start = b;
+            visible_before = visible_now;
+          }
+          if (visible_before) add_part(part_start, 1);
+        }
+      });
+
+  for (const auto& x : parts) visible.insert(end(visible), begin(x), end(x));
+}
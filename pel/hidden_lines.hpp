@@ -0,0 +1,25 @@
+#pragma once
+#include "face_bvh.hpp"
+#include "photic_extremum_lines.hpp"
+#include "utility.hpp"
+
+struct hidden_line_options {
+  // Rays start this distance in front of the lines towards the eye
+  // such that they do not hit the faces the lines lie on.
+  float offset = 1e-4f;
+  // Number of intervals into which every segment is split for sampling
+  size_t samples = 4;
+  // Bisection steps that locate a change of visibility in an interval
+  size_t refinement_steps = 8;
+};
+
+// Appends the visible parts of the segments as seen from the eye.
+// A point is visible if the ray towards the eye does not hit any face.
+// Every segment is sampled and split at the changes of visibility between
+// its samples. Strengths are interpolated linearly. The segments are
+// processed in parallel and their visible parts keep their order.
+void remove_hidden_lines(const face_bvh& bvh,
+                         vec3 eye,
+                         const vector<line_segment>& segments,
+                         vector<line_segment>& visible,
+                         const hidden_line_options& options = {});
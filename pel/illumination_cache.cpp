@@ -0,0 +1,126 @@
+#include "illumination_cache.hpp"
+
+using namespace std;
+
+void illumination_cache::clear() {
+  entries.clear();
+  index.clear();
+  scales.clear();
+  memory = 0;
+}
+
+auto illumination_cache::key(size_t level, size_t direction) const noexcept
+    -> uint64_t {
+  const auto canonical = std::min(direction, grid.antipode(direction));
+  return (uint64_t(level) << 32) | canonical;
+}
+
+auto illumination_cache::lookup(uint64_t key) -> const entry* {
+  const auto it = index.find(key);
+  if (it == end(index)) return nullptr;
+  entries.splice(begin(entries), entries, it->second);
+  return &*it->second;
+}
+
+bool illumination_cache::find(size_t level,
+                              vec3 light_dir,
+                              vector<illumination_info>& data) {
+  const auto cached = lookup(key(level, grid.nearest(light_dir)));
+  if (!cached || (cached->values.size() != data.size())) {
+    ++misses;
+    return false;
+  }
+  for (size_t i = 0; i < data.size(); ++i) {
+    data[i].light = cached->values[i].light;
+    data[i].light_variation = cached->values[i].light_variation;
+    data[i].light_variation_slope = cached->values[i].light_variation_slope;
+    data[i].light_variation_curve = cached->values[i].light_variation_curve;
+  }
+  ++hits;
+  return true;
+}
+
+void illumination_cache::insert(size_t level,
+                                vec3 light_dir,
+                                const vector<illumination_info>& data,
+                                illumination_scale scale) {
+  const auto k = key(level, grid.nearest(light_dir));
+  scales[k] = scale;
+  const auto size = data.size() * sizeof(fields);
+  if (size > budget) return;
+  if (const auto it = index.find(k); it != end(index)) {
+    memory -= it->second->values.size() * sizeof(fields);
+    entries.erase(it->second);
+    index.erase(it);
+  }
+  while (memory + size > budget) {
+    memory -= entries.back().values.size() * sizeof(fields);
+    index.erase(entries.back().key);
+    entries.pop_back();
+  }
+
+  vector<fields> values(data.size());
+  for (size_t i = 0; i < data.size(); ++i)
+    values[i] = {data[i].light, data[i].light_variation,
+                 data[i].light_variation_slope, data[i].light_variation_curve};
+  entries.push_front({k, std::move(values)});
+  index.emplace(k, begin(entries));
+  memory += size;
+}
+
+auto illumination_cache::scale(size_t level, vec3 light_dir) const
+    -> illumination_scale {
+  const auto it = scales.find(key(level, grid.nearest(light_dir)));
+  return (it == std::end(scales)) ? illumination_scale{} : it->second;
+}
+
+bool illumination_cache::blend(size_t level,
+                               vec3 light_dir,
+                               vector<illumination_info>& data) {
+  // Only entries of the ring of grid directions around the light direction
+  // are considered. Their weights are given by the inverse angle.
+  constexpr size_t max_sources = 3;
+  const auto radius = 2 * grid.spacing();
+  const entry* sources[max_sources]{};
+  float weights[max_sources]{};
+  size_t count = 0;
+  float sum = 0;
+  for (auto i : grid.nearest(light_dir, 7)) {
+    // Antipodal entries are valid for the reversed direction.
+    const auto d = grid.direction(i);
+    const auto angle = acos(std::clamp(abs(dot(d, light_dir)), 0.0f, 1.0f));
+    if (angle > radius) break;
+    const auto cached = lookup(key(level, i));
+    if (!cached || (cached->values.size() != data.size())) continue;
+    if (find_if(sources, sources + count,
+                [&](auto s) { return s == cached; }) != sources + count)
+      continue;
+    sources[count] = cached;
+    weights[count] = 1 / (angle + 1e-3f);
+    sum += weights[count];
+    if (++count == max_sources) break;
+  }
+  if (!count) return false;
+
+  for (size_t k = 0; k < count; ++k) weights[k] /= sum;
+  for (size_t i = 0; i < data.size(); ++i) {
+    fields f{};
+    for (size_t k = 0; k < count; ++k) {
+      const auto& s = sources[k]->values[i];
+      f.light += weights[k] * s.light;
+      f.light_variation += weights[k] * s.light_variation;
+      f.light_variation_slope += weights[k] * s.light_variation_slope;
+      f.light_variation_curve += weights[k] * s.light_variation_curve;
+    }
+    data[i].light = f.light;
+    data[i].light_variation = f.light_variation;
+    data[i].light_variation_slope = f.light_variation_slope;
+    data[i].light_variation_curve = f.light_variation_curve;
+  }
+  ++blends;
+  return true;
+}
+
+auto illumination_cache::stats() const noexcept -> statistics {
+  return {entries.size(), memory, hits, blends, misses};
+}
@@ -0,0 +1,82 @@
+#pragma once
+#include <list>
+//
+#include "geodesic_grid.hpp"
+#include "photic_extremum_lines.hpp"
+#include "utility.hpp"
+
+// Keeps the light dependent fields of previously computed illumination data.
+// Light directions are quantized to the nearest direction of a geodesic grid.
+// Because lighting only depends on the absolute cosine between normal
+// and light direction, a direction and its antipode share their entry.
+// The least recently used entries are evicted as soon as the sum of
+// their sizes exceeds the memory budget. The maxima used for normalization
+// are tiny and kept for every direction until the cache is cleared.
+// The cache is not synchronized and meant to be used by one thread.
+class illumination_cache {
+ public:
+  struct fields {
+    float light{};
+    float light_variation{};
+    float light_variation_slope{};
+    float light_variation_curve{};
+  };
+
+  struct statistics {
+    size_t entries{};
+    size_t memory{};
+    size_t hits{};
+    size_t blends{};
+    size_t misses{};
+  };
+
+  explicit illumination_cache(size_t memory_budget, size_t subdivisions = 5)
+      : grid{subdivisions}, budget{memory_budget} {}
+
+  void clear();
+
+  // Overwrites the light dependent fields with the cached ones of
+  // the grid direction that is nearest to the given light direction.
+  // The cached light may have been smoothed. Unsmoothed light can be
+  // recomputed afterwards for the exact light direction.
+  // Returns false if no such entry exists.
+  bool find(size_t level, vec3 light_dir, vector<illumination_info>& data);
+
+  // Stores the fields for the grid direction nearest to the light direction
+  // together with the maxima of the full mesh they were normalized by.
+  void insert(size_t level,
+              vec3 light_dir,
+              const vector<illumination_info>& data,
+              illumination_scale scale);
+
+  // Returns the maxima of the full mesh for the grid direction nearest to
+  // the light direction. They are zero if no data has been stored for it.
+  auto scale(size_t level, vec3 light_dir) const -> illumination_scale;
+
+  // Approximates the light dependent fields by interpolating up to three
+  // cached entries of grid directions in the vicinity of the light direction.
+  // Returns false if there is no cached entry nearby.
+  bool blend(size_t level, vec3 light_dir, vector<illumination_info>& data);
+
+  auto stats() const noexcept -> statistics;
+
+ private:
+  struct entry {
+    uint64_t key{};
+    vector<fields> values{};
+  };
+
+  auto key(size_t level, size_t direction) const noexcept -> uint64_t;
+  auto lookup(uint64_t key) -> const entry*;
+
+  geodesic_grid grid;
+  // Recently used entries are at the front.
+  std::list<entry> entries{};
+  std::unordered_map<uint64_t, std::list<entry>::iterator> index{};
+  std::unordered_map<uint64_t, illumination_scale> scales{};
+  size_t budget{};
+  size_t memory{};
+  size_t hits{};
+  size_t blends{};
+  size_t misses{};
+};
@@ -0,0 +1,154 @@
+#include "illumination_worker.hpp"
+
+void illumination_worker::start(vector<input> levels) {
+  stop();
+  this->levels = std::move(levels);
+  cache.clear();
+  results.reset({0, geometry_version, *this->levels[0].illumination_data});
+  thread = std::jthread{[this](std::stop_token stop) { run(stop); }};
+}
+
+void illumination_worker::stop() {
+  if (!thread.joinable()) return;
+  thread.request_stop();
+  thread.join();
+}
+
+void illumination_worker::resume() {
+  stop();
+  cache.clear();
+  ++geometry_version;
+  thread = std::jthread{[this](std::stop_token stop) { run(stop); }};
+}
+
+void illumination_worker::request(vec3 light_dir,
+                                  size_t level,
+                                  vector<uint32_t> clusters,
+                                  bool blend) {
+  {
+    std::scoped_lock lock{mutex};
+    this->light_dir = light_dir;
+    requested_level = level;
+    requested_clusters = std::move(clusters);
+    blending_allowed = blend;
+    ++generation;
+  }
+  new_request.notify_one();
+}
+
+void illumination_worker::set_light_smoothing(size_t iterations) {
+  std::scoped_lock lock{mutex};
+  light_smoothing = iterations;
+}
+
+void illumination_worker::run(std::stop_token stop) {
+  uint64_t done = 0;
+  size_t cached_smoothing = 0;
+  scales.assign(levels.size(), {});
+  while (true) {
+    vec3 dir;
+    size_t level_index;
+    uint64_t current;
+    vector<uint32_t> clusters;
+    bool blend;
+    size_t smoothing;
+    {
+      std::unique_lock lock{mutex};
+      if (!new_request.wait(lock, stop, [&] { return generation != done; }))
+        return;
+      dir = light_dir;
+      level_index = std::min(requested_level, levels.size() - 1);
+      current = generation;
+      clusters = std::move(requested_clusters);
+      blend = blending_allowed;
+      smoothing = light_smoothing;
+    }
+    done = current;
+
+    // Cached data depends on the smoothing.
+    if (smoothing != cached_smoothing) {
+      cache.clear();
+      scales.assign(levels.size(), {});
+      cached_smoothing = smoothing;
+    }
+
+    // Results of stale requests would be thrown away anyway.
+    // So stop the computation as soon as possible.
+    const auto stale = [&] {
+      return stop.stop_requested() ||
+             (generation.load(std::memory_order_relaxed) != current);
+    };
+
+    const auto start = system_clock::now();
+    const auto& level = levels[level_index];
+    auto& result = results.back();
+    // Slots keep the prepared data of the geometry they were last used for.
+    if (result.geometry != geometry_version) {
+      result.geometry = geometry_version;
+      result.data = *levels[0].illumination_data;
+    }
+    result.level = level_index;
+    // Coarser levels are computed on their own vertices
+    // and prolonged to the first level afterwards.
+    if (level_index && ((coarse_level != level_index) ||
+                        (coarse_geometry != geometry_version))) {
+      coarse_level = level_index;
+      coarse_geometry = geometry_version;
+      coarse_data = *level.illumination_data;
+    }
+    auto& data = level_index ? coarse_data : result.data;
+    const auto publish = [&] {
+      if (level_index)
+        prolong_illumination(*level.vertex_map, data, result.data);
+      results.publish();
+    };
+
+    // Unsmoothed light is cheap to compute for the exact light direction.
+    // Smoothed light has to be taken from the cache as well.
+    if (cache.find(level_index, dir, data) ||
+        (blend && cache.blend(level_index, dir, data))) {
+      if (!smoothing) compute_vertex_light(dir, *level.mesh, data);
+      if (stale()) continue;
+      publish();
+      continue;
+    }
+
+    // Culled data is normalized by the maxima of the full mesh.
+    // These are taken from a previous full computation for the same
+    // grid direction or the last one of the level. Without any of them,
+    // the full mesh is computed once.
+    auto scale = cache.scale(level_index, dir);
+    if (!scale.light_variation) scale = scales[level_index];
+    const auto culled = level.clusters && !clusters.empty() &&
+                        (clusters.size() < level.clusters->size()) &&
+                        scale.light_variation;
+    size_t faces = level.mesh->faces.size();
+    if (culled) {
+      // Three rings for light variation, slope and curve
+      // and one for every smoothing iteration
+      selection.assign(*level.mesh, *level.clusters, clusters,
+                       *level.adjacency, 3 + smoothing);
+      faces = selection.faces.size();
+      compute_illumination(dir, *level.mesh, *level.gradient_data,
+                           *level.adjacency, selection, data, scale,
+                           smoothing, stale);
+    } else {
+      scale = compute_illumination(dir, *level.mesh, *level.gradient_data,
+                                   *level.adjacency, data, smoothing, stale);
+    }
+    if (stale()) continue;
+    if (!culled) {
+      scales[level_index] = scale;
+      cache.insert(level_index, dir, data, scale);
+    }
+    // The prolongation does not depend on the face count of the level.
+    const auto time = duration<float>(system_clock::now() - start).count();
+    publish();
+
+    // Smooth the throughput estimate over several computations.
+    const auto sample = time / std::max<size_t>(1, faces);
+    const auto old = seconds_per_face.load(std::memory_order_relaxed);
+    seconds_per_face.store((old > 0) ? (0.8f * old + 0.2f * sample) : sample,
+                           std::memory_order_relaxed);
+  }
+}
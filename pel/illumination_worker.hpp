@@ -0,0 +1,129 @@
+#pragma once
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+//
+#include "illumination_cache.hpp"
+#include "mesh_hierarchy.hpp"
+#include "model.hpp"
+#include "photic_extremum_lines.hpp"
+#include "triple_buffer.hpp"
+#include "utility.hpp"
+
+// Computes the illumination data of a prepared mesh on its own thread.
+// Requests only consist of a light direction, the level of detail and
+// optionally the visible clusters. Newer requests supersede older ones.
+// A running computation is cancelled between its passes
+// as soon as a newer request arrives.
+// Results of coarser levels are prolonged to the first level.
+// So published data always belongs to the vertices of the first level.
+// Complete results are cached by their quantized light direction
+// and reused when the light returns to a previously visited direction.
+// Completed results are published through a triple buffer
+// such that the render thread never has to wait.
+class illumination_worker {
+ public:
+  // References to the prepared data of one level of detail.
+  // The illumination data provides the Voronoi areas and
+  // tangent systems for every vertex.
+  struct input {
+    const mesh_geometry* mesh{};
+    const vector<gradient_info>* gradient_data{};
+    const vector<illumination_info>* illumination_data{};
+    const vertex_face_adjacency* adjacency{};
+    // Optional clusters to restrict the computation to visible parts
+    const vector<mesh_cluster>* clusters{};
+    // Maps every vertex of the first level to one of this level.
+    // It is required for all levels but the first one.
+    const vector<uint32_t>* vertex_map{};
+  };
+
+  struct result {
+    size_t level{};
+    // Version of the geometry the prepared data has been copied from
+    size_t geometry{};
+    vector<illumination_info> data{};
+  };
+
+  illumination_worker() = default;
+  ~illumination_worker() { stop(); }
+
+  // Copying is not allowed.
+  illumination_worker(const illumination_worker&) = delete;
+  illumination_worker& operator=(const illumination_worker&) = delete;
+
+  // For now, moving is not allowed.
+  illumination_worker(illumination_worker&&) = delete;
+  illumination_worker& operator=(illumination_worker&&) = delete;
+
+  // The referenced data of all levels must not change until 'stop()'.
+  // The first level is the finest one.
+  void start(vector<input> levels);
+  void stop();
+  // Restarts the worker with the levels of the last 'start()' after
+  // their geometry has been modified while it was stopped.
+  // Cached results are dropped and result slots copy the prepared data again.
+  void resume();
+
+  // If clusters are given and the level provides them, only the vertices
+  // of these clusters receive valid illumination data.
+  // If blending is allowed, cached results of nearby light directions
+  // are interpolated instead of computing the data, if possible.
+  void request(vec3 light_dir,
+               size_t level = 0,
+               vector<uint32_t> clusters = {},
+               bool blend = false);
+
+  // Number of Jacobi sweeps that smooth the light field of later requests
+  void set_light_smoothing(size_t iterations);
+
+  // Returns true if newer illumination data is available through 'data()'.
+  bool fetch() noexcept { return results.fetch(); }
+  auto data() const noexcept -> const vector<illumination_info>& {
+    return results.front().data;
+  }
+  // Level of detail the data returned by 'data()' has been computed on
+  auto level() const noexcept -> size_t { return results.front().level; }
+  // Version of the geometry that is increased by every 'resume()'
+  auto geometry() const noexcept -> size_t { return geometry_version; }
+  // Version of the geometry the data returned by 'data()' belongs to
+  auto data_geometry() const noexcept -> size_t {
+    return results.front().geometry;
+  }
+
+  // Estimated computation time in seconds for a level with the given
+  // face count based on the throughput of previous computations.
+  auto estimated_time(size_t face_count) const noexcept -> float {
+    return face_count * seconds_per_face.load(std::memory_order_relaxed);
+  }
+
+ private:
+  void run(std::stop_token stop);
+
+  vector<input> levels{};
+  triple_buffer<result> results{};
+  std::atomic<float> seconds_per_face{0};
+
+  std::mutex mutex{};
+  std::condition_variable_any new_request{};
+  vec3 light_dir{};
+  size_t requested_level{};
+  vector<uint32_t> requested_clusters{};
+  bool blending_allowed{};
+  size_t light_smoothing{};
+  std::atomic<uint64_t> generation{0};
+  // Only changed while the worker thread is stopped
+  size_t geometry_version{};
+
+  // Only accessed by the worker thread
+  mesh_selection selection{};
+  // Data of the last computed coarser level before its prolongation
+  vector<illumination_info> coarse_data{};
+  size_t coarse_level{};
+  size_t coarse_geometry{};
+  // Maxima of the last full computation of every level
+  vector<illumination_scale> scales{};
+  illumination_cache cache{size_t{1} << 29};
+
+  std::jthread thread{};
+};
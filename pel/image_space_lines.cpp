@@ -0,0 +1,285 @@
+#include "image_space_lines.hpp"
+
+using namespace std;
+
+namespace {
+
+constexpr czstring normal_vertex_shader_text =
+    "#version 330 core\n"
+
+    "uniform mat4 projection;"
+    "uniform mat4 view;"
+    "uniform mat4 model = mat4(1.0);"
+
+    "layout (location = 0) in vec3 p;"
+    "layout (location = 1) in vec3 n;"
+    "layout (location = 7) in vec3 offset;"
+
+    "out vec3 normal;"
+
+    "void main(){"
+    "  vec4 x = model * vec4(p, 1.0) + vec4(offset, 0.0);"
+    "  gl_Position = projection * view * x;"
+    "  normal = vec3(view * vec4(normalize(mat3(model) * n), 0.0));"
+    "}";
+
+constexpr czstring normal_fragment_shader_text =
+    "#version 330 core\n"
+
+    "in vec3 normal;"
+
+    "layout (location = 0) out vec4 frag_normal;"
+
+    "void main(){"
+    "  frag_normal = vec4(normalize(normal), 1.0);"
+    "}";
+
+// One triangle covers the whole viewport.
+constexpr czstring screen_vertex_shader_text =
+    "#version 330 core\n"
+
+    "void main(){"
+    "  vec2 p = vec2((gl_VertexID << 1) & 2, gl_VertexID & 2);"
+    "  gl_Position = vec4(2.0 * p - 1.0, 0.0, 1.0);"
+    "}";
+
+// In view space, the light by the camera direction is given by the
+// z-coordinate of the normal. Its sign does not change the lines.
+constexpr czstring gradient_fragment_shader_text =
+    "#version 330 core\n"
+
+    "uniform sampler2D normals;"
+
+    "layout (location = 0) out vec2 gradient;"
+
+    "float light(ivec2 p, float fallback){"
+    "  p = clamp(p, ivec2(0), textureSize(normals, 0) - 1);"
+    "  vec4 x = texelFetch(normals, p, 0);"
+    "  return (x.a > 0.0) ? x.z : fallback;"
+    "}"
+
+    "void main(){"
+    "  ivec2 p = ivec2(gl_FragCoord.xy);"
+    "  vec4 x = texelFetch(normals, p, 0);"
+    "  if (x.a == 0.0) {"
+    "    gradient = vec2(0.0);"
+    "    return;"
+    "  }"
+    // Pixels of the background take the light of the center.
+    // Otherwise, the silhouette would appear as jump of the light.
+    "  float l = x.z;"
+    "  float dx = light(p + ivec2(1, 0), l) - light(p - ivec2(1, 0), l);"
+    "  float dy = light(p + ivec2(0, 1), l) - light(p - ivec2(0, 1), l);"
+    "  gradient = 0.5 * vec2(dx, dy);"
+    "}";
+
+// Every pixel takes the maximum of a 2x2 block of the previous level.
+// The first level reduces the length of the gradients.
+constexpr czstring reduction_fragment_shader_text =
+    "#version 330 core\n"
+
+    "uniform sampler2D source;"
+    "uniform bool first;"
+
+    "layout (location = 0) out float maximum;"
+
+    "void main(){"
+    "  ivec2 p = 2 * ivec2(gl_FragCoord.xy);"
+    "  ivec2 last = textureSize(source, 0) - 1;"
+    "  float m = 0.0;"
+    "  for (int i = 0; i < 2; ++i)"
+    "    for (int j = 0; j < 2; ++j) {"
+    "      vec4 x = texelFetch(source, min(p + ivec2(i, j), last), 0);"
+    "      m = max(m, first ? length(x.xy) : x.r);"
+    "    }"
+    "  maximum = m;"
+    "}";
+
+constexpr czstring line_fragment_shader_text =
+    "#version 330 core\n"
+
+    "uniform sampler2D gradients;"
+    "uniform sampler2D maximum;"
+    "uniform float threshold;"
+
+    "layout (location = 0) out vec4 frag_color;"
+
+    "float variation(vec2 x){"
+    "  vec2 size = vec2(textureSize(gradients, 0));"
+    "  return length(texture(gradients, x / size).xy);"
+    "}"
+
+    "void main(){"
+    "  vec2 x = gl_FragCoord.xy;"
+    "  vec2 gradient = texelFetch(gradients, ivec2(x), 0).xy;"
+    "  float scale = texelFetch(maximum, ivec2(0), 0).r;"
+    "  float g = length(gradient);"
+    "  if (!(g > 0.0) || !(scale > 0.0)) discard;"
+    "  vec2 w = gradient / g;"
+    // Slopes of the light variation one pixel before and after the
+    // center along the unit gradient. Their difference is the curve.
+    "  float before = g - variation(x - w);"
+    "  float after = variation(x + w) - g;"
+    "  if (!((before > 0.0) && (after <= 0.0))) discard;"
+
+    "  float strength = g / scale;"
+    "  float s = 0.7;"
+    "  if ((strength < threshold)) discard;"
+    "  float alpha = s * (strength - threshold) / (1.0 - threshold);"
+    "  alpha += 1 - s;"
+    "  frag_color = vec4(vec3(0.0), alpha);"
+    "}";
+
+void setup_texture(const texture& x,
+                   GLenum format,
+                   int width,
+                   int height,
+                   GLenum filter) {
+  x.bind();
+  glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format), width, height, 0,
+               GL_RGBA, GL_FLOAT, nullptr);
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER,
+                  static_cast<GLint>(filter));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER,
+                  static_cast<GLint>(filter));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,
+                  static_cast<GLint>(GL_CLAMP_TO_EDGE));
+  glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,
+                  static_cast<GLint>(GL_CLAMP_TO_EDGE));
+}
+
+void attach(const framebuffer& target, const texture& x) {
+  target.bind();
+  glFramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D,
+                         x, 0);
+  if (!target.complete())
+    throw runtime_error("Failed to create framebuffer for image-space lines.");
+}
+
+}  // namespace
+
+image_space_lines::image_space_lines() {
+  {
+    vertex_shader vs{normal_vertex_shader_text};
+    fragment_shader fs{normal_fragment_shader_text};
+    normal_shader = shader_program{vs, fs};
+  }
+  vertex_shader vs{screen_vertex_shader_text};
+  {
+    fragment_shader fs{gradient_fragment_shader_text};
+    gradient_shader = shader_program{vs, fs};
+  }
+  {
+    fragment_shader fs{reduction_fragment_shader_text};
+    reduction_shader = shader_program{vs, fs};
+  }
+  {
+    fragment_shader fs{line_fragment_shader_text};
+    line_shader = shader_program{vs, fs};
+  }
+}
+
+void image_space_lines::resize(int width, int height) {
+  w = width;
+  h = height;
+
+  setup_texture(normals, GL_RGBA16F, w, h, GL_NEAREST);
+  depth.bind();
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, w, h);
+  attach(geometry, normals);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth);
+  if (!geometry.complete())
+    throw runtime_error("Failed to create G-buffer for image-space lines.");
+
+  // The variation between pixels is interpolated linearly.
+  setup_texture(gradients, GL_RG32F, w, h, GL_LINEAR);
+  attach(gradient_target, gradients);
+
+  reduction.clear();
+  auto level_width = w;
+  auto level_height = h;
+  do {
+    level_width = (level_width + 1) / 2;
+    level_height = (level_height + 1) / 2;
+    auto& level = reduction.emplace_back();
+    level.width = level_width;
+    level.height = level_height;
+    setup_texture(level.maximum, GL_R32F, level_width, level_height,
+                  GL_NEAREST);
+    attach(level.target, level.maximum);
+  } while ((level_width > 1) || (level_height > 1));
+}
+
+void image_space_lines::render(
+    const camera& cam,
+    float threshold,
+    const function<void(shader_program&)>& draw) {
+  // The state of the caller is restored for the final pass.
+  GLint target, viewport[4];
+  glGetIntegerv(GL_DRAW_FRAMEBUFFER_BINDING, &target);
+  glGetIntegerv(GL_VIEWPORT, viewport);
+  if ((cam.screen_width() != w) || (cam.screen_height() != h))
+    resize(cam.screen_width(), cam.screen_height());
+  const auto enabled = [](GLenum capability) {
+    return glIsEnabled(capability) == GL_TRUE;
+  };
+  const bool scissor = enabled(GL_SCISSOR_TEST);
+  const bool blend = enabled(GL_BLEND);
+  const bool depth_test = enabled(GL_DEPTH_TEST);
+  glDisable(GL_SCISSOR_TEST);
+  glDisable(GL_BLEND);
+
+  geometry.bind();
+  glViewport(0, 0, w, h);
+  constexpr float background[4]{};
+  glClearBufferfv(GL_COLOR, 0, background);
+  glEnable(GL_DEPTH_TEST);
+  glClear(GL_DEPTH_BUFFER_BIT);
+  normal_shader.bind();
+  normal_shader  //
+      .set("projection", cam.projection_matrix())
+      .set("view", cam.view_matrix());
+  draw(normal_shader);
+
+  glDisable(GL_DEPTH_TEST);
+  screen.bind();
+  glActiveTexture(GL_TEXTURE0);
+
+  gradient_target.bind();
+  gradient_shader.bind();
+  gradient_shader.set("normals", 0);
+  normals.bind();
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  reduction_shader.bind();
+  reduction_shader.set("source", 0);
+  for (size_t i = 0; i < reduction.size(); ++i) {
+    reduction_shader.set("first", int(i == 0));
+    reduction[i].target.bind();
+    glViewport(0, 0, reduction[i].width, reduction[i].height);
+    if (i == 0)
+      gradients.bind();
+    else
+      reduction[i - 1].maximum.bind();
+    glDrawArrays(GL_TRIANGLES, 0, 3);
+  }
+
+  glBindFramebuffer(GL_FRAMEBUFFER, target);
+  glViewport(viewport[0], viewport[1], viewport[2], viewport[3]);
+  if (scissor) glEnable(GL_SCISSOR_TEST);
+  glEnable(GL_BLEND);
+  line_shader.bind();
+  line_shader  //
+      .set("threshold", threshold)
+      .set("gradients", 0)
+      .set("maximum", 1);
+  gradients.bind();
+  glActiveTexture(GL_TEXTURE1);
+  reduction.back().maximum.bind();
+  glActiveTexture(GL_TEXTURE0);
+  glDrawArrays(GL_TRIANGLES, 0, 3);
+
+  if (!blend) glDisable(GL_BLEND);
+  if (depth_test) glEnable(GL_DEPTH_TEST);
+}
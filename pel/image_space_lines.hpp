@@ -0,0 +1,68 @@
+#pragma once
+#include <functional>
+//
+#include "camera.hpp"
+#include "framebuffer.hpp"
+#include "shader.hpp"
+#include "texture.hpp"
+#include "utility.hpp"
+#include "vertex_array.hpp"
+
+// Photic extremum lines that are extracted per pixel instead of per face.
+// The normals of the visible surface are rendered into a G-buffer.
+// Full-screen passes then take the light by the camera direction,
+// its gradient by finite differences of neighboring pixels and the
+// maximum of the light variation by a reduction. A pixel belongs to a
+// line if the slope of the variation along the gradient changes its sign
+// there with negative curve. Apart from rendering the normals, the cost
+// only depends on the resolution and not on the size of the mesh.
+class image_space_lines {
+ public:
+  image_space_lines();
+
+  // Copying is not allowed.
+  image_space_lines(const image_space_lines&) = delete;
+  image_space_lines& operator=(const image_space_lines&) = delete;
+
+  // For now, moving is not allowed.
+  image_space_lines(image_space_lines&&) = delete;
+  image_space_lines& operator=(image_space_lines&&) = delete;
+
+  // Calls 'draw' to render the geometry with the bound normal shader.
+  // Like the other shaders, it reads positions and normals from the
+  // attribute locations 0 and 1, instance offsets from location 7 and
+  // uses the uniform 'model'. The lines are blended into the framebuffer
+  // that was bound before without depth test. An enabled scissor test
+  // only applies to them.
+  void render(const camera& cam,
+              float threshold,
+              const std::function<void(shader_program&)>& draw);
+
+ private:
+  void resize(int width, int height);
+
+  int w = 0;
+  int h = 0;
+
+  shader_program normal_shader{};
+  shader_program gradient_shader{};
+  shader_program reduction_shader{};
+  shader_program line_shader{};
+  // Full-screen triangles need no attributes. But the
+  // core profile does not draw without a vertex array.
+  vertex_array screen{};
+
+  texture normals{};
+  renderbuffer depth{};
+  framebuffer geometry{};
+  texture gradients{};
+  framebuffer gradient_target{};
+  // Light variation maxima of blocks that halve in size down to one pixel
+  struct reduction_level {
+    texture maximum{};
+    framebuffer target{};
+    int width;
+    int height;
+  };
+  vector<reduction_level> reduction{};
+};
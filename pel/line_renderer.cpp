@@ -0,0 +1,212 @@
+#include "line_renderer.hpp"
+
+using namespace std;
+
+namespace {
+
+constexpr czstring vertex_shader_text =
+    "#version 330 core\n"
+
+    "uniform mat4 transform;"
+    "uniform vec2 viewport;"
+    "uniform float width;"
+    "uniform float feather;"
+    "uniform float threshold;"
+
+    "layout (location = 0) in vec4 a;"
+    "layout (location = 1) in float sa;"
+    "layout (location = 2) in vec4 b;"
+    "layout (location = 3) in float sb;"
+
+    "out float strength;"
+    "noperspective out float edge;"
+    "noperspective out float radius;"
+
+    "void main(){"
+    "  vec4 x = transform * a;"
+    "  vec4 y = transform * b;"
+    // Corners 0 and 1 belong to the start and corners 2 and 3 to the end.
+    "  bool at_end = gl_VertexID >= 2;"
+    "  float side = ((gl_VertexID & 1) == 0) ? -1.0 : 1.0;"
+    "  vec4 p = at_end ? y : x;"
+    "  strength = at_end ? sb : sa;"
+    "  float t = clamp((strength - threshold) / (1.0 - threshold), 0.0, 1.0);"
+    "  radius = 0.25 * width * (1.0 + t);"
+    "  edge = side * (radius + feather);"
+    // Segments that cross the near plane are dropped.
+    "  if ((x.w <= 0.0) || (y.w <= 0.0)) {"
+    "    gl_Position = vec4(2.0, 2.0, 2.0, 1.0);"
+    "    return;"
+    "  }"
+    "  vec2 half_viewport = 0.5 * viewport;"
+    "  vec2 d = (y.xy / y.w - x.xy / x.w) * half_viewport;"
+    "  float l = length(d);"
+    "  vec2 dir = (l > 0.0) ? d / l : vec2(1.0, 0.0);"
+    "  vec2 normal = vec2(-dir.y, dir.x);"
+    // Ends are extended such that joints of polylines do not show gaps.
+    "  vec2 offset = edge * normal + (at_end ? radius : -radius) * dir;"
+    "  gl_Position = p + vec4(offset / half_viewport * p.w, 0.0, 0.0);"
+    "}";
+
+constexpr czstring fragment_shader_text =
+    "#version 330 core\n"
+
+    "uniform float feather;"
+    "uniform float threshold;"
+
+    "in float strength;"
+    "noperspective in float edge;"
+    "noperspective in float radius;"
+
+    "layout (location = 0) out vec4 frag_color;"
+
+    "void main(){"
+    "  float scale = 0.7;"
+    "  if ((strength < threshold)) discard;"
+    "  float alpha = scale * (strength - threshold) / (1.0 - threshold);"
+    "  alpha += 1 - scale;"
+    "  alpha *= clamp((radius + feather - abs(edge)) / feather, 0.0, 1.0);"
+    "  frag_color = vec4(vec3(0.0), alpha);"
+    "}";
+
+}  // namespace
+
+line_renderer::line_renderer() {
+  vertex_shader vs{vertex_shader_text};
+  fragment_shader fs{fragment_shader_text};
+  shader = shader_program{vs, fs};
+
+  for (auto& q : queries) {
+    glGenQueries(1, &q.generated);
+    glGenQueries(1, &q.written);
+  }
+
+  segment_array.bind();
+  segment_data.bind();
+  // Every segment is given by its start and end vertex.
+  constexpr auto stride = 2 * sizeof(line_vertex);
+  const auto attribute = [&](GLuint location, GLint size, size_t offset) {
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, size, GL_FLOAT, GL_FALSE, stride,
+                          (void*)offset);
+    glVertexAttribDivisor(location, 1);
+  };
+  attribute(0, 4, offsetof(line_vertex, position));
+  attribute(1, 1, offsetof(line_vertex, strength));
+  attribute(2, 4, sizeof(line_vertex) + offsetof(line_vertex, position));
+  attribute(3, 1, sizeof(line_vertex) + offsetof(line_vertex, strength));
+  reserve(size_t{1} << 12);
+}
+
+line_renderer::~line_renderer() {
+  for (auto& q : queries) {
+    glDeleteQueries(1, &q.generated);
+    glDeleteQueries(1, &q.written);
+  }
+}
+
+void line_renderer::reserve(size_t segments) {
+  if (segments <= capacity) return;
+  capacity = segments;
+  reallocated = true;
+  memory_stage stage{"line buffers"};
+  segment_data.allocate(2 * capacity * sizeof(line_vertex), nullptr,
+                        GL_STREAM_DRAW);
+}
+
+void line_renderer::upload() {
+  count = vertices.size() / 2;
+  clip_space = false;
+  reserve(count);
+  segment_data.bind();
+  glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(line_vertex),
+                  vertices.data());
+}
+
+void line_renderer::assign(span<const line_segment> segments) {
+  vertices.clear();
+  for (const auto& s : segments) {
+    vertices.push_back({vec4{s.start, 1.0f}, s.start_strength});
+    vertices.push_back({vec4{s.end, 1.0f}, s.end_strength});
+  }
+  upload();
+}
+
+void line_renderer::assign(span<const vec3> points) {
+  vertices.clear();
+  for (size_t i = 0; i + 1 < points.size(); i += 2) {
+    vertices.push_back({vec4{points[i], 1.0f}, 1.0f});
+    vertices.push_back({vec4{points[i + 1], 1.0f}, 1.0f});
+  }
+  upload();
+}
+
+void line_renderer::capture(const shader_program& program,
+                            const function<void()>& draw,
+                            bool synchronous) {
+  // Read the results of earlier captures from oldest to newest
+  // without waiting for the GPU.
+  for (size_t i = 0; i < std::size(queries); ++i) {
+    auto& q = queries[(next_query + i) % std::size(queries)];
+    if (!q.pending) continue;
+    GLuint generated_available, written_available;
+    glGetQueryObjectuiv(q.generated, GL_QUERY_RESULT_AVAILABLE,
+                        &generated_available);
+    glGetQueryObjectuiv(q.written, GL_QUERY_RESULT_AVAILABLE,
+                        &written_available);
+    if (!generated_available || !written_available) continue;
+    GLuint generated, written;
+    glGetQueryObjectuiv(q.generated, GL_QUERY_RESULT, &generated);
+    glGetQueryObjectuiv(q.written, GL_QUERY_RESULT, &written);
+    q.pending = false;
+    count = written;
+    if (generated > written) reserve(2 * size_t(generated));
+  }
+
+  program.bind();
+  glEnable(GL_RASTERIZER_DISCARD);
+  while (true) {
+    auto& q = queries[next_query];
+    next_query = (next_query + 1) % std::size(queries);
+    glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, segment_data);
+    glBeginQuery(GL_PRIMITIVES_GENERATED, q.generated);
+    glBeginQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN, q.written);
+    glBeginTransformFeedback(GL_LINES);
+    draw();
+    glEndTransformFeedback();
+    glEndQuery(GL_TRANSFORM_FEEDBACK_PRIMITIVES_WRITTEN);
+    glEndQuery(GL_PRIMITIVES_GENERATED);
+    q.pending = true;
+    if (!synchronous && !reallocated) break;
+
+    GLuint generated, written;
+    glGetQueryObjectuiv(q.generated, GL_QUERY_RESULT, &generated);
+    glGetQueryObjectuiv(q.written, GL_QUERY_RESULT, &written);
+    q.pending = false;
+    count = written;
+    if (generated <= capacity) {
+      reallocated = false;
+      break;
+    }
+    // Segments that did not fit are captured again with enough space.
+    reserve(2 * size_t(generated));
+  }
+  glDisable(GL_RASTERIZER_DISCARD);
+  glBindBufferBase(GL_TRANSFORM_FEEDBACK_BUFFER, 0, 0);
+  clip_space = true;
+}
+
+void line_renderer::render(const camera& cam, const options& opts) {
+  if (!count) return;
+  shader.bind();
+  shader  //
+      .set("transform", clip_space
+                            ? mat4{1.0f}
+                            : cam.projection_matrix() * cam.view_matrix())
+      .set("viewport", vec2{cam.screen_width(), cam.screen_height()})
+      .set("width", opts.width)
+      .set("feather", opts.feather)
+      .set("threshold", opts.threshold);
+  segment_array.bind();
+  glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, count);
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <functional>
+//
+#include "buffer.hpp"
+#include "camera.hpp"
+#include "photic_extremum_lines.hpp"
+#include "shader.hpp"
+#include "utility.hpp"
+#include "vertex_array.hpp"
+
+// Outputs of the line shaders that are captured by 'line_renderer'.
+// Their geometry shaders have to emit line strips.
+constexpr czstring line_capture_varyings[] = {"gl_Position", "strength"};
+
+// Draws line segments as quads in screen space with anti-aliased edges.
+// Every segment is one instance of a triangle strip with four vertices.
+// So all segments are drawn by a single instanced draw call and the
+// thickness of lines does not depend on the support of wide lines.
+// Width and opacity grow with the strength of the segments.
+class line_renderer {
+ public:
+  struct options {
+    // Width in pixels of segments with full strength.
+    // Segments at the threshold are half as wide.
+    float width = 2.5f;
+    // Width in pixels of the anti-aliased edges
+    float feather = 1.0f;
+    float threshold = 0.0f;
+  };
+
+  line_renderer();
+  ~line_renderer();
+
+  // Copying is not allowed.
+  line_renderer(const line_renderer&) = delete;
+  line_renderer& operator=(const line_renderer&) = delete;
+
+  // For now, moving is not allowed.
+  line_renderer(line_renderer&&) = delete;
+  line_renderer& operator=(line_renderer&&) = delete;
+
+  auto size() const noexcept { return count; }
+
+  // Uploads segments in world space.
+  void assign(std::span<const line_segment> segments);
+  // Uploads segments in world space with full strength
+  // given by consecutive pairs of points.
+  void assign(std::span<const vec3> points);
+
+  // Binds the program and replaces the segments by the line strips that
+  // its geometry shader emits while 'draw' is called. The program must
+  // record 'line_capture_varyings' and 'draw' must not bind a program.
+  // Nothing is rasterized. The segments stay in clip space on the GPU.
+  //
+  // Reading the number of captured segments right away would stall on
+  // the GPU. Instead, it is taken from the latest earlier capture whose
+  // queries are available, typically the one of the previous frame.
+  // A buffer that turns out to be too small grows for later captures.
+  // After growing and if 'synchronous' is set, the capture waits for
+  // its own count and is repeated until all segments fit.
+  // Every renderer should therefore capture the same kind of lines.
+  void capture(const shader_program& program,
+               const std::function<void()>& draw,
+               bool synchronous = false);
+
+  void render(const camera& cam, const options& opts);
+
+ private:
+  // Layout of the captured vertices
+  struct line_vertex {
+    vec4 position;
+    float strength;
+  };
+
+  void reserve(size_t segments);
+  void upload();
+
+  shader_program shader{};
+  vertex_array segment_array{};
+  vertex_buffer segment_data{};
+  size_t capacity = 0;
+  size_t count = 0;
+  // Captured segments are given in clip space.
+  bool clip_space = false;
+  vector<line_vertex> vertices{};
+  // Captures into a newly allocated buffer wait for their count
+  // because the rest of the buffer is undefined.
+  bool reallocated = false;
+
+  // Queries of the most recent captures
+  struct capture_queries {
+    // Primitives generated by the geometry shader and the ones written
+    // into the buffer. Both differ if the buffer was too small.
+    GLuint generated{};
+    GLuint written{};
+    bool pending{};
+  };
+  capture_queries queries[3]{};
+  // Slot of the oldest capture which is reused by the next one
+  size_t next_query = 0;
+};
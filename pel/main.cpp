@@ -3,11 +3,15 @@
 #include "application.hpp"
 
 int main(int argc, char* argv[]) {
-  if (argc != 2) {
-    cout << "usage:\n" << argv[0] << " <STL object file path>\n";
+  if (argc < 2) {
+    cout << "usage:\n"
+         << argv[0]
+         << " <STL, OBJ, PLY or scene file path> [<animation frames>...]\n"
+         << "environment:\n"
+         << "PEL_THREADS=<thread count> PEL_CORES=<cores, e.g. 0-3,8>\n";
     return 0;
   }
   application::init();
-  application::load_model(argv[1]);
+  application::load_model(argv[1], {argv + 2, argv + argc});
   application::run();
 }
@@ -0,0 +1,38 @@
+#include "mapped_file.hpp"
+//
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+using namespace std;
+
+mapped_file::mapped_file(czstring file_path) {
+  const auto fd = open(file_path, O_RDONLY);
+  if (fd == -1)
+    throw runtime_error("Failed to open file '"s + file_path + "'.");
+  struct stat info;
+  if (fstat(fd, &info) == -1) {
+    close(fd);
+    throw runtime_error("Failed to get size of file '"s + file_path + "'.");
+  }
+  bytes = info.st_size;
+  if (bytes == 0) {
+    close(fd);
+    return;
+  }
+  const auto p = mmap(nullptr, bytes, PROT_READ, MAP_PRIVATE, fd, 0);
+  // The mapping stays valid after closing the file descriptor.
+  close(fd);
+  if (p == MAP_FAILED) {
+    bytes = 0;
+    throw runtime_error("Failed to map file '"s + file_path + "'.");
+  }
+  // The whole file is read sequentially by the parsers.
+  madvise(p, bytes, MADV_SEQUENTIAL);
+  ptr = static_cast<const char*>(p);
+}
+
+mapped_file::~mapped_file() {
+  if (ptr) munmap(const_cast<char*>(ptr), bytes);
+}
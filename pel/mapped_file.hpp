@@ -0,0 +1,34 @@
+#pragma once
+#include "utility.hpp"
+
+// Read-only memory mapping of a whole file.
+// We use this class for RAII functionality and exception safety.
+class mapped_file {
+ public:
+  mapped_file() = default;
+  explicit mapped_file(czstring file_path);
+  ~mapped_file();
+
+  // Copying is not allowed.
+  mapped_file(const mapped_file&) = delete;
+  mapped_file& operator=(const mapped_file&) = delete;
+
+  // Moving
+  mapped_file(mapped_file&& x) : ptr{x.ptr}, bytes{x.bytes} {
+    x.ptr = nullptr;
+    x.bytes = 0;
+  }
+  mapped_file& operator=(mapped_file&& x) {
+    swap(ptr, x.ptr);
+    swap(bytes, x.bytes);
+    return *this;
+  }
+
+  auto data() const noexcept -> const char* { return ptr; }
+  auto size() const noexcept -> size_t { return bytes; }
+  auto view() const noexcept -> std::string_view { return {ptr, bytes}; }
+
+ private:
+  const char* ptr = nullptr;
+  size_t bytes = 0;
+};
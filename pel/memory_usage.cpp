@@ -0,0 +1,323 @@
+#include "memory_usage.hpp"
+//
+#include <atomic>
+#include <cstdlib>
+#include <mutex>
+#include <new>
+#include <sstream>
+
+using namespace std;
+
+auto process_memory_usage() -> memory_usage {
+  memory_usage result{};
+  ifstream file{"/proc/self/status"};
+  string line;
+  while (getline(file, line)) {
+    // Values are given in kibibytes.
+    const auto value = [&] { return 1024 * stoull(line.substr(6)); };
+    if (line.starts_with("VmRSS:")) result.current = value();
+    if (line.starts_with("VmHWM:")) result.peak = value();
+  }
+  return result;
+}
+
+void reset_peak_memory_usage() {
+  ofstream file{"/proc/self/clear_refs"};
+  file << "5";
+}
+
+namespace {
+
+constexpr size_t max_memory_stages = 64;
+
+// All counters are constant-initialized. So they may
+// be used by allocations before the start of 'main'.
+// There are no global heap counters that every allocation would update.
+// Instead, every stage has its own cache line and totals are their sums.
+struct alignas(64) stage_counters {
+  atomic<czstring> name{nullptr};
+  atomic<size_t> allocations{0};
+  atomic<size_t> allocated_bytes{0};
+  atomic<size_t> live_bytes{0};
+  atomic<size_t> peak_live_bytes{0};
+  atomic<size_t> gpu_bytes{0};
+  atomic<size_t> peak_gpu_bytes{0};
+};
+
+stage_counters stages[max_memory_stages]{};
+atomic<size_t> stage_count{1};
+mutex stage_mutex{};
+thread_local memory_stage_id current_stage = 0;
+
+atomic<size_t> gpu_live_bytes{0};
+atomic<size_t> gpu_peak_bytes{0};
+
+void raise_peak(atomic<size_t>& peak, size_t value) noexcept {
+  auto p = peak.load(memory_order_relaxed);
+  while ((value > p) &&
+         !peak.compare_exchange_weak(p, value, memory_order_relaxed)) {
+  }
+}
+
+// Registration must not allocate. Otherwise, the
+// allocation would be counted while holding the mutex.
+auto stage_index(czstring name) noexcept -> memory_stage_id {
+  const auto find = [name](size_t count) -> memory_stage_id {
+    for (size_t i = 1; i < count; ++i)
+      if (strcmp(stages[i].name.load(memory_order_relaxed), name) == 0)
+        return i;
+    return 0;
+  };
+  if (const auto id = find(stage_count.load(memory_order_acquire))) return id;
+  scoped_lock lock{stage_mutex};
+  const auto count = stage_count.load(memory_order_relaxed);
+  if (const auto id = find(count)) return id;
+  if (count == max_memory_stages) return 0;
+  stages[count].name.store(name, memory_order_relaxed);
+  stage_count.store(count + 1, memory_order_release);
+  return count;
+}
+
+#if defined(PEL_MEMORY_ACCOUNTING)
+
+// Every allocation starts with a header that stores its size and stage.
+// The header directly precedes the returned pointer and the offset
+// allows to get back to the start of over-aligned allocations.
+struct alignas(16) allocation_header {
+  memory_stage_id stage;
+  uint32_t offset;
+  size_t size;
+};
+
+auto allocate(size_t size, size_t alignment) noexcept -> void* {
+  const auto offset = std::max(sizeof(allocation_header), alignment);
+  void* base = nullptr;
+  if (alignment <= alignof(max_align_t))
+    base = malloc(size + offset);
+  else
+    base = aligned_alloc(alignment,
+                         (size + offset + alignment - 1) & ~(alignment - 1));
+  if (!base) return nullptr;
+
+  const auto result = static_cast<char*>(base) + offset;
+  const auto header = reinterpret_cast<allocation_header*>(result) - 1;
+  *header = {current_stage, uint32_t(offset), size};
+  auto& s = stages[current_stage];
+  s.allocations.fetch_add(1, memory_order_relaxed);
+  s.allocated_bytes.fetch_add(size, memory_order_relaxed);
+  raise_peak(s.peak_live_bytes,
+             s.live_bytes.fetch_add(size, memory_order_relaxed) + size);
+  return result;
+}
+
+void deallocate(void* ptr) noexcept {
+  if (!ptr) return;
+  const auto header = static_cast<allocation_header*>(ptr) - 1;
+  stages[header->stage].live_bytes.fetch_sub(header->size,
+                                             memory_order_relaxed);
+  free(static_cast<char*>(ptr) - header->offset);
+}
+
+auto allocate_or_throw(size_t size, size_t alignment) -> void* {
+  while (true) {
+    if (const auto result = allocate(size, alignment)) return result;
+    const auto handler = get_new_handler();
+    if (!handler) throw bad_alloc{};
+    handler();
+  }
+}
+
+auto allocate_or_null(size_t size, size_t alignment) noexcept -> void* {
+  try {
+    return allocate_or_throw(size, alignment);
+  } catch (...) {
+    return nullptr;
+  }
+}
+
+#endif
+
+}  // namespace
+
+auto current_memory_stage() noexcept -> memory_stage_id {
+  return current_stage;
+}
+
+memory_stage::memory_stage(czstring name) noexcept
+    : memory_stage{stage_index(name)} {}
+
+memory_stage::memory_stage(memory_stage_id id) noexcept
+    : previous{current_stage} {
+  current_stage = id;
+}
+
+memory_stage::~memory_stage() {
+  current_stage = previous;
+}
+
+void set_memory_stage(czstring name) noexcept {
+  current_stage = stage_index(name);
+}
+
+void add_gpu_memory(memory_stage_id stage, size_t bytes) noexcept {
+  auto& s = stages[stage];
+  raise_peak(s.peak_gpu_bytes,
+             s.gpu_bytes.fetch_add(bytes, memory_order_relaxed) + bytes);
+  raise_peak(gpu_peak_bytes,
+             gpu_live_bytes.fetch_add(bytes, memory_order_relaxed) + bytes);
+}
+
+void remove_gpu_memory(memory_stage_id stage, size_t bytes) noexcept {
+  stages[stage].gpu_bytes.fetch_sub(bytes, memory_order_relaxed);
+  gpu_live_bytes.fetch_sub(bytes, memory_order_relaxed);
+}
+
+auto memory_stage_usages() -> vector<memory_stage_usage> {
+  vector<memory_stage_usage> result{};
+  const auto count = stage_count.load(memory_order_acquire);
+  result.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    const auto& s = stages[i];
+    memory_stage_usage x{};
+    x.name = (i == 0) ? "other" : s.name.load(memory_order_relaxed);
+    x.allocations = s.allocations.load(memory_order_relaxed);
+    x.allocated_bytes = s.allocated_bytes.load(memory_order_relaxed);
+    x.live_bytes = s.live_bytes.load(memory_order_relaxed);
+    x.peak_live_bytes = s.peak_live_bytes.load(memory_order_relaxed);
+    x.gpu_bytes = s.gpu_bytes.load(memory_order_relaxed);
+    x.peak_gpu_bytes = s.peak_gpu_bytes.load(memory_order_relaxed);
+    if (x.allocations || x.peak_gpu_bytes) result.push_back(x);
+  }
+  return result;
+}
+
+void reset_memory_stage_peaks() noexcept {
+  const auto count = stage_count.load(memory_order_acquire);
+  for (size_t i = 0; i < count; ++i) {
+    auto& s = stages[i];
+    s.peak_live_bytes = s.live_bytes.load(memory_order_relaxed);
+    s.peak_gpu_bytes = s.gpu_bytes.load(memory_order_relaxed);
+  }
+  gpu_peak_bytes = gpu_live_bytes.load(memory_order_relaxed);
+}
+
+void print_memory_report(ostream& os) {
+  const auto usages = memory_stage_usages();
+  const auto mib = [](size_t bytes) {
+    ostringstream out{};
+    out << fixed << setprecision(1) << mebibytes(bytes);
+    return out.str();
+  };
+  os << "memory report [MiB]:\n"
+     << left << setw(24) << "stage" << right << setw(12) << "allocations"
+     << setw(11) << "allocated" << setw(11) << "live" << setw(11) << "peak"
+     << setw(11) << "GPU" << setw(11) << "GPU peak" << '\n';
+  for (const auto& x : usages)
+    os << left << setw(24) << x.name << right << setw(12) << x.allocations
+       << setw(11) << mib(x.allocated_bytes) << setw(11) << mib(x.live_bytes)
+       << setw(11) << mib(x.peak_live_bytes) << setw(11) << mib(x.gpu_bytes)
+       << setw(11) << mib(x.peak_gpu_bytes) << '\n';
+  const auto rss = process_memory_usage();
+  if (heap_memory_accounting) {
+    size_t heap = 0;
+    for (const auto& x : usages) heap += x.live_bytes;
+    os << "heap: live = " << mib(heap) << " MiB\n";
+  } else {
+    os << "heap: not accounted without config.pel.memory_accounting\n";
+  }
+  os << "GPU buffers: live = " << mib(gpu_live_bytes) << " MiB"
+     << ", peak = " << mib(gpu_peak_bytes) << " MiB\n"
+     << "resident: current = " << mib(rss.current) << " MiB"
+     << ", peak = " << mib(rss.peak) << " MiB" << endl;
+}
+
+#if defined(PEL_MEMORY_ACCOUNTING)
+
+// Replacements of the global allocation functions
+// The sized deallocations ignore the given size and use the header.
+
+void* operator new(size_t size) {
+  return allocate_or_throw(size, alignof(max_align_t));
+}
+
+void* operator new[](size_t size) {
+  return allocate_or_throw(size, alignof(max_align_t));
+}
+
+void* operator new(size_t size, align_val_t alignment) {
+  return allocate_or_throw(size, size_t(alignment));
+}
+
+void* operator new[](size_t size, align_val_t alignment) {
+  return allocate_or_throw(size, size_t(alignment));
+}
+
+void* operator new(size_t size, const nothrow_t&) noexcept {
+  return allocate_or_null(size, alignof(max_align_t));
+}
+
+void* operator new[](size_t size, const nothrow_t&) noexcept {
+  return allocate_or_null(size, alignof(max_align_t));
+}
+
+void* operator new(size_t size,
+                   align_val_t alignment,
+                   const nothrow_t&) noexcept {
+  return allocate_or_null(size, size_t(alignment));
+}
+
+void* operator new[](size_t size,
+                     align_val_t alignment,
+                     const nothrow_t&) noexcept {
+  return allocate_or_null(size, size_t(alignment));
+}
+
+void operator delete(void* ptr) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, align_val_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, size_t, align_val_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, size_t, align_val_t) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, const nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, const nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete(void* ptr, align_val_t, const nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+void operator delete[](void* ptr, align_val_t, const nothrow_t&) noexcept {
+  deallocate(ptr);
+}
+
+#endif
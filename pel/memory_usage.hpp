@@ -0,0 +1,90 @@
+#pragma once
+#include <iosfwd>
+//
+#include "utility.hpp"
+
+// Resident set size of the process in bytes.
+// On systems without procfs, all values are zero.
+struct memory_usage {
+  size_t current{};
+  size_t peak{};
+};
+
+auto process_memory_usage() -> memory_usage;
+
+// Resets the peak resident set size to the current one such that
+// the peak of every pipeline stage can be measured on its own.
+void reset_peak_memory_usage();
+
+// Formats a byte count in mebibytes.
+inline auto mebibytes(size_t bytes) -> float {
+  return float(bytes) / (1 << 20);
+}
+
+// Memory Accounting by Pipeline Stage
+// If built with PEL_MEMORY_ACCOUNTING, i.e. config.pel.memory_accounting,
+// the global operators new and delete are replaced such that every heap
+// allocation is counted for the stage of the allocating thread. Freed
+// memory is credited back to the stage that allocated it, regardless of
+// the thread that frees it. Tasks of the scheduler inherit the stage of
+// the thread that submitted them. GPU buffers are counted by 'buffer'.
+// Stages are identified by their names which must outlive the process,
+// e.g. string literals. Stage zero collects everything untagged and
+// the allocations of stages that exceed the maximum stage count.
+// Without the replacement, stages only account GPU buffers.
+using memory_stage_id = uint32_t;
+
+constexpr bool heap_memory_accounting =
+#if defined(PEL_MEMORY_ACCOUNTING)
+    true;
+#else
+    false;
+#endif
+
+auto current_memory_stage() noexcept -> memory_stage_id;
+
+// Sets the stage of the calling thread for the lifetime of the object.
+class memory_stage {
+ public:
+  explicit memory_stage(czstring name) noexcept;
+  explicit memory_stage(memory_stage_id id) noexcept;
+  ~memory_stage();
+
+  // Copying is not allowed.
+  memory_stage(const memory_stage&) = delete;
+  memory_stage& operator=(const memory_stage&) = delete;
+
+  // For now, moving is not allowed.
+  memory_stage(memory_stage&&) = delete;
+  memory_stage& operator=(memory_stage&&) = delete;
+
+ private:
+  memory_stage_id previous;
+};
+
+// Sets the stage of the calling thread until it is set again.
+void set_memory_stage(czstring name) noexcept;
+
+void add_gpu_memory(memory_stage_id stage, size_t bytes) noexcept;
+void remove_gpu_memory(memory_stage_id stage, size_t bytes) noexcept;
+
+struct memory_stage_usage {
+  czstring name{};
+  size_t allocations{};
+  size_t allocated_bytes{};
+  // Bytes that have been allocated by the stage and are not freed yet
+  size_t live_bytes{};
+  size_t peak_live_bytes{};
+  size_t gpu_bytes{};
+  size_t peak_gpu_bytes{};
+};
+
+// Usage of all stages that have allocated any memory
+auto memory_stage_usages() -> vector<memory_stage_usage>;
+
+// Resets the peaks of all stages and of the GPU total to their live bytes.
+void reset_memory_stage_peaks() noexcept;
+
+// Prints a table of all stages followed by the totals
+// of heap, GPU buffers and the resident set size.
+void print_memory_report(std::ostream& os);
@@ -0,0 +1,98 @@
+#include "mesh_cache.hpp"
+//
+#include "model_loader.hpp"
+
+using namespace std;
+
+prepared_mesh::prepared_mesh(czstring file_path)
+    : prepared_mesh{[file_path] {
+        mesh_geometry mesh{};
+        load_mesh_file(file_path, mesh);
+        return mesh;
+      }()} {}
+
+prepared_mesh::prepared_mesh(mesh_geometry mesh) : geometry{std::move(mesh)} {
+  {
+    memory_stage stage{"gradient data"};
+    gradient_data.resize(geometry.faces.size());
+  }
+  {
+    memory_stage stage{"illumination data"};
+    illumination_data.resize(geometry.vertices.size());
+  }
+  {
+    memory_stage stage{"adjacency"};
+    adjacency = gradient_adjacency(geometry);
+  }
+  compute_voronoi_weights(geometry, gradient_data);
+  compute_vertex_voronoi_area(geometry, gradient_data, adjacency,
+                              illumination_data);
+  compute_vertex_tangent_system(geometry, gradient_data, illumination_data);
+}
+
+auto prepared_mesh::memory_size() const noexcept -> size_t {
+  return geometry.vertices.capacity() * sizeof(mesh_geometry::vertex) +
+         geometry.faces.capacity() * sizeof(mesh_geometry::face) +
+         gradient_data.capacity() * sizeof(gradient_info) +
+         illumination_data.capacity() * sizeof(illumination_info) +
+         adjacency.offsets.capacity() * sizeof(uint32_t) +
+         adjacency.face_indices.capacity() * sizeof(uint32_t);
+}
+
+auto mesh_cache::get(const string& file_path)
+    -> shared_ptr<const prepared_mesh> {
+  std::promise<shared_ptr<const prepared_mesh>> promise{};
+  uint64_t id;
+  {
+    unique_lock lock{mutex};
+    if (const auto it = index.find(file_path); it != end(index)) {
+      ++hits;
+      entries.splice(begin(entries), entries, it->second);
+      const auto mesh = it->second->mesh;
+      // Waiting for a mesh that is still loaded must not block the cache.
+      lock.unlock();
+      return mesh.get();
+    }
+    ++misses;
+    id = next_id++;
+    entries.push_front({id, file_path, promise.get_future().share(), 0});
+    index[file_path] = begin(entries);
+  }
+
+  shared_ptr<const prepared_mesh> mesh{};
+  try {
+    mesh = make_shared<const prepared_mesh>(file_path.c_str());
+  } catch (...) {
+    // Failed loads are not cached such that they can be retried.
+    promise.set_exception(current_exception());
+    scoped_lock lock{mutex};
+    if (const auto it = index.find(file_path);
+        (it != end(index)) && (it->second->id == id)) {
+      entries.erase(it->second);
+      index.erase(it);
+    }
+    throw;
+  }
+  promise.set_value(mesh);
+
+  scoped_lock lock{mutex};
+  // The entry may have been evicted while the mesh was loaded.
+  if (const auto it = index.find(file_path);
+      (it != end(index)) && (it->second->id == id)) {
+    it->second->size = mesh->memory_size();
+    memory += it->second->size;
+  }
+  // The most recently used mesh is kept even if it exceeds the budget.
+  while ((memory > budget) && (entries.size() > 1)) {
+    const auto& last = entries.back();
+    memory -= last.size;
+    index.erase(last.path);
+    entries.pop_back();
+  }
+  return mesh;
+}
+
+auto mesh_cache::stats() const -> statistics {
+  scoped_lock lock{mutex};
+  return {entries.size(), memory, hits, misses};
+}
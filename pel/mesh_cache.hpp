@@ -0,0 +1,68 @@
+#pragma once
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+//
+#include "mesh_clusters.hpp"
+#include "photic_extremum_lines.hpp"
+#include "utility.hpp"
+
+// Mesh with all data that does not depend on the light direction
+struct prepared_mesh {
+  explicit prepared_mesh(czstring file_path);
+  explicit prepared_mesh(mesh_geometry mesh);
+
+  auto memory_size() const noexcept -> size_t;
+
+  mesh_geometry geometry{};
+  vector<gradient_info> gradient_data{};
+  vector<illumination_info> illumination_data{};
+  vertex_face_adjacency adjacency{};
+};
+
+// Keeps prepared meshes identified by their file path in memory.
+// The least recently used meshes are evicted as soon as the sum of
+// their sizes exceeds the memory budget. Meshes that are still in use
+// by a request stay alive until the request has finished.
+// Concurrent requests for the same mesh load it only once.
+class mesh_cache {
+ public:
+  struct statistics {
+    size_t meshes{};
+    size_t memory{};
+    size_t hits{};
+    size_t misses{};
+  };
+
+  explicit mesh_cache(size_t memory_budget) : budget{memory_budget} {}
+
+  // Copying is not allowed.
+  mesh_cache(const mesh_cache&) = delete;
+  mesh_cache& operator=(const mesh_cache&) = delete;
+
+  // Loads and prepares the mesh if it is not cached.
+  // Errors of the loading process are rethrown.
+  auto get(const string& file_path) -> std::shared_ptr<const prepared_mesh>;
+
+  auto stats() const -> statistics;
+
+ private:
+  struct entry {
+    uint64_t id{};
+    string path{};
+    std::shared_future<std::shared_ptr<const prepared_mesh>> mesh{};
+    // Zero while the mesh is loaded
+    size_t size{};
+  };
+
+  // Recently used entries are at the front.
+  std::list<entry> entries{};
+  std::unordered_map<string, std::list<entry>::iterator> index{};
+  size_t budget{};
+  size_t memory{};
+  size_t hits{};
+  size_t misses{};
+  uint64_t next_id{};
+  mutable std::mutex mutex{};
+};
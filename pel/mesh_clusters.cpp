@@ -0,0 +1,231 @@
+#include "mesh_clusters.hpp"
+//
+#include <bit>
+
+using namespace std;
+
+namespace {
+
+// Interleaves the lower ten bits of x with two zero bits each.
+constexpr auto spread_bits(uint32_t x) noexcept -> uint32_t {
+  x &= 0x000003ff;
+  x = (x ^ (x << 16)) & 0xff0000ff;
+  x = (x ^ (x << 8)) & 0x0300f00f;
+  x = (x ^ (x << 4)) & 0x030c30c3;
+  x = (x ^ (x << 2)) & 0x09249249;
+  return x;
+}
+
+}  // namespace
+
+void fit_mesh_cluster(const mesh_geometry& mesh, mesh_cluster& cluster) {
+  const auto cluster_faces =
+      span{&mesh.faces[cluster.first_face], size_t(cluster.face_count)};
+
+  // Bounding sphere around the center of the bounding box
+  vec3 cmin = mesh.vertices[cluster_faces[0][0]].position;
+  vec3 cmax = cmin;
+  vec3 normal_sum{};
+  for (const auto& f : cluster_faces) {
+    for (auto i : f) {
+      cmin = min(cmin, mesh.vertices[i].position);
+      cmax = max(cmax, mesh.vertices[i].position);
+      normal_sum += mesh.vertices[i].normal;
+    }
+  }
+  cluster.center = (cmin + cmax) / 2.0f;
+  cluster.radius = 0;
+  for (const auto& f : cluster_faces)
+    for (auto i : f)
+      cluster.radius =
+          std::max(cluster.radius,
+                   distance(cluster.center, mesh.vertices[i].position));
+
+  // Normal cone around the average normal
+  const auto axis_length = length(normal_sum);
+  if (axis_length > 1e-6f) {
+    cluster.cone_axis = normal_sum / axis_length;
+    float min_cos = 1;
+    for (const auto& f : cluster_faces)
+      for (auto i : f)
+        min_cos = std::min(min_cos,
+                           dot(cluster.cone_axis, mesh.vertices[i].normal));
+    cluster.cone_angle = acos(std::clamp(min_cos, -1.0f, 1.0f));
+  } else {
+    cluster.cone_axis = {0, 0, 1};
+    cluster.cone_angle = pi;
+  }
+}
+
+auto build_mesh_clusters(mesh_geometry& mesh, size_t cluster_size)
+    -> vector<mesh_cluster> {
+  vector<mesh_cluster> clusters{};
+  if (mesh.faces.empty()) return clusters;
+
+  vec3 aabb_min = mesh.vertices[0].position;
+  vec3 aabb_max = mesh.vertices[0].position;
+  for (const auto& v : mesh.vertices) {
+    aabb_min = min(aabb_min, v.position);
+    aabb_max = max(aabb_max, v.position);
+  }
+  const auto scale = 1023.0f / max(aabb_max - aabb_min, vec3{1e-20f});
+
+  // Sort faces by the Morton code of their centroids.
+  vector<pair<uint32_t, uint32_t>> codes(mesh.faces.size());
+  for (size_t i = 0; i < mesh.faces.size(); ++i) {
+    const auto& f = mesh.faces[i];
+    const auto c = (mesh.vertices[f[0]].position +
+                    mesh.vertices[f[1]].position +
+                    mesh.vertices[f[2]].position) /
+                   3.0f;
+    const auto p = (c - aabb_min) * scale;
+    codes[i] = {spread_bits(uint32_t(p.x)) |
+                    (spread_bits(uint32_t(p.y)) << 1) |
+                    (spread_bits(uint32_t(p.z)) << 2),
+                uint32_t(i)};
+  }
+  sort(begin(codes), end(codes));
+  {
+    vector<mesh_geometry::face> faces(mesh.faces.size());
+    for (size_t i = 0; i < faces.size(); ++i)
+      faces[i] = mesh.faces[codes[i].second];
+    mesh.faces = std::move(faces);
+  }
+
+  // Ranges are recursively split where the highest differing bit of their
+  // Morton codes changes. Clusters therefore stay spatially compact
+  // and do not straddle jumps of the curve.
+  const auto make_cluster = [&](size_t first, size_t last) {
+    mesh_cluster cluster{};
+    cluster.first_face = first;
+    cluster.face_count = last - first;
+    fit_mesh_cluster(mesh, cluster);
+    clusters.push_back(cluster);
+  };
+  // The stack is processed in order such that clusters keep the face order.
+  vector<pair<size_t, size_t>> ranges{{0, codes.size()}};
+  while (!ranges.empty()) {
+    const auto [first, last] = ranges.back();
+    ranges.pop_back();
+    if (last - first <= cluster_size) {
+      make_cluster(first, last);
+      continue;
+    }
+    const auto prefix = codes[first].first ^ codes[last - 1].first;
+    size_t mid = first + (last - first) / 2;
+    if (prefix) {
+      const auto bit = uint32_t{1} << (31 - countl_zero(prefix));
+      mid = partition_point(
+                begin(codes) + first, begin(codes) + last,
+                [&](const auto& x) { return !(x.first & bit); }) -
+            begin(codes);
+    }
+    ranges.push_back({mid, last});
+    ranges.push_back({first, mid});
+  }
+  return clusters;
+}
+
+frustum::frustum(const mat4& m) {
+  // Gribb-Hartmann extraction of the clipping planes
+  const auto row = [&](int i) {
+    return vec4{m[0][i], m[1][i], m[2][i], m[3][i]};
+  };
+  const auto r0 = row(0);
+  const auto r1 = row(1);
+  const auto r2 = row(2);
+  const auto r3 = row(3);
+  planes[0] = r3 + r0;
+  planes[1] = r3 - r0;
+  planes[2] = r3 + r1;
+  planes[3] = r3 - r1;
+  planes[4] = r3 + r2;
+  planes[5] = r3 - r2;
+  for (auto& p : planes) p /= length(vec3{p});
+}
+
+bool frustum::intersects(vec3 center, float radius) const noexcept {
+  for (const auto& p : planes)
+    if (dot(vec3{p}, center) + p.w < -radius) return false;
+  return true;
+}
+
+bool may_contain_contour(const mesh_cluster& cluster, vec3 eye) noexcept {
+  // A contour point needs a normal that is orthogonal to its view vector.
+  // All normals deviate at most by the cone angle from the axis and
+  // all view vectors deviate at most by the angle of the bounding sphere
+  // from the view vector to its center.
+  const auto v = cluster.center - eye;
+  const auto d = length(v);
+  if (d <= cluster.radius) return true;
+  const auto alpha =
+      acos(std::clamp(dot(cluster.cone_axis, v) / d, -1.0f, 1.0f));
+  const auto beta = asin(cluster.radius / d);
+  const auto spread = cluster.cone_angle + beta;
+  return (alpha - spread <= pi / 2) && (alpha + spread >= pi / 2);
+}
+
+vertex_face_adjacency::vertex_face_adjacency(const mesh_geometry& mesh)
+    : offsets(mesh.vertices.size() + 1), face_indices(3 * mesh.faces.size()) {
+  for (const auto& f : mesh.faces)
+    for (auto i : f) ++offsets[i + 1];
+  for (size_t i = 1; i < offsets.size(); ++i) offsets[i] += offsets[i - 1];
+  auto fill = offsets;
+  for (size_t i = 0; i < mesh.faces.size(); ++i)
+    for (auto j : mesh.faces[i]) face_indices[fill[j]++] = i;
+}
+
+vertex_face_adjacency::vertex_face_adjacency(const mesh_geometry& mesh,
+                                             span<const uint32_t> faces)
+    : offsets(mesh.vertices.size() + 1), face_indices(3 * faces.size()) {
+  for (auto f : faces)
+    for (auto i : mesh.faces[f]) ++offsets[i + 1];
+  for (size_t i = 1; i < offsets.size(); ++i) offsets[i] += offsets[i - 1];
+  auto fill = offsets;
+  for (auto f : faces)
+    for (auto j : mesh.faces[f]) face_indices[fill[j]++] = f;
+}
+
+void mesh_selection::assign(const mesh_geometry& mesh,
+                            const vector<mesh_cluster>& clusters,
+                            span<const uint32_t> cluster_indices,
+                            const vertex_face_adjacency& adjacency,
+                            size_t rings) {
+  faces.clear();
+  vertices.clear();
+  ring_ends.clear();
+  face_marks.assign(mesh.faces.size(), false);
+  vertex_marks.assign(mesh.vertices.size(), false);
+
+  const auto add_face = [&](uint32_t i) {
+    if (face_marks[i]) return;
+    face_marks[i] = true;
+    faces.push_back(i);
+  };
+  const auto add_vertex = [&](uint32_t i) {
+    if (vertex_marks[i]) return;
+    vertex_marks[i] = true;
+    vertices.push_back(i);
+  };
+
+  // Vertices of the clusters receive all their adjacent faces.
+  for (auto c : cluster_indices) {
+    const auto& cluster = clusters[c];
+    for (auto i = cluster.first_face;
+         i < cluster.first_face + cluster.face_count; ++i)
+      for (auto v : mesh.faces[i]) add_vertex(v);
+  }
+  ring_ends.push_back(vertices.size());
+  // Every ring consists of the new vertices of the faces around the
+  // previous one. Hence, the faces of the last ring are not included.
+  size_t first = 0;
+  for (size_t r = 0; r < rings; ++r) {
+    const auto face_count = faces.size();
+    for (auto i = first; i < ring_ends.back(); ++i)
+      for (auto f : adjacency.faces(vertices[i])) add_face(f);
+    for (auto k = face_count; k < faces.size(); ++k)
+      for (auto v : mesh.faces[faces[k]]) add_vertex(v);
+    first = ring_ends.back();
+    ring_ends.push_back(vertices.size());
+  }
+}
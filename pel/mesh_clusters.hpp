@@ -0,0 +1,79 @@
+#pragma once
+#include "model.hpp"
+#include "utility.hpp"
+
+// Spatially coherent range of faces that is culled as a whole.
+struct mesh_cluster {
+  uint32_t first_face{};
+  uint32_t face_count{};
+  // Bounding Sphere
+  vec3 center{};
+  float radius{};
+  // Cone containing all vertex normals given by its axis and half angle
+  vec3 cone_axis{};
+  float cone_angle{};
+};
+
+// Reorders the faces of the mesh along a Morton curve of their centroids
+// and splits them into consecutive clusters of at most 'cluster_size' faces.
+// Must be called before any per-face data of the mesh is computed.
+auto build_mesh_clusters(mesh_geometry& mesh, size_t cluster_size = 128)
+    -> vector<mesh_cluster>;
+
+// Recomputes bounding sphere and normal cone of the cluster
+// from the current positions and normals of its vertices.
+void fit_mesh_cluster(const mesh_geometry& mesh, mesh_cluster& cluster);
+
+// View frustum given by the planes of a view-projection matrix
+struct frustum {
+  explicit frustum(const mat4& view_projection);
+  bool intersects(vec3 center, float radius) const noexcept;
+  vec4 planes[6];
+};
+
+// Returns false if all vertices of the cluster are either front or back
+// facing for the given eye position. Only then, the cluster can not
+// contain any part of a contour.
+bool may_contain_contour(const mesh_cluster& cluster, vec3 eye) noexcept;
+
+// Faces adjacent to every vertex in compressed sparse row format
+struct vertex_face_adjacency {
+  vertex_face_adjacency() = default;
+  explicit vertex_face_adjacency(const mesh_geometry& mesh);
+  // Only the given faces are adjacent to the vertices.
+  vertex_face_adjacency(const mesh_geometry& mesh,
+                        std::span<const uint32_t> faces);
+  auto faces(size_t vertex) const noexcept -> std::span<const uint32_t> {
+    return {&face_indices[offsets[vertex]],
+            &face_indices[0] + offsets[vertex + 1]};
+  }
+  vector<uint32_t> offsets{};
+  vector<uint32_t> face_indices{};
+};
+
+// Faces and vertices that are processed by the illumination passes.
+// The vertices of the selected clusters are extended by 'rings' rings
+// of neighbors. Every derivative of the illumination at a vertex reads
+// its neighbors. So chained derivatives need one ring per derivative to
+// be correct at the vertices of the clusters. Vertices are sorted by
+// their ring and the faces are the ones adjacent to all inner rings.
+struct mesh_selection {
+  void assign(const mesh_geometry& mesh,
+              const vector<mesh_cluster>& clusters,
+              std::span<const uint32_t> cluster_indices,
+              const vertex_face_adjacency& adjacency,
+              size_t rings);
+
+  // Number of vertices in the rings up to and including 'ring'.
+  // Ring zero consists of the vertices of the clusters.
+  auto ring_end(size_t ring) const noexcept -> size_t {
+    return ring_ends[std::min(ring, ring_ends.size() - 1)];
+  }
+
+  vector<uint32_t> faces{};
+  vector<uint32_t> vertices{};
+  vector<size_t> ring_ends{};
+  // Marks used during construction to avoid duplicates
+  vector<bool> face_marks{};
+  vector<bool> vertex_marks{};
+};
@@ -0,0 +1,156 @@
+#include "mesh_deformation.hpp"
+//
+#include <algorithm>
+//
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace {
+
+constexpr auto mix(uint64_t x) noexcept -> uint64_t {
+  // SplitMix64 finalizer
+  x ^= x >> 30;
+  x *= 0xbf58476d1ce4e5b9;
+  x ^= x >> 27;
+  x *= 0x94d049bb133111eb;
+  x ^= x >> 31;
+  return x;
+}
+
+}  // namespace
+
+auto mesh_deformation::apply(std::span<const vec3> positions,
+                             mesh_geometry& mesh,
+                             vector<gradient_info>& gradient_data,
+                             vertex_face_adjacency& adjacency,
+                             vector<illumination_info>& illumination_data,
+                             std::span<mesh_cluster> all_clusters)
+    -> statistics {
+  if (positions.size() != mesh.vertices.size())
+    throw runtime_error("Deformation does not provide all vertex positions.");
+  statistics stats{};
+  vertices.clear();
+  faces.clear();
+  clusters.clear();
+  face_marks.resize(mesh.faces.size());
+  vertex_marks.resize(mesh.vertices.size());
+  cluster_marks.resize(all_clusters.size());
+  if (topology.offsets.size() != mesh.vertices.size() + 1)
+    topology = vertex_face_adjacency{mesh};
+
+  // Every block collects its moved vertices on its own.
+  // Concatenating the blocks keeps them in ascending order.
+  vector<vector<uint32_t>> moved(thread_count());
+  parallel_for_blocks(size_t{0}, positions.size(), moved.size(),
+                      [&](size_t first, size_t last, size_t block) {
+                        for (auto i = first; i < last; ++i) {
+                          if (mesh.vertices[i].position == positions[i])
+                            continue;
+                          mesh.vertices[i].position = positions[i];
+                          moved[block].push_back(i);
+                        }
+                      });
+
+  // Marks are only set for the touched elements and reset at the end.
+  // So their cost is proportional to the moved part of the mesh.
+  for (const auto& block : moved) {
+    stats.moved_vertices += block.size();
+    for (auto i : block)
+      for (auto f : topology.faces(i)) {
+        if (face_marks[f]) continue;
+        face_marks[f] = true;
+        faces.push_back(f);
+      }
+  }
+  for (auto f : faces)
+    for (auto i : mesh.faces[f]) {
+      if (vertex_marks[i]) continue;
+      vertex_marks[i] = true;
+      vertices.push_back(i);
+    }
+  sort(begin(faces), end(faces));
+  sort(begin(vertices), end(vertices));
+
+  // Normals are gathered like in 'compute_vertex_normals'.
+  parallel_for(size_t{0}, vertices.size(), [&](size_t k) {
+    const auto i = vertices[k];
+    vec3 normal{};
+    for (auto f : topology.faces(i)) {
+      const auto& face = mesh.faces[f];
+      const auto j = (face[0] == i) ? 0 : ((face[1] == i) ? 1 : 2);
+      normal += corner_normal(mesh.vertices[i].position,
+                              mesh.vertices[face[(j + 1) % 3]].position,
+                              mesh.vertices[face[(j + 2) % 3]].position);
+    }
+    mesh.vertices[i].normal = normalize(normal);
+  });
+  // Degenerate faces get zero area.
+  vector<bool> was_regular(faces.size());
+  for (size_t k = 0; k < faces.size(); ++k)
+    was_regular[k] = gradient_data[faces[k]].area > 0;
+  compute_voronoi_weights(mesh, faces, gradient_data);
+  for (size_t k = 0; k < faces.size(); ++k)
+    if (was_regular[k] != (gradient_data[faces[k]].area > 0))
+      ++stats.reclassified_faces;
+  if (stats.reclassified_faces) {
+    vector<uint32_t> regular{};
+    regular.reserve(mesh.faces.size());
+    for (uint32_t f = 0; f < mesh.faces.size(); ++f)
+      if (gradient_data[f].area > 0) regular.push_back(f);
+    adjacency = vertex_face_adjacency{mesh, regular};
+  }
+  compute_vertex_voronoi_area(mesh, gradient_data, adjacency, vertices,
+                              illumination_data);
+  update_vertex_tangent_system(mesh, vertices, illumination_data);
+
+  // Clusters are consecutive ranges of faces sorted by their first face.
+  if (!all_clusters.empty()) {
+    for (auto i : vertices)
+      for (auto f : topology.faces(i)) {
+        const auto c =
+            upper_bound(begin(all_clusters), end(all_clusters), f,
+                        [](uint32_t face, const mesh_cluster& cluster) {
+                          return face < cluster.first_face;
+                        }) -
+            begin(all_clusters) - 1;
+        if (cluster_marks[c]) continue;
+        cluster_marks[c] = true;
+        clusters.push_back(c);
+      }
+    sort(begin(clusters), end(clusters));
+    parallel_for(
+        size_t{0}, clusters.size(),
+        [&](size_t k) { fit_mesh_cluster(mesh, all_clusters[clusters[k]]); },
+        16);
+  }
+
+  for (auto f : faces) face_marks[f] = false;
+  for (auto i : vertices) vertex_marks[i] = false;
+  for (auto c : clusters) cluster_marks[c] = false;
+
+  stats.updated_vertices = vertices.size();
+  stats.updated_faces = faces.size();
+  stats.updated_clusters = clusters.size();
+  return stats;
+}
+
+auto topology_hash(const mesh_geometry& mesh) noexcept -> uint64_t {
+  // The sum does not depend on the order of the faces.
+  uint64_t result = mix(mesh.vertices.size());
+  for (const auto& f : mesh.faces)
+    result += mix((uint64_t(f[0]) << 42) ^ (uint64_t(f[1]) << 21) ^ f[2]);
+  return result;
+}
+
+void add_animation_frame(const mesh_geometry& mesh,
+                         uint64_t topology,
+                         mesh_animation& animation) {
+  if (!animation.vertex_count) animation.vertex_count = mesh.vertices.size();
+  if ((mesh.vertices.size() != animation.vertex_count) ||
+      (topology_hash(mesh) != topology))
+    throw runtime_error(
+        "Animation frame does not share the topology of the mesh.");
+  for (const auto& v : mesh.vertices)
+    animation.positions.push_back(v.position);
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include "mesh_clusters.hpp"
+#include "model.hpp"
+#include "photic_extremum_lines.hpp"
+#include "utility.hpp"
+
+// Incremental update of the prepared data of a mesh whose vertices move
+// while its topology stays the same, like the frames of an animation
+// or a simulation. Only faces with a moved vertex get new Voronoi weights.
+// Normals, Voronoi areas and tangent systems depend on the whole one-ring.
+// So they are recomputed for all vertices of these faces.
+// The cost of an update is proportional to the moved part of the mesh
+// apart from one parallel comparison of all positions.
+//
+// Moved faces are classified as degenerate or regular again. If any of
+// them changes its class, the adjacency of regular faces is rebuilt.
+// This takes linear time but only happens for such frames.
+struct mesh_deformation {
+  struct statistics {
+    size_t moved_vertices{};
+    size_t updated_vertices{};
+    size_t updated_faces{};
+    size_t updated_clusters{};
+    size_t reclassified_faces{};
+  };
+
+  // Moves the vertices to the given positions, one for every vertex.
+  // The adjacency must only contain the regular faces of the mesh,
+  // as given by 'gradient_adjacency'. It is updated if needed.
+  // Given clusters are refitted if one of their vertices changed.
+  // A deformation must only be applied to one mesh because the
+  // first call keeps the adjacency of all its faces.
+  auto apply(std::span<const vec3> positions,
+             mesh_geometry& mesh,
+             vector<gradient_info>& gradient_data,
+             vertex_face_adjacency& adjacency,
+             vector<illumination_info>& illumination_data,
+             std::span<mesh_cluster> all_clusters = {}) -> statistics;
+
+  // Updated elements of the last call in ascending order
+  vector<uint32_t> vertices{};
+  vector<uint32_t> faces{};
+  vector<uint32_t> clusters{};
+  // Faces adjacent to every vertex including degenerate ones
+  // such that moved faces are found regardless of their class
+  vertex_face_adjacency topology{};
+  // Marks used during construction to avoid duplicates
+  vector<bool> face_marks{};
+  vector<bool> vertex_marks{};
+  vector<bool> cluster_marks{};
+};
+
+// Vertex positions of all frames of an animation with fixed topology
+// Positions of frame 'k' start at index 'k * vertex_count'.
+struct mesh_animation {
+  auto frame_count() const noexcept -> size_t {
+    return vertex_count ? positions.size() / vertex_count : 0;
+  }
+  auto frame(size_t k) const noexcept -> std::span<const vec3> {
+    return {&positions[k * vertex_count], vertex_count};
+  }
+
+  size_t vertex_count{};
+  vector<vec3> positions{};
+};
+
+// Order-independent hash of the faces of a mesh
+// such that reordered faces still describe the same topology.
+auto topology_hash(const mesh_geometry& mesh) noexcept -> uint64_t;
+
+// Appends the vertex positions of the given mesh as a new frame.
+// Throws if the mesh does not share the topology given by the hash.
+void add_animation_frame(const mesh_geometry& mesh,
+                         uint64_t topology,
+                         mesh_animation& animation);
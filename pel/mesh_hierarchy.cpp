@@ -0,0 +1,236 @@
+#include "mesh_hierarchy.hpp"
+//
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace {
+
+// Symmetric matrix and vector of the quadric error
+// q(x) = x^T A x + 2 b^T x + c of a set of weighted planes.
+struct quadric {
+  float a[6]{};  // xx, xy, xz, yy, yz, zz
+  vec3 b{};
+  float weight{};
+  vec3 centroid{};  // weighted sum of positions
+
+  void add_plane(vec3 n, float d, float w) noexcept {
+    a[0] += w * n.x * n.x;
+    a[1] += w * n.x * n.y;
+    a[2] += w * n.x * n.z;
+    a[3] += w * n.y * n.y;
+    a[4] += w * n.y * n.z;
+    a[5] += w * n.z * n.z;
+    b += w * d * n;
+  }
+
+  // Returns the position with minimal error. Flat and sharp-edged
+  // clusters lead to singular matrices. So the solution is pulled
+  // towards the centroid by a small regularization term.
+  auto minimizer() const noexcept -> vec3 {
+    const auto c = centroid / weight;
+    const auto trace = a[0] + a[3] + a[5];
+    const auto eps = 1e-3f * trace + 1e-12f;
+    const float m[3][3] = {{a[0] + eps, a[1], a[2]},
+                           {a[1], a[3] + eps, a[4]},
+                           {a[2], a[4], a[5] + eps}};
+    const auto r = eps * c - b;
+    const auto det = [](const float (&m)[3][3]) {
+      return m[0][0] * (m[1][1] * m[2][2] - m[1][2] * m[2][1]) -
+             m[0][1] * (m[1][0] * m[2][2] - m[1][2] * m[2][0]) +
+             m[0][2] * (m[1][0] * m[2][1] - m[1][1] * m[2][0]);
+    };
+    const auto d = det(m);
+    if (!(std::abs(d) > 0)) return c;
+    // Cramer's rule
+    vec3 x;
+    for (int i = 0; i < 3; ++i) {
+      float mi[3][3];
+      for (int j = 0; j < 3; ++j)
+        for (int k = 0; k < 3; ++k) mi[j][k] = (k == i) ? r[j] : m[j][k];
+      x[i] = det(mi) / d;
+    }
+    return x;
+  }
+};
+
+void add(quadric& x, const quadric& y) noexcept {
+  for (int j = 0; j < 6; ++j) x.a[j] += y.a[j];
+  x.b += y.b;
+  x.weight += y.weight;
+  x.centroid += y.centroid;
+}
+
+// Vertices of the level that is going to be clustered
+// together with the accumulated quadrics of their original vertices.
+struct cluster_source {
+  const mesh_geometry* geometry{};
+  vector<quadric> quadrics{};
+};
+
+struct cluster_result {
+  mesh_level level{};
+  vector<quadric> quadrics{};
+  vector<uint32_t> map{};  // source vertex to cluster
+};
+
+auto cluster(const cluster_source& source, vec3 aabb_min, float cell_size)
+    -> cluster_result {
+  const auto& mesh = *source.geometry;
+  cluster_result result{};
+  result.map.resize(mesh.vertices.size());
+
+  // Assign every vertex to the cluster of its grid cell.
+  // Every coordinate of a cell gets 21 bits of the key. Positions outside
+  // of the bounding box and non-finite ones are clamped to the grid
+  // because converting negative values to unsigned integers is undefined.
+  const auto coordinate = [](float x) -> uint64_t {
+    constexpr auto max = float((1 << 21) - 1);
+    return (x > 0) ? uint64_t(std::min(x, max)) : 0;
+  };
+  unordered_map<uint64_t, uint32_t> cells{};
+  cells.reserve(mesh.vertices.size() / 2);
+  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+    const auto p = (mesh.vertices[i].position - aabb_min) / cell_size;
+    const auto key = (coordinate(p.x) << 42) | (coordinate(p.y) << 21) |
+                     coordinate(p.z);
+    const auto [it, inserted] = cells.emplace(key, result.quadrics.size());
+    if (inserted) result.quadrics.push_back({});
+    result.map[i] = it->second;
+    add(result.quadrics[it->second], source.quadrics[i]);
+  }
+
+  auto& geometry = result.level.geometry;
+  geometry.vertices.resize(result.quadrics.size());
+  for (size_t i = 0; i < result.quadrics.size(); ++i)
+    geometry.vertices[i].position = result.quadrics[i].minimizer();
+
+  // Faces whose vertices fall into less than three clusters vanish.
+  // Rotating the smallest index to the front keeps the orientation
+  // and allows to remove duplicates by sorting.
+  auto& faces = geometry.faces;
+  for (const auto& f : mesh.faces) {
+    mesh_geometry::face c{result.map[f[0]], result.map[f[1]],
+                          result.map[f[2]]};
+    if ((c[0] == c[1]) || (c[1] == c[2]) || (c[2] == c[0])) continue;
+    while ((c[0] > c[1]) || (c[0] > c[2])) c = {c[1], c[2], c[0]};
+    faces.push_back(c);
+  }
+  sort(begin(faces), end(faces));
+  faces.erase(unique(begin(faces), end(faces)), end(faces));
+
+  compute_vertex_normals(geometry);
+
+  // Clusters whose faces all vanished are still part of the vertex map.
+  // They take the mean normal of their source vertices such that
+  // their illumination data stays finite.
+  vector<vec3> normals(geometry.vertices.size());
+  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+    const auto& n = mesh.vertices[i].normal;
+    if (std::isfinite(n.x)) normals[result.map[i]] += n;
+  }
+  for (size_t i = 0; i < geometry.vertices.size(); ++i) {
+    auto& n = geometry.vertices[i].normal;
+    if (std::isfinite(n.x)) continue;
+    n = (length(normals[i]) > 0) ? normalize(normals[i]) : vec3{0, 0, 1};
+  }
+  return result;
+}
+
+}  // namespace
+
+auto build_mesh_hierarchy(const mesh_geometry& mesh, size_t min_faces)
+    -> vector<mesh_level> {
+  vector<mesh_level> levels{};
+  if (mesh.faces.size() < 2 * min_faces) return levels;
+
+  // Every vertex accumulates the area-weighted planes of its faces.
+  cluster_source source{&mesh, vector<quadric>(mesh.vertices.size())};
+  vec3 aabb_min = mesh.vertices[0].position;
+  vec3 aabb_max = mesh.vertices[0].position;
+  for (const auto& v : mesh.vertices) {
+    aabb_min = min(aabb_min, v.position);
+    aabb_max = max(aabb_max, v.position);
+  }
+  for (const auto& f : mesh.faces) {
+    const auto& x = mesh.vertices[f[0]].position;
+    const auto& y = mesh.vertices[f[1]].position;
+    const auto& z = mesh.vertices[f[2]].position;
+    const auto n = cross(y - x, z - x);
+    const auto area = length(n) / 2;
+    if (!(area > 0)) continue;
+    const auto normal = n / (2 * area);
+    for (auto i : f) {
+      auto& q = source.quadrics[i];
+      q.add_plane(normal, -dot(normal, x), area);
+      q.weight += area;
+      q.centroid += area * mesh.vertices[i].position;
+    }
+  }
+  // Isolated vertices and those of degenerate faces only use their position.
+  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+    auto& q = source.quadrics[i];
+    if (q.weight > 0) continue;
+    q.weight = 1;
+    q.centroid = mesh.vertices[i].position;
+  }
+
+  // On surfaces, the number of occupied cells grows quadratically with
+  // the grid resolution. Every level is clustered from the previous one
+  // and its vertex map is given by the composition of both maps.
+  const auto extent = std::max({aabb_max.x - aabb_min.x,
+                                aabb_max.y - aabb_min.y,
+                                aabb_max.z - aabb_min.z, 1e-20f});
+  auto resolution = std::sqrt(float(mesh.vertices.size())) / 2;
+  auto faces = mesh.faces.size();
+  // The source references the last level. So it must not be reallocated.
+  constexpr size_t max_levels = 8;
+  levels.reserve(max_levels);
+  while ((levels.size() < max_levels) && (faces >= 2 * min_faces) &&
+         (resolution >= 4)) {
+    resolution = std::min(resolution, float(1 << 20));
+    auto result = cluster(source, aabb_min, extent / resolution);
+    resolution /= 2;
+    // Only keep levels that considerably reduce the face count.
+    auto& level = result.level;
+    if (3 * level.geometry.faces.size() > 2 * faces) continue;
+    faces = level.geometry.faces.size();
+
+    if (levels.empty())
+      level.vertex_map = std::move(result.map);
+    else {
+      level.vertex_map = levels.back().vertex_map;
+      for (auto& i : level.vertex_map) i = result.map[i];
+    }
+
+    level.illumination_data.resize(level.geometry.vertices.size());
+    level.gradient_data.resize(level.geometry.faces.size());
+    level.adjacency = gradient_adjacency(level.geometry);
+    compute_voronoi_weights(level.geometry, level.gradient_data);
+    compute_vertex_voronoi_area(level.geometry, level.gradient_data,
+                                level.adjacency, level.illumination_data);
+    compute_vertex_tangent_system(level.geometry, level.gradient_data,
+                                  level.illumination_data);
+    levels.push_back(std::move(level));
+    source = {&levels.back().geometry, std::move(result.quadrics)};
+  }
+  return levels;
+}
+
+void prolong_illumination(const vector<uint32_t>& vertex_map,
+                          const vector<illumination_info>& coarse,
+                          vector<illumination_info>& fine) {
+  parallel_for(size_t{0}, vertex_map.size(), [&](size_t i) {
+    const auto& x = coarse[vertex_map[i]];
+    auto& y = fine[i];
+    y.light = x.light;
+    y.light_variation = x.light_variation;
+    y.light_variation_slope = x.light_variation_slope;
+    y.light_variation_curve = x.light_variation_curve;
+    // Vanishing gradients stay zero.
+    const auto g = x.light_gradient.x * x.u + x.light_gradient.y * x.v;
+    const vec2 gradient{dot(g, y.u), dot(g, y.v)};
+    const auto norm = length(gradient);
+    y.light_gradient = (norm > 0) ? gradient / norm : vec2{};
+  });
+}
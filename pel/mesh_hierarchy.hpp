@@ -0,0 +1,35 @@
+#pragma once
+#include "model.hpp"
+#include "photic_extremum_lines.hpp"
+#include "utility.hpp"
+
+// Coarse approximation of a mesh that is prepared
+// for the computation of its illumination data.
+struct mesh_level {
+  mesh_geometry geometry{};
+  vector<gradient_info> gradient_data{};
+  vector<illumination_info> illumination_data{};
+  vertex_face_adjacency adjacency{};
+  // Maps every vertex of the original mesh to its vertex on this level.
+  vector<uint32_t> vertex_map{};
+};
+
+// Builds successively coarser levels of the given mesh until
+// a level has less than 'min_faces' faces. The original mesh itself
+// is not part of the hierarchy. Levels are sorted from fine to coarse.
+//
+// Every level is built by vertex clustering on a uniform grid.
+// The position of each cluster minimizes the quadric error of all
+// planes of its faces. In contrast to iterative edge collapses,
+// this takes linear time and directly provides the vertex map.
+auto build_mesh_hierarchy(const mesh_geometry& mesh, size_t min_faces = 1 << 14)
+    -> vector<mesh_level>;
+
+// Transfers the illumination data of a level to the original mesh
+// through the vertex map of the level. Every original vertex takes
+// the values of its cluster. The light gradient is expressed
+// in the tangent system of the original vertex. Voronoi areas
+// and tangent systems of the original mesh are kept.
+void prolong_illumination(const vector<uint32_t>& vertex_map,
+                          const vector<illumination_info>& coarse,
+                          vector<illumination_info>& fine);
@@ -4,7 +4,10 @@
 #include "utility.hpp"
 #include "vertex_array.hpp"
 
-struct model {
+// CPU-side geometry of a triangle mesh.
+// It does not own any OpenGL objects and can therefore
+// be built by threads that have no current OpenGL context.
+struct mesh_geometry {
   struct vertex {
     vec3 position;
     vec3 normal;
@@ -12,6 +15,60 @@ struct model {
 
   using face = array<uint32_t, 3>;
 
+  vector<vertex> vertices{};
+  vector<face> faces{};
+};
+
+// Normal contribution of a triangle to its corner 'x'.
+// The cross product is weighted by the inverse squared lengths
+// of the adjacent edges such that small triangles count more.
+inline auto corner_normal(const vec3& x, const vec3& y, const vec3& z) -> vec3 {
+  const auto p = y - x;
+  const auto q = z - x;
+  const auto p2 = dot(p, p);
+  const auto q2 = dot(q, q);
+  // Corners of collapsed edges would contribute NaN.
+  if (!(p2 > 0) || !(q2 > 0)) return vec3{0.0f};
+  return cross(p, q) / p2 / q2;
+}
+
+// Computes vertex normals for meshes that already provide shared vertices.
+inline void compute_vertex_normals(mesh_geometry& mesh) {
+  for (auto& v : mesh.vertices) v.normal = {};
+  for (const auto& f : mesh.faces) {
+    for (size_t j = 0; j < 3; ++j) {
+      mesh.vertices[f[j]].normal += corner_normal(
+          mesh.vertices[f[j]].position, mesh.vertices[f[(j + 1) % 3]].position,
+          mesh.vertices[f[(j + 2) % 3]].position);
+    }
+  }
+  for (auto& v : mesh.vertices) v.normal = normalize(v.normal);
+}
+
+struct model : mesh_geometry {
+  // Ranges of faces that are drawn by one multi-draw call.
+  // Adjacent ranges are merged to keep the number of draws small.
+  struct face_ranges {
+    void clear() {
+      counts.clear();
+      offsets.clear();
+    }
+    void add(size_t first, size_t count) {
+      const auto offset = first * sizeof(face);
+      if (!counts.empty() &&
+          (size_t(offsets.back()) + counts.back() * sizeof(uint32_t) ==
+           offset)) {
+        counts.back() += 3 * count;
+        return;
+      }
+      counts.push_back(3 * count);
+      offsets.push_back(reinterpret_cast<const void*>(offset));
+    }
+
+    vector<GLsizei> counts{};
+    vector<const void*> offsets{};
+  };
+
   void setup(const shader_program& shader) {
     // Use a vertex array to be able to reference the vertex buffer and
     // the vertex attribute arrays of the triangle with one single variable.
@@ -40,20 +97,48 @@ struct model {
     }
   }
 
-  void update() {
+  // Deforming meshes pass GL_DYNAMIC_DRAW because their vertices
+  // are rewritten by 'update_vertices' in every frame of an animation.
+  void update(GLenum vertex_usage = GL_STATIC_DRAW) {
     // Generate and bind the buffer which shall contain the triangle data.
     // glGenBuffers(1, &vertex_data);
     // glBindBuffer(GL_ARRAY_BUFFER, vertex_data);
     vertex_data.bind();
-    // The data is not changing rapidly. Therefore we use GL_STATIC_DRAW.
-    glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(vertices[0]),
-                 vertices.data(), GL_STATIC_DRAW);
+    // Usually, the data is not changing rapidly.
+    // Therefore GL_STATIC_DRAW is the default.
+    vertex_data.allocate(vertices.size() * sizeof(vertices[0]),
+                         vertices.data(), vertex_usage);
 
     // glGenBuffers(1, &face_data);
     // glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, face_data);
     face_data.bind();
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, faces.size() * sizeof(faces[0]),
-                 faces.data(), GL_STATIC_DRAW);
+    face_data.allocate(faces.size() * sizeof(faces[0]), faces.data(),
+                       GL_STATIC_DRAW);
+  }
+
+  // Uploads only the given vertices which must be sorted.
+  // Vertices with small gaps between them are uploaded as one range
+  // to keep the number of calls small. If most vertices changed,
+  // the whole buffer is uploaded at once.
+  void update_vertices(std::span<const uint32_t> indices) {
+    if (indices.empty()) return;
+    vertex_data.bind();
+    if (4 * indices.size() > vertices.size()) {
+      glBufferSubData(GL_ARRAY_BUFFER, 0, vertices.size() * sizeof(vertices[0]),
+                      vertices.data());
+      return;
+    }
+    constexpr uint32_t max_gap = 64;
+    for (size_t i = 0; i < indices.size();) {
+      auto j = i + 1;
+      while ((j < indices.size()) && (indices[j] - indices[j - 1] <= max_gap))
+        ++j;
+      const auto first = indices[i];
+      const auto count = indices[j - 1] - first + 1;
+      glBufferSubData(GL_ARRAY_BUFFER, first * sizeof(vertices[0]),
+                      count * sizeof(vertices[0]), &vertices[first]);
+      i = j;
+    }
   }
 
   void render() {
@@ -63,8 +148,12 @@ struct model {
     glDrawElements(GL_TRIANGLES, 3 * faces.size(), GL_UNSIGNED_INT, 0);
   }
 
-  vector<vertex> vertices{};
-  vector<face> faces{};
+  void render(const face_ranges& ranges) {
+    if (ranges.counts.empty()) return;
+    handle.bind();
+    glMultiDrawElements(GL_TRIANGLES, ranges.counts.data(), GL_UNSIGNED_INT,
+                        ranges.offsets.data(), ranges.counts.size());
+  }
 
   // GLuint handle;
   // GLuint vertex_data;
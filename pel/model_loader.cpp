@@ -0,0 +1,290 @@
+#include "model_loader.hpp"
+//
+#include <cctype>
+#include <filesystem>
+#include <optional>
+//
+#include "memory_usage.hpp"
+#include "obj_loader.hpp"
+#include "ply_loader.hpp"
+#include "stl_ascii_loader.hpp"
+#include "stl_loader.hpp"
+#include "task_scheduler.hpp"
+
+namespace {
+
+auto lowercase_extension(czstring file_path) -> string {
+  auto extension = std::filesystem::path{file_path}.extension().string();
+  for (auto& c : extension) c = std::tolower(static_cast<unsigned char>(c));
+  return extension;
+}
+
+bool is_binary_stl(czstring file_path) {
+  const auto extension = lowercase_extension(file_path);
+  return (extension != ".obj") && (extension != ".ply") &&
+         !is_ascii_stl(file_path);
+}
+
+}  // namespace
+
+void load_mesh_file(czstring file_path,
+                    mesh_geometry& mesh,
+                    const std::function<void(float)>& progress) {
+  if (is_binary_stl(file_path)) {
+    std::optional<mesh_welder> welder{};
+    size_t welded = 0;
+    stl_binary_format::read(
+        file_path,
+        [&](std::span<const stl_binary_format::triangle> chunk, size_t total) {
+          if (!welder) welder.emplace(mesh, total);
+          welder->add(chunk);
+          welded += chunk.size();
+          if (progress) progress(float(welded) / total);
+        });
+    if (welder) welder->finish();
+    return;
+  }
+  const auto extension = lowercase_extension(file_path);
+  if (extension == ".obj")
+    load_obj(file_path, mesh);
+  else if (extension == ".ply")
+    load_ply(file_path, mesh);
+  else
+    load_stl_ascii(file_path, mesh, progress);
+}
+
+void load_mesh_data(czstring file_path,
+                    std::string_view content,
+                    mesh_geometry& mesh) {
+  const auto extension = lowercase_extension(file_path);
+  if (extension == ".obj")
+    load_obj(content, mesh);
+  else if (extension == ".ply")
+    load_ply(content, mesh);
+  else if (is_ascii_stl(content))
+    load_stl_ascii(content, mesh);
+  else {
+    std::optional<mesh_welder> welder{};
+    stl_binary_format::parse(
+        content,
+        [&](std::span<const stl_binary_format::triangle> chunk, size_t total) {
+          if (!welder) welder.emplace(mesh, total);
+          welder->add(chunk);
+        });
+    if (welder) welder->finish();
+  }
+}
+
+void model_loader::start(czstring file_path, vector<string> frame_paths) {
+  if (thread.joinable()) {
+    thread.request_stop();
+    thread.join();
+  }
+  preview.clear();
+  preview_fetched = 0;
+  data = {};
+  error = nullptr;
+  finished = false;
+  thread = std::jthread{
+      [this](std::stop_token stop, string path, vector<string> frame_paths) {
+        run(stop, std::move(path), std::move(frame_paths));
+      },
+      string{file_path}, std::move(frame_paths)};
+}
+
+bool model_loader::fetch_preview(vector<model::vertex>& vertices) {
+  std::scoped_lock lock{preview_mutex};
+  if (preview_fetched == preview.size()) return false;
+  vertices.insert(end(vertices), begin(preview) + preview_fetched,
+                  end(preview));
+  preview_fetched = preview.size();
+  return true;
+}
+
+auto model_loader::take() -> result {
+  finished = false;
+  set_stage("idle");
+  if (error) std::rethrow_exception(std::exchange(error, nullptr));
+  return std::move(data);
+}
+
+void model_loader::set_stage(czstring name) noexcept {
+  stage_progress = 0;
+  stage_name = name;
+}
+
+void model_loader::load_stl_binary(std::stop_token stop, czstring path) {
+  // The triangles are welded into the mesh right after they have been read.
+  // The soup is never stored as a whole. So the peak memory
+  // is given by the size of the mesh, the welding index and one chunk.
+  std::optional<mesh_welder> welder{};
+  size_t read = 0;
+  stl_binary_format::read(
+      path,
+      [&](std::span<const stl_binary_format::triangle> chunk, size_t total) {
+        if (stop.stop_requested())
+          throw runtime_error("Loading of STL file was cancelled.");
+        if (!welder) welder.emplace(data.geometry, total);
+        welder->add(chunk);
+
+        // Only every 'preview_stride'-th triangle of the soup is shown.
+        // Its normal is given by the cross product of its edges
+        // because the stored normals of STL files are often unreliable.
+        const auto preview_stride = std::max<size_t>(1, total / preview_size);
+        std::scoped_lock lock{preview_mutex};
+        for (size_t i = (preview_stride - read % preview_stride) %
+                        preview_stride;
+             i < chunk.size(); i += preview_stride) {
+          const auto& v = chunk[i].vertex;
+          const auto n = normalize(cross(v[1] - v[0], v[2] - v[0]));
+          for (size_t j = 0; j < 3; ++j) preview.push_back({v[j], n});
+        }
+        read += chunk.size();
+        stage_progress = float(read) / total;
+      });
+  if (welder) welder->finish();
+}
+
+void model_loader::load_animation(std::stop_token stop,
+                                  const vector<string>& frame_paths) {
+  // Faces have been reordered but vertices keep their indices.
+  const auto topology = topology_hash(data.geometry);
+  add_animation_frame(data.geometry, topology, data.animation);
+  for (size_t i = 0; i < frame_paths.size(); ++i) {
+    if (stop.stop_requested()) return;
+    mesh_geometry frame{};
+    load_mesh_file(frame_paths[i].c_str(), frame);
+    add_animation_frame(frame, topology, data.animation);
+    stage_progress = float(i + 1) / frame_paths.size();
+  }
+}
+
+void model_loader::run(std::stop_token stop,
+                       string path,
+                       vector<string> frame_paths) try {
+  set_stage("loading");
+  set_memory_stage("loading");
+  reset_peak_memory_usage();
+  auto start = system_clock::now();
+  // Only binary STL files are read in a way that provides a preview.
+  if (is_binary_stl(path.c_str()))
+    load_stl_binary(stop, path.c_str());
+  else
+    load_mesh_file(path.c_str(), data.geometry,
+                   [this](float progress) { stage_progress = progress; });
+  auto end = system_clock::now();
+  auto time = duration<float>(end - start).count();
+  auto memory = process_memory_usage();
+  const auto mesh_size =
+      data.geometry.vertices.capacity() * sizeof(mesh_geometry::vertex) +
+      data.geometry.faces.capacity() * sizeof(mesh_geometry::face);
+  cout << "mesh file:\n"
+       << "load time = " << time << " s" << '\n'
+       << "vertices = " << data.geometry.vertices.size() << '\n'
+       << "faces = " << data.geometry.faces.size() << '\n'
+       << "mesh size = " << mebibytes(mesh_size) << " MiB" << '\n'
+       << "peak memory = " << mebibytes(memory.peak) << " MiB" << '\n'
+       << endl;
+
+  if (stop.stop_requested()) return;
+  set_stage("preparing");
+  set_memory_stage("preparing");
+  reset_peak_memory_usage();
+  start = system_clock::now();
+  // Reordering the faces must happen before any per-face data exists.
+  {
+    memory_stage stage{"clusters"};
+    data.clusters = build_mesh_clusters(data.geometry);
+  }
+  {
+    memory_stage stage{"illumination data"};
+    data.illumination_data.resize(data.geometry.vertices.size());
+  }
+  {
+    memory_stage stage{"gradient data"};
+    data.gradient_data.resize(data.geometry.faces.size());
+  }
+  // Independent parts of the preparation run concurrently.
+  {
+    task_graph graph{};
+    const auto adjacency = graph.add([&] {
+      memory_stage stage{"adjacency"};
+      data.adjacency = gradient_adjacency(data.geometry);
+    });
+    graph.add([&] {
+      memory_stage stage{"contour hierarchy"};
+      data.contours = contour_hierarchy{data.clusters};
+    });
+    const auto weights = graph.add(
+        [&] { compute_voronoi_weights(data.geometry, data.gradient_data); });
+    graph.add(
+        [&] {
+          compute_vertex_voronoi_area(data.geometry, data.gradient_data,
+                                      data.adjacency, data.illumination_data);
+        },
+        {adjacency, weights});
+    graph.add([&] {
+      compute_vertex_tangent_system(data.geometry, data.gradient_data,
+                                    data.illumination_data);
+    });
+    graph.run();
+  }
+  stage_progress = 1;
+  end = system_clock::now();
+  time = duration<float>(end - start).count();
+  memory = process_memory_usage();
+  cout << "mesh preparation:\n"
+       << "time = " << time << " s" << '\n'
+       << "clusters = " << data.clusters.size() << '\n'
+       << "degenerate faces = "
+       << dropped_face_count(data.geometry, data.adjacency) << '\n'
+       << "peak memory = " << mebibytes(memory.peak) << " MiB" << '\n'
+       << endl;
+
+  if (!frame_paths.empty()) {
+    if (stop.stop_requested()) return;
+    set_stage("loading frames");
+    set_memory_stage("loading frames");
+    reset_peak_memory_usage();
+    start = system_clock::now();
+    load_animation(stop, frame_paths);
+    if (stop.stop_requested()) return;
+    end = system_clock::now();
+    time = duration<float>(end - start).count();
+    memory = process_memory_usage();
+    cout << "animation:\n"
+         << "load time = " << time << " s" << '\n'
+         << "frames = " << data.animation.frame_count() << '\n'
+         << "peak memory = " << mebibytes(memory.peak) << " MiB" << '\n'
+         << endl;
+    print_memory_report(cout);
+    cout << endl;
+    finished = true;
+    return;
+  }
+
+  if (stop.stop_requested()) return;
+  set_stage("simplifying");
+  set_memory_stage("simplifying");
+  reset_peak_memory_usage();
+  start = system_clock::now();
+  data.levels = build_mesh_hierarchy(data.geometry);
+  end = system_clock::now();
+  time = duration<float>(end - start).count();
+  memory = process_memory_usage();
+  cout << "mesh hierarchy:\n"
+       << "time = " << time << " s" << '\n'
+       << "levels = " << data.levels.size() << '\n';
+  for (const auto& level : data.levels)
+    cout << "faces = " << level.geometry.faces.size() << '\n';
+  cout << "peak memory = " << mebibytes(memory.peak) << " MiB" << '\n'
+       << endl;
+  print_memory_report(cout);
+  cout << endl;
+
+  finished = true;
+} catch (...) {
+  if (stop.stop_requested()) return;
+  error = std::current_exception();
+  finished = true;
+}
@@ -0,0 +1,101 @@
+#pragma once
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <mutex>
+#include <thread>
+//
+#include "contour_hierarchy.hpp"
+#include "mesh_clusters.hpp"
+#include "mesh_deformation.hpp"
+#include "mesh_hierarchy.hpp"
+#include "model.hpp"
+#include "photic_extremum_lines.hpp"
+#include "utility.hpp"
+
+// Loads a binary or ASCII STL, OBJ or binary PLY file without any preview.
+// For STL files, 'progress' is called with the fraction of triangles
+// that have been welded so far.
+void load_mesh_file(czstring file_path,
+                    mesh_geometry& mesh,
+                    const std::function<void(float)>& progress = {});
+
+// Parses the content of a mesh file that has already been read.
+// The path is only used to determine the format by its extension.
+void load_mesh_data(czstring file_path,
+                    std::string_view content,
+                    mesh_geometry& mesh);
+
+// Loads and prepares a model on a background thread.
+// Binary and ASCII STL, OBJ and binary PLY files are supported.
+// While a binary STL file is being read, a subsample of its triangle soup
+// is provided as a preview. It can be shown until welding and
+// preparation have finished and the complete mesh is available.
+// Further files with the same topology can be given as frames
+// of an animation. Then, coarser levels of detail are not built
+// because they could not follow the deformation at frame rate.
+class model_loader {
+ public:
+  struct result {
+    mesh_geometry geometry{};
+    vector<gradient_info> gradient_data{};
+    vector<illumination_info> illumination_data{};
+    // Clusters of the reordered faces used for culling
+    vector<mesh_cluster> clusters{};
+    vertex_face_adjacency adjacency{};
+    contour_hierarchy contours{};
+    // Coarser levels of detail
+    vector<mesh_level> levels{};
+    // The first frame is given by the mesh itself.
+    mesh_animation animation{};
+  };
+
+  // Upper bound for the number of triangles in the preview.
+  static constexpr size_t preview_size = 1 << 18;
+
+  model_loader() = default;
+
+  // Copying is not allowed.
+  model_loader(const model_loader&) = delete;
+  model_loader& operator=(const model_loader&) = delete;
+
+  // For now, moving is not allowed.
+  model_loader(model_loader&&) = delete;
+  model_loader& operator=(model_loader&&) = delete;
+
+  // Cancels the previous loading process if there is one.
+  void start(czstring file_path, vector<string> frame_paths = {});
+
+  // Name of the current stage and its progress in [0, 1].
+  auto stage() const noexcept -> czstring { return stage_name.load(); }
+  auto progress() const noexcept -> float { return stage_progress.load(); }
+
+  // Appends all preview triangles that have been read since the last call.
+  // Every three consecutive vertices form one triangle.
+  bool fetch_preview(vector<model::vertex>& vertices);
+
+  // Returns true if the prepared mesh or an error is available.
+  bool ready() const noexcept { return finished.load(); }
+  // Returns the prepared mesh or rethrows the error of the loading thread.
+  auto take() -> result;
+
+ private:
+  void run(std::stop_token stop, string path, vector<string> frame_paths);
+  void load_stl_binary(std::stop_token stop, czstring path);
+  void load_animation(std::stop_token stop,
+                      const vector<string>& frame_paths);
+  void set_stage(czstring name) noexcept;
+
+  std::atomic<czstring> stage_name{"idle"};
+  std::atomic<float> stage_progress{0};
+
+  std::mutex preview_mutex{};
+  vector<model::vertex> preview{};
+  size_t preview_fetched = 0;
+
+  result data{};
+  std::exception_ptr error{};
+  std::atomic<bool> finished{false};
+
+  std::jthread thread{};
+};
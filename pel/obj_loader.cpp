@@ -0,0 +1,145 @@
+#include "obj_loader.hpp"
+//
+#include <atomic>
+#include <exception>
+#include <limits>
+//
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "text_parser.hpp"
+
+using namespace std;
+
+namespace {
+
+// Negative indices refer to the vertices defined before the face.
+// For chunks other than the first, their number is only known after
+// all chunks have been parsed. Such corners are fixed up when merging.
+struct relative_corner {
+  size_t face;
+  size_t corner;
+  int64_t index;  // relative to the first vertex of the chunk
+};
+
+struct obj_chunk {
+  vector<vec3> positions{};
+  vector<mesh_geometry::face> faces{};
+  vector<relative_corner> relative_corners{};
+  exception_ptr error{};
+};
+
+void parse(string_view text, obj_chunk& chunk) {
+  text_parser in{text};
+  struct corner {
+    int64_t index;
+    bool relative;
+  };
+  vector<corner> polygon{};
+  while (!in.done()) {
+    const auto keyword = in.word();
+    if (keyword == "v") {
+      vec3 p;
+      if (!in.parse(p)) throw runtime_error("Failed to parse OBJ vertex.");
+      chunk.positions.push_back(p);
+    } else if (keyword == "f") {
+      polygon.clear();
+      while (!in.line_end()) {
+        int64_t index;
+        if (!in.parse(index) || (index == 0))
+          throw runtime_error("Failed to parse OBJ face.");
+        // Ignore texture coordinate and normal indices.
+        in.skip_word();
+        // Absolute indices are checked against the vertex count when
+        // merging. Larger ones would not even fit into a face.
+        if (index > int64_t(numeric_limits<uint32_t>::max()))
+          throw runtime_error("OBJ face index is out of range.");
+        if (index > 0)
+          polygon.push_back({index - 1, false});
+        else
+          polygon.push_back(
+              {int64_t(chunk.positions.size()) + index, true});
+      }
+      if (polygon.size() < 3)
+        throw runtime_error("OBJ face has less than three vertices.");
+      for (size_t i = 2; i < polygon.size(); ++i) {
+        const corner corners[] = {polygon[0], polygon[i - 1], polygon[i]};
+        mesh_geometry::face f{};
+        for (size_t j = 0; j < 3; ++j) {
+          if (corners[j].relative)
+            chunk.relative_corners.push_back(
+                {chunk.faces.size(), j, corners[j].index});
+          else
+            f[j] = uint32_t(corners[j].index);
+        }
+        chunk.faces.push_back(f);
+      }
+    }
+    in.skip_line();
+  }
+}
+
+}  // namespace
+
+void load_obj(czstring file_path, mesh_geometry& mesh) {
+  const mapped_file file{file_path};
+  load_obj(file.view(), mesh);
+}
+
+void load_obj(string_view text, mesh_geometry& mesh) {
+  const auto bounds = line_aligned_chunks(text, thread_count());
+  vector<obj_chunk> chunks(bounds.size() - 1);
+
+  parallel_for_blocks(0, chunks.size(), [&](size_t first, size_t last, auto) {
+    for (auto i = first; i < last; ++i) {
+      try {
+        parse(text.substr(bounds[i], bounds[i + 1] - bounds[i]), chunks[i]);
+      } catch (...) {
+        chunks[i].error = current_exception();
+      }
+    }
+  });
+  for (auto& chunk : chunks)
+    if (chunk.error) rethrow_exception(chunk.error);
+
+  // Merge all chunks in order.
+  vector<size_t> vertex_offsets(chunks.size() + 1);
+  vector<size_t> face_offsets(chunks.size() + 1);
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    vertex_offsets[i + 1] = vertex_offsets[i] + chunks[i].positions.size();
+    face_offsets[i + 1] = face_offsets[i] + chunks[i].faces.size();
+  }
+  const auto vertex_count = vertex_offsets.back();
+  if (vertex_count > numeric_limits<uint32_t>::max())
+    throw runtime_error("OBJ file has too many vertices.");
+  mesh.vertices.resize(vertex_count);
+  mesh.faces.resize(face_offsets.back());
+
+  std::atomic<bool> invalid_index{false};
+  parallel_for_blocks(0, chunks.size(), [&](size_t first, size_t last, auto) {
+    for (auto i = first; i < last; ++i) {
+      auto& chunk = chunks[i];
+      for (auto& [face, corner, index] : chunk.relative_corners) {
+        // Check the index before it is narrowed.
+        index += vertex_offsets[i];
+        if ((index < 0) || (index >= int64_t(vertex_count))) {
+          invalid_index = true;
+          continue;
+        }
+        chunk.faces[face][corner] = uint32_t(index);
+      }
+      for (size_t j = 0; j < chunk.positions.size(); ++j)
+        mesh.vertices[vertex_offsets[i] + j] = {chunk.positions[j], {}};
+      for (size_t j = 0; j < chunk.faces.size(); ++j) {
+        const auto& f = chunk.faces[j];
+        if ((f[0] >= vertex_count) || (f[1] >= vertex_count) ||
+            (f[2] >= vertex_count))
+          invalid_index = true;
+        mesh.faces[face_offsets[i] + j] = f;
+      }
+      chunk = {};
+    }
+  });
+  if (invalid_index) throw runtime_error("OBJ face index is out of range.");
+
+  compute_vertex_normals(mesh);
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include "model.hpp"
+#include "utility.hpp"
+
+// Loads the vertex positions and faces of a Wavefront OBJ file.
+// The file is split into chunks at line boundaries which are parsed
+// in parallel. Faces already reference shared vertices and therefore
+// no welding is needed. Polygons are triangulated as fans and
+// texture coordinates, normals and all other statements are ignored.
+void load_obj(czstring file_path, mesh_geometry& mesh);
+void load_obj(std::string_view text, mesh_geometry& mesh);
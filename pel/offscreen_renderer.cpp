@@ -0,0 +1,189 @@
+#include "offscreen_renderer.hpp"
+//
+#include "contours_shader.hpp"
+#include "flat_shader.hpp"
+#include "photic_extremum_lines.hpp"
+#include "photic_extremum_lines_shader.hpp"
+#include "png_image.hpp"
+#include "toon_shader.hpp"
+#include "vertex_light_shader.hpp"
+#include "vertex_light_variation_shader.hpp"
+#include "vertex_light_variation_slope_shader.hpp"
+#include "viewer_shader.hpp"
+#include "white_shader.hpp"
+#include "wireframe_shader.hpp"
+
+using namespace std;
+
+offscreen_renderer::offscreen_renderer(int width, int height, int samples)
+    : w{width}, h{height} {
+  color.bind();
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples, GL_RGBA8, w, h);
+  depth.bind();
+  glRenderbufferStorageMultisample(GL_RENDERBUFFER, samples,
+                                   GL_DEPTH_COMPONENT24, w, h);
+  target.bind();
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, color);
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT,
+                            GL_RENDERBUFFER, depth);
+  if (!target.complete())
+    throw runtime_error("Failed to create multisampled framebuffer.");
+
+  resolved_color.bind();
+  glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, w, h);
+  resolved.bind();
+  glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0,
+                            GL_RENDERBUFFER, resolved_color);
+  if (!resolved.complete())
+    throw runtime_error("Failed to create framebuffer for reading.");
+
+  surface_shader = viewer_shader();
+  line_shader = photic_extremum_lines_shader();
+  contour_shader = contours_shader();
+  pixels.resize(size_t(w) * h * 4);
+}
+
+void offscreen_renderer::set_mesh(const prepared_mesh& mesh) {
+  this->mesh = &mesh;
+  memory_stage stage{"mesh buffers"};
+  static_cast<mesh_geometry&>(surface) = mesh.geometry;
+  surface.setup(surface_shader);
+  surface.update();
+
+  // The buffer is only allocated here.
+  // Every frame overwrites its content.
+  illumination_buffer.allocate(
+      surface.vertices.size() * sizeof(illumination_info), nullptr,
+      GL_DYNAMIC_DRAW);
+  setup_illumination_locations(illumination_buffer, surface_shader);
+  setup_illumination_locations(illumination_buffer, line_shader);
+  illumination_data = mesh.illumination_data;
+}
+
+void offscreen_renderer::set_surface_shader(shader_program shader) {
+  surface_shader = std::move(shader);
+  if (!mesh) return;
+  surface.handle.bind();
+  setup_illumination_locations(illumination_buffer, surface_shader);
+}
+
+void offscreen_renderer::render(const camera& cam, const options& opts) {
+  if (!mesh) return;
+  // Lines in image space do not need the illumination of the mesh.
+  const bool object_space_lines =
+      opts.photic_extremum_lines && !opts.image_space;
+  if (opts.surface_shading || object_space_lines) {
+    compute_illumination(cam.direction(), mesh->geometry, mesh->gradient_data,
+                         mesh->adjacency, illumination_data,
+                         opts.light_smoothing);
+    illumination_buffer.bind();
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+                    illumination_data.size() * sizeof(illumination_info),
+                    illumination_data.data());
+  }
+
+  target.bind();
+  glViewport(0, 0, w, h);
+  glEnable(GL_MULTISAMPLE);
+  glEnable(GL_DEPTH_TEST);
+  glEnable(GL_BLEND);
+  glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+  glClearColor(1.0, 1.0, 1.0, 1.0);
+  glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+  if (opts.surface_shading) {
+    surface_shader.bind();
+    surface_shader  //
+        .set("projection", cam.projection_matrix())
+        .set("view", cam.view_matrix())
+        .set("viewport", scale(mat4{1.0f}, {w / 2.0f, h / 2.0f, 1.0f}));
+    surface.render();
+  }
+  line_renderer::options line_options{};
+  line_options.width = opts.line_width;
+  line_options.threshold = opts.threshold;
+  if (opts.photic_extremum_lines && opts.image_space)
+    image_lines.render(cam, opts.threshold,
+                       [&](shader_program&) { surface.render(); });
+  if (object_space_lines) {
+    line_shader.bind();
+    line_shader  //
+        .set("projection", cam.projection_matrix())
+        .set("view", cam.view_matrix())
+        .set("threshold", opts.threshold)
+        .set("shift", opts.line_shift);
+    // Every image is rendered once. So it needs the exact segment count.
+    lines.capture(line_shader, [&] { surface.render(); }, true);
+    lines.render(cam, line_options);
+  }
+  if (opts.contours) {
+    contour_shader.bind();
+    contour_shader  //
+        .set("projection", cam.projection_matrix())
+        .set("view", cam.view_matrix())
+        .set("threshold", opts.threshold)
+        .set("shift", opts.line_shift);
+    lines.capture(contour_shader, [&] { surface.render(); }, true);
+    lines.render(cam, line_options);
+  }
+
+  target.bind(GL_READ_FRAMEBUFFER);
+  resolved.bind(GL_DRAW_FRAMEBUFFER);
+  glBlitFramebuffer(0, 0, w, h, 0, 0, w, h, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+}
+
+auto offscreen_renderer::read_pixels() -> std::span<const uint8_t> {
+  bind_for_reading();
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glReadPixels(0, 0, w, h, GL_RGBA, GL_UNSIGNED_BYTE, pixels.data());
+  return pixels;
+}
+
+void offscreen_renderer::write_png(czstring file_path) {
+  ::write_png(file_path, w, h, read_pixels());
+}
+
+auto orbit_camera(const mesh_geometry& mesh,
+                  int width,
+                  int height,
+                  float azimuth,
+                  float altitude) -> camera {
+  camera cam{width, height};
+  if (mesh.vertices.empty()) return cam;
+
+  auto aabb_min = mesh.vertices[0].position;
+  auto aabb_max = mesh.vertices[0].position;
+  for (const auto& v : mesh.vertices) {
+    aabb_min = min(aabb_min, v.position);
+    aabb_max = max(aabb_max, v.position);
+  }
+  const auto origin = 0.5f * (aabb_max + aabb_min);
+  const auto bounding_radius = 0.5f * length(aabb_max - aabb_min);
+  const auto radius =
+      bounding_radius * (1.0f / tan(0.5f * cam.vfov() * pi / 180.0f));
+
+  const vec3 up{0, 1, 0};
+  const vec3 right{1, 0, 0};
+  const vec3 front{0, 0, 1};
+  const auto p = cos(altitude) * sin(azimuth) * right -  //
+                 cos(altitude) * cos(azimuth) * front +  //
+                 sin(altitude) * up;
+  cam.move(origin + radius * p).look_at(origin, up);
+  cam.set_near_and_far(std::max(1e-3f * radius, radius - bounding_radius),
+                       radius + bounding_radius);
+  return cam;
+}
+
+auto named_surface_shader(std::string_view name) -> shader_program {
+  if (name == "viewer") return viewer_shader();
+  if (name == "wireframe") return wireframe_shader();
+  if (name == "toon") return toon_shader();
+  if (name == "white") return white_shader();
+  if (name == "flat") return flat_shader();
+  if (name == "light") return vertex_light_shader();
+  if (name == "light-variation") return vertex_light_variation_shader();
+  if (name == "light-variation-slope")
+    return vertex_light_variation_slope_shader();
+  throw runtime_error("Unknown surface shader '" + string(name) + "'.");
+}
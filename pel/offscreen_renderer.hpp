@@ -0,0 +1,96 @@
+#pragma once
+#include "buffer.hpp"
+#include "camera.hpp"
+#include "framebuffer.hpp"
+#include "image_space_lines.hpp"
+#include "line_renderer.hpp"
+#include "mesh_cache.hpp"
+#include "model.hpp"
+#include "shader.hpp"
+#include "utility.hpp"
+
+// Renders prepared meshes into a multisampled framebuffer object
+// with the same shaders as the interactive application.
+// No window is involved and the resolution is arbitrary.
+// A current OpenGL context is required, e.g. the one of 'egl_context'.
+class offscreen_renderer {
+ public:
+  struct options {
+    bool surface_shading = true;
+    bool photic_extremum_lines = true;
+    bool contours = true;
+    float threshold = 0.01f;
+    float line_shift = 0.001f;
+    // Width in pixels of lines with full strength
+    float line_width = 2.5f;
+    // Photic extremum lines are extracted per pixel of the frame.
+    bool image_space = false;
+    size_t light_smoothing = 0;
+  };
+
+  offscreen_renderer(int width, int height, int samples = 4);
+
+  // Copying is not allowed.
+  offscreen_renderer(const offscreen_renderer&) = delete;
+  offscreen_renderer& operator=(const offscreen_renderer&) = delete;
+
+  // For now, moving is not allowed.
+  offscreen_renderer(offscreen_renderer&&) = delete;
+  offscreen_renderer& operator=(offscreen_renderer&&) = delete;
+
+  auto width() const noexcept { return w; }
+  auto height() const noexcept { return h; }
+
+  // Uploads the geometry of the mesh.
+  // The mesh must not be destroyed while it is rendered.
+  void set_mesh(const prepared_mesh& mesh);
+  void set_surface_shader(shader_program shader);
+
+  // Illuminates the mesh by the camera direction and renders it.
+  void render(const camera& cam, const options& opts);
+
+  // Binds the last rendered frame as read framebuffer, e.g. for capturing.
+  void bind_for_reading() const { resolved.bind(GL_READ_FRAMEBUFFER); }
+
+  // RGBA pixels of the last rendered frame with the bottom row first
+  auto read_pixels() -> std::span<const uint8_t>;
+  void write_png(czstring file_path);
+
+ private:
+  int w;
+  int h;
+
+  // Multisampled target that is resolved for reading
+  renderbuffer color{};
+  renderbuffer depth{};
+  framebuffer target{};
+  renderbuffer resolved_color{};
+  framebuffer resolved{};
+
+  shader_program surface_shader{};
+  shader_program line_shader{};
+  shader_program contour_shader{};
+  line_renderer lines{};
+  image_space_lines image_lines{};
+
+  const prepared_mesh* mesh{};
+  model surface{};
+  vertex_buffer illumination_buffer{};
+  vector<illumination_info> illumination_data{};
+
+  vector<uint8_t> pixels{};
+};
+
+// Camera that looks at the center of the mesh from the given
+// horizontal coordinates with the y-axis pointing up.
+// Its distance is chosen such that the whole mesh is visible.
+auto orbit_camera(const mesh_geometry& mesh,
+                  int width,
+                  int height,
+                  float azimuth,
+                  float altitude = 0) -> camera;
+
+// Surface shaders of the interactive application by their name.
+// Available are 'viewer', 'wireframe', 'toon', 'white', 'flat',
+// 'light', 'light-variation' and 'light-variation-slope'.
+auto named_surface_shader(std::string_view name) -> shader_program;
@@ -0,0 +1,313 @@
+#include "out_of_core.hpp"
+//
+#include <filesystem>
+#include <future>
+//
+#include "memory_usage.hpp"
+#include "stl_loader.hpp"
+
+using namespace std;
+
+namespace {
+
+namespace fs = std::filesystem;
+using triangle = stl_binary_format::triangle;
+
+// Resolution of the histogram used to partition the bounding box
+constexpr size_t grid_size = 64;
+
+// Directory for the brick files that is removed with all of its content
+class temporary_directory {
+ public:
+  temporary_directory() {
+    std::random_device rng{};
+    path = fs::temp_directory_path() /
+           ("pel-bricks-" + std::to_string(rng()) + std::to_string(rng()));
+    fs::create_directories(path);
+  }
+  ~temporary_directory() {
+    std::error_code error{};
+    fs::remove_all(path, error);
+  }
+
+  // Copying is not allowed.
+  temporary_directory(const temporary_directory&) = delete;
+  temporary_directory& operator=(const temporary_directory&) = delete;
+
+  fs::path path{};
+};
+
+struct brick {
+  // Bounding box in cells of the grid
+  array<size_t, 3> first{};
+  array<size_t, 3> last{};
+  // Bounding box in world space
+  vec3 min{};
+  vec3 max{};
+  size_t core_count{};
+  size_t halo_count{};
+};
+
+struct grid {
+  vec3 origin{};
+  vec3 cell_size{};
+
+  auto cell(const vec3& p) const noexcept -> array<size_t, 3> {
+    const auto x = (p - origin) / cell_size;
+    return {size_t(std::clamp(x.x, 0.0f, grid_size - 1.0f)),
+            size_t(std::clamp(x.y, 0.0f, grid_size - 1.0f)),
+            size_t(std::clamp(x.z, 0.0f, grid_size - 1.0f))};
+  }
+
+  static auto index(const array<size_t, 3>& c) noexcept -> size_t {
+    return (c[2] * grid_size + c[1]) * grid_size + c[0];
+  }
+};
+
+inline auto centroid(const triangle& t) -> vec3 {
+  return (t.vertex[0] + t.vertex[1] + t.vertex[2]) / 3.0f;
+}
+
+// Recursively splits the grid along its longest axis at the median
+// of the triangle histogram until every brick is small enough.
+auto partition(const vector<size_t>& histogram, size_t brick_triangles)
+    -> vector<brick> {
+  vector<brick> bricks{};
+  vector<brick> stack{{{0, 0, 0}, {grid_size, grid_size, grid_size}}};
+  while (!stack.empty()) {
+    auto b = stack.back();
+    stack.pop_back();
+
+    // Triangle counts of all slices orthogonal to every axis
+    array<vector<size_t>, 3> slices{};
+    for (size_t k = 0; k < 3; ++k) slices[k].assign(b.last[k] - b.first[k], 0);
+    size_t count = 0;
+    for (auto z = b.first[2]; z < b.last[2]; ++z)
+      for (auto y = b.first[1]; y < b.last[1]; ++y)
+        for (auto x = b.first[0]; x < b.last[0]; ++x) {
+          const auto n = histogram[grid::index({x, y, z})];
+          slices[0][x - b.first[0]] += n;
+          slices[1][y - b.first[1]] += n;
+          slices[2][z - b.first[2]] += n;
+          count += n;
+        }
+    if (count == 0) continue;
+
+    size_t axis = 0;
+    for (size_t k = 1; k < 3; ++k)
+      if (slices[k].size() > slices[axis].size()) axis = k;
+    if ((count <= brick_triangles) || (slices[axis].size() < 2)) {
+      b.core_count = count;
+      bricks.push_back(b);
+      continue;
+    }
+
+    size_t split = 1;
+    for (size_t sum = slices[axis][0];
+         (split + 1 < slices[axis].size()) && (2 * sum < count); ++split)
+      sum += slices[axis][split];
+    auto lower = b;
+    auto upper = b;
+    lower.last[axis] = b.first[axis] + split;
+    upper.first[axis] = b.first[axis] + split;
+    stack.push_back(upper);
+    stack.push_back(lower);
+  }
+  return bricks;
+}
+
+auto read_triangles(const fs::path& path, size_t count) -> vector<triangle> {
+  vector<triangle> triangles(count);
+  std::ifstream file{path, std::ios::binary};
+  file.read(reinterpret_cast<char*>(triangles.data()),
+            count * sizeof(triangle));
+  if (!file) throw runtime_error("Failed to read brick file.");
+  return triangles;
+}
+
+}  // namespace
+
+auto extract_photic_extremum_lines_out_of_core(
+    czstring stl_path,
+    const out_of_core_options& options) -> vector<polyline> {
+  auto start = system_clock::now();
+
+  // First pass: bounding box, longest edge and histogram of centroids
+  vec3 aabb_min{std::numeric_limits<float>::infinity()};
+  vec3 aabb_max{-std::numeric_limits<float>::infinity()};
+  float max_edge = 0;
+  size_t total = 0;
+  stl_binary_format::read(
+      stl_path, [&](std::span<const triangle> chunk, size_t) {
+        for (const auto& t : chunk) {
+          for (size_t j = 0; j < 3; ++j) {
+            aabb_min = min(aabb_min, t.vertex[j]);
+            aabb_max = max(aabb_max, t.vertex[j]);
+            max_edge = std::max(max_edge,
+                                distance(t.vertex[j], t.vertex[(j + 1) % 3]));
+          }
+        }
+        total += chunk.size();
+      });
+  if (total == 0) return {};
+
+  grid cells{aabb_min,
+             max(aabb_max - aabb_min, vec3{1e-20f}) / float(grid_size)};
+  vector<size_t> histogram(grid_size * grid_size * grid_size, 0);
+  stl_binary_format::read(
+      stl_path, [&](std::span<const triangle> chunk, size_t) {
+        for (const auto& t : chunk)
+          ++histogram[grid::index(cells.cell(centroid(t)))];
+      });
+
+  auto bricks = partition(histogram, options.brick_triangles);
+  vector<uint32_t> cell_brick(histogram.size());
+  for (uint32_t i = 0; i < bricks.size(); ++i) {
+    auto& b = bricks[i];
+    for (auto z = b.first[2]; z < b.last[2]; ++z)
+      for (auto y = b.first[1]; y < b.last[1]; ++y)
+        for (auto x = b.first[0]; x < b.last[0]; ++x)
+          cell_brick[grid::index({x, y, z})] = i;
+    b.min = cells.origin + vec3{b.first[0], b.first[1], b.first[2]} *
+                               cells.cell_size;
+    b.max = cells.origin +
+            vec3{b.last[0], b.last[1], b.last[2]} * cells.cell_size;
+  }
+
+  // Second pass: distribution of the triangles into brick files.
+  // A triangle belongs to the core of the brick containing its centroid
+  // and to the halo of every other brick that it approaches
+  // closer than the halo width.
+  temporary_directory directory{};
+  const auto core_path = [&](size_t i) {
+    return directory.path / ("core-" + std::to_string(i));
+  };
+  const auto halo_path = [&](size_t i) {
+    return directory.path / ("halo-" + std::to_string(i));
+  };
+  {
+    vector<std::ofstream> core_files{};
+    vector<std::ofstream> halo_files{};
+    for (size_t i = 0; i < bricks.size(); ++i) {
+      core_files.emplace_back(core_path(i), std::ios::binary);
+      halo_files.emplace_back(halo_path(i), std::ios::binary);
+      if (!core_files.back() || !halo_files.back())
+        throw runtime_error("Failed to create brick files.");
+    }
+    const auto halo = options.halo_rings * max_edge;
+    vector<uint32_t> neighbors{};
+    stl_binary_format::read(
+        stl_path, [&](std::span<const triangle> chunk, size_t) {
+          for (const auto& t : chunk) {
+            const auto core = cell_brick[grid::index(cells.cell(centroid(t)))];
+            core_files[core].write(reinterpret_cast<const char*>(&t),
+                                   sizeof(t));
+
+            const auto tmin =
+                min(min(t.vertex[0], t.vertex[1]), t.vertex[2]) - halo;
+            const auto tmax =
+                max(max(t.vertex[0], t.vertex[1]), t.vertex[2]) + halo;
+            const auto first = cells.cell(tmin);
+            const auto last = cells.cell(tmax);
+            neighbors.clear();
+            for (auto z = first[2]; z <= last[2]; ++z)
+              for (auto y = first[1]; y <= last[1]; ++y)
+                for (auto x = first[0]; x <= last[0]; ++x) {
+                  const auto i = cell_brick[grid::index({x, y, z})];
+                  if ((i == core) || (ranges::find(neighbors, i) !=
+                                      end(neighbors)))
+                    continue;
+                  neighbors.push_back(i);
+                }
+            for (auto i : neighbors) {
+              halo_files[i].write(reinterpret_cast<const char*>(&t),
+                                  sizeof(t));
+              ++bricks[i].halo_count;
+            }
+          }
+        });
+    for (auto& file : core_files) file.close();
+    for (auto& file : halo_files) file.close();
+  }
+  auto end = system_clock::now();
+  auto time = duration<float>(end - start).count();
+  cout << "out-of-core distribution:\n"
+       << "time = " << time << " s" << '\n'
+       << "triangles = " << total << '\n'
+       << "bricks = " << bricks.size() << '\n'
+       << endl;
+
+  // Third pass: bricks are processed one after another.
+  // Reading the next brick overlaps with the computation of the current one.
+  start = system_clock::now();
+  reset_peak_memory_usage();
+  const auto load = [&](size_t i) {
+    auto triangles = read_triangles(core_path(i), bricks[i].core_count);
+    const auto halo = read_triangles(halo_path(i), bricks[i].halo_count);
+    triangles.insert(triangles.end(), begin(halo), std::end(halo));
+    return triangles;
+  };
+  vector<line_segment> segments{};
+  float light_variation_max = 0;
+  auto next = std::async(std::launch::async, load, 0);
+  for (size_t i = 0; i < bricks.size(); ++i) {
+    auto triangles = next.get();
+    if (i + 1 < bricks.size())
+      next = std::async(std::launch::async, load, i + 1);
+
+    // The welder keeps the order of the triangles.
+    // So the first faces of the mesh form the core.
+    mesh_geometry mesh{};
+    {
+      mesh_welder welder{mesh, triangles.size()};
+      welder.add(triangles);
+      welder.finish();
+    }
+    triangles = {};
+
+    vector<gradient_info> gradient_data(mesh.faces.size());
+    vector<illumination_info> illumination_data(mesh.vertices.size());
+    const auto adjacency = gradient_adjacency(mesh);
+    compute_voronoi_weights(mesh, gradient_data);
+    compute_vertex_voronoi_area(mesh, gradient_data, adjacency,
+                                illumination_data);
+    compute_vertex_tangent_system(mesh, gradient_data, illumination_data);
+    const auto scale = compute_illumination(
+        options.light_dir, mesh, gradient_data, adjacency, illumination_data);
+
+    // Strengths are normalized by the global maximum at the end.
+    // Halo vertices at the outer border of the brick lack parts of their
+    // neighborhood. Hence, only vertices of the core are taken into account.
+    const auto core = bricks[i].core_count;
+    for (size_t j = 0; j < core; ++j)
+      for (auto v : mesh.faces[j])
+        light_variation_max = std::max(
+            light_variation_max,
+            illumination_data[v].light_variation * scale.light_variation);
+    const auto first_segment = segments.size();
+    extract_photic_extremum_lines(mesh, illumination_data, 0, segments, core);
+    for (auto j = first_segment; j < segments.size(); ++j) {
+      segments[j].start_strength *= scale.light_variation;
+      segments[j].end_strength *= scale.light_variation;
+    }
+  }
+
+  erase_if(segments, [&](line_segment& segment) {
+    segment.start_strength /= light_variation_max;
+    segment.end_strength /= light_variation_max;
+    return !clip_line_segment(segment, options.threshold);
+  });
+  auto lines =
+      chain_line_segments(segments, 1e-6f * distance(aabb_min, aabb_max));
+
+  end = system_clock::now();
+  time = duration<float>(end - start).count();
+  const auto memory = process_memory_usage();
+  cout << "out-of-core extraction:\n"
+       << "time = " << time << " s" << '\n'
+       << "segments = " << segments.size() << '\n'
+       << "lines = " << lines.size() << '\n'
+       << "peak memory = " << mebibytes(memory.peak) << " MiB" << '\n'
+       << endl;
+  return lines;
+}
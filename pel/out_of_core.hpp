@@ -0,0 +1,27 @@
+#pragma once
+#include "photic_extremum_lines.hpp"
+#include "polylines.hpp"
+#include "utility.hpp"
+
+struct out_of_core_options {
+  vec3 light_dir{0, 0, 1};
+  float threshold = 0.01f;
+  // Upper bound for the number of triangles of a brick without its halo.
+  // Bricks can only exceed it if their triangles are densely clustered.
+  size_t brick_triangles = size_t{1} << 22;
+  // Width of the halo in multiples of the longest edge
+  // One ring is needed for the gradient of the light. Slope and curve
+  // of the light variation are two further derivatives.
+  float halo_rings = 3;
+};
+
+// Extracts photic extremum lines of binary STL files that are too large
+// to be prepared in memory as a whole. The triangles are distributed
+// into spatial bricks on disk and every brick receives a halo of
+// neighboring triangles. Bricks are then welded, prepared and illuminated
+// one after another while the next one is already read. Only triangles
+// inside a brick contribute lines. So, seams do not produce duplicates.
+// The working set is bounded by two bricks and the extracted segments.
+auto extract_photic_extremum_lines_out_of_core(
+    czstring stl_path,
+    const out_of_core_options& options = {}) -> vector<polyline>;
@@ -0,0 +1,63 @@
+#pragma once
+#include "task_scheduler.hpp"
+#include "utility.hpp"
+
+// Number of threads used by the parallel algorithms.
+inline auto thread_count() noexcept -> size_t { return scheduler().size(); }
+
+// Splits the range [first, last) into 'count' contiguous blocks
+// and calls 'f(begin, end, block)' for every block as a task.
+// The calling thread works on the first block and then helps
+// with the remaining ones. Blocks are given in order such that
+// their results can be merged.
+template <typename F>
+void parallel_for_blocks(size_t first, size_t last, size_t count, F&& f) {
+  const auto size = last - first;
+  count = std::max<size_t>(1, std::min(count, size));
+  if (count == 1) {
+    f(first, last, size_t{0});
+    return;
+  }
+  task_group group{};
+  for (size_t i = 1; i < count; ++i)
+    group.run([&f, i, first, size, count] {
+      f(first + i * size / count, first + (i + 1) * size / count, i);
+    });
+  f(first, first + size / count, size_t{0});
+  group.wait();
+}
+
+template <typename F>
+void parallel_for_blocks(size_t first, size_t last, F&& f) {
+  parallel_for_blocks(first, last, thread_count(), std::forward<F>(f));
+}
+
+// Calls 'f(i)' for every index of the range [first, last).
+// Blocks of at least 'grain' indices are small enough
+// such that idle threads can steal them for load balancing.
+template <typename F>
+void parallel_for(size_t first, size_t last, F&& f, size_t grain = 1024) {
+  const auto count =
+      std::min((last - first) / std::max<size_t>(1, grain) + 1,
+               8 * thread_count());
+  parallel_for_blocks(first, last, count, [&f](size_t b, size_t e, size_t) {
+    for (auto i = b; i < e; ++i) f(i);
+  });
+}
+
+// Reduces the blocks of the range [first, last) in parallel by 'f(begin, end)'
+// and combines their partial results pairwise in a binary tree.
+// The order of combination only depends on the number of threads.
+template <typename T, typename F, typename G>
+auto parallel_reduce(size_t first, size_t last, T init, F&& f, G&& combine)
+    -> T {
+  vector<T> partial(thread_count(), init);
+  parallel_for_blocks(first, last, partial.size(),
+                      [&](size_t begin, size_t end, size_t block) {
+                        partial[block] = f(begin, end);
+                      });
+  for (size_t stride = 1; stride < partial.size(); stride *= 2)
+    for (size_t i = 0; i + stride < partial.size(); i += 2 * stride)
+      partial[i] = combine(partial[i], partial[i + stride]);
+  return combine(init, partial[0]);
+}
@@ -1,117 +1,197 @@
 #include "photic_extremum_lines.hpp"
+//
+#include "denormals.hpp"
+#include "parallel.hpp"
+
+namespace {
+
+auto voronoi_weights(const mesh_geometry& mesh, const mesh_geometry::face& f)
+    -> gradient_info {
+  if (is_degenerate_face(mesh, f)) return {};
+  const auto& x = mesh.vertices[f[0]].position;
+  const auto& y = mesh.vertices[f[1]].position;
+  const auto& z = mesh.vertices[f[2]].position;
+
+  const auto a = y - x;
+  const auto b = z - y;
+  const auto c = x - z;
+
+  const auto u = a;
+  const auto v = -c;
+  const auto area = length(cross(a, b)) / 2;
+
+  // The gradient of a linear function on the face only depends on
+  // its differences along the edges u and v by the Gram inverse.
+  const auto uv = dot(u, v);
+  const auto u2 = dot(u, u);
+  const auto v2 = dot(v, v);
+  const auto inv_det = 1 / (u2 * v2 - uv * uv);
+
+  const auto ca = dot(c, a);
+  const auto ab = dot(a, b);
+  const auto bc = dot(b, c);
+
+  const auto x_is_obtuse = (ca <= 0);
+  const auto y_is_obtuse = (ab <= 0);
+  const auto z_is_obtuse = (bc <= 0);
+
+  const auto is_obtuse = x_is_obtuse || y_is_obtuse || z_is_obtuse;
+
+  float weight[3];
+  if (is_obtuse) {
+    weight[0] = (x_is_obtuse) ? (area / 2) : (area / 4);
+    weight[1] = (y_is_obtuse) ? (area / 2) : (area / 4);
+    weight[2] = (z_is_obtuse) ? (area / 2) : (area / 4);
+  } else {
+    // Compute circumcenter.
+    const auto p = (u2 * v2 - v2 * uv) * inv_det / 2;
+    const auto q = (u2 * v2 - u2 * uv) * inv_det / 2;
+    const auto m = p * u + q * v;
+
+    // Compute areas.
+    const auto vaa = length(cross(m, a)) / 2;
+    const auto vab = length(cross(m, b)) / 2;
+    const auto vac = length(cross(m, c)) / 2;
+
+    weight[0] = vac + vaa;
+    weight[1] = vaa + vab;
+    weight[2] = vab + vac;
+
+    assert(std::abs(weight[0] + weight[1] + weight[2] - area) < 1e-5);
+  }
 
-void compute_voronoi_weights(const model& mesh,
-                             vector<gradient_info>& gradient_data) {
-  for (size_t i = 0; i < mesh.faces.size(); ++i) {
-    const auto& f = mesh.faces[i];
-
-    const auto& x = mesh.vertices[f[0]].position;
-    const auto& y = mesh.vertices[f[1]].position;
-    const auto& z = mesh.vertices[f[2]].position;
-
-    const auto a = y - x;
-    const auto b = z - y;
-    const auto c = x - z;
-
-    const auto u = a;
-    const auto v = -c;
-    const auto area = length(cross(a, b)) / 2;
-
-    const auto ca = dot(c, a);
-    const auto ab = dot(a, b);
-    const auto bc = dot(b, c);
-
-    const auto x_is_obtuse = (ca <= 0);
-    const auto y_is_obtuse = (ab <= 0);
-    const auto z_is_obtuse = (bc <= 0);
-
-    const auto is_obtuse = x_is_obtuse || y_is_obtuse || z_is_obtuse;
-
-    float weight[3];
-    if (is_obtuse) {
-      weight[0] = (x_is_obtuse) ? (area / 2) : (area / 4);
-      weight[1] = (y_is_obtuse) ? (area / 2) : (area / 4);
-      weight[2] = (z_is_obtuse) ? (area / 2) : (area / 4);
-    } else {
-      // Compute circumcenter.
-      const auto u = a;
-      const auto v = -c;
-      const auto uv = dot(u, v);
-      const auto u2 = dot(u, u);
-      const auto v2 = dot(v, v);
-      const auto det = u2 * v2 - uv * uv;
-      const auto inv_det = 1 / det;
-      const auto p = (u2 * v2 - v2 * uv) * inv_det / 2;
-      const auto q = (u2 * v2 - u2 * uv) * inv_det / 2;
-      const auto m = p * u + q * v;
-
-      // Compute areas.
-      const auto vaa = length(cross(m, a)) / 2;
-      const auto vab = length(cross(m, b)) / 2;
-      const auto vac = length(cross(m, c)) / 2;
-
-      weight[0] = vac + vaa;
-      weight[1] = vaa + vab;
-      weight[2] = vab + vac;
-
-      assert(std::abs(weight[0] + weight[1] + weight[2] - area) < 1e-5);
-    }
+  gradient_info result{};
+  result.area = area;
+  for (size_t j = 0; j < 3; ++j) result.voronoi_weight[j] = weight[j];
+  result.edge_gradient[0] = (v2 * u - uv * v) * inv_det;
+  result.edge_gradient[1] = (u2 * v - uv * u) * inv_det;
+  return result;
+}
 
-    gradient_data[i].area = area;
-    for (size_t j = 0; j < 3; ++j)
-      gradient_data[i].voronoi_weight[j] = weight[j];
-  }
+}  // namespace
+
+bool is_degenerate_face(const mesh_geometry& mesh,
+                        const mesh_geometry::face& f) noexcept {
+  const auto& x = mesh.vertices[f[0]].position;
+  const auto u = mesh.vertices[f[1]].position - x;
+  const auto v = mesh.vertices[f[2]].position - x;
+  const auto w = v - u;
+  const auto cross2 = dot(cross(u, v), cross(u, v));
+  // The squared sine at every corner is the squared cross product divided
+  // by the squared lengths of its two edges. Hence, the smallest angle is
+  // enclosed by the two longest edges.
+  const auto u2 = dot(u, u);
+  const auto v2 = dot(v, v);
+  const auto w2 = dot(w, w);
+  const auto edges2 = std::max({u2 * v2, v2 * w2, w2 * u2});
+  // Negated such that non-finite positions are degenerate as well.
+  return !(cross2 > degenerate_face_tolerance * edges2);
 }
 
-void compute_vertex_tangent_system(
-    const model& mesh, const vector<gradient_info>& gradient_data,
-    vector<illumination_info>& illumination_data) {
-  // Random Oracle
-  std::mt19937 rng{std::random_device{}()};
-  std::uniform_real_distribution<float> dist{};
-  const auto random = [&]() { return dist(rng); };
+auto regular_faces(const mesh_geometry& mesh) -> vector<uint32_t> {
+  vector<uint32_t> result{};
+  result.reserve(mesh.faces.size());
+  for (uint32_t i = 0; i < mesh.faces.size(); ++i)
+    if (!is_degenerate_face(mesh, mesh.faces[i])) result.push_back(i);
+  return result;
+}
 
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    const auto& normal = mesh.vertices[i].normal;
+auto gradient_adjacency(const mesh_geometry& mesh) -> vertex_face_adjacency {
+  return vertex_face_adjacency{mesh, regular_faces(mesh)};
+}
 
-    vec3 u, v;
+void compute_voronoi_weights(const mesh_geometry& mesh,
+                             vector<gradient_info>& gradient_data) {
+  parallel_for(size_t{0}, mesh.faces.size(), [&](size_t i) {
+    gradient_data[i] = voronoi_weights(mesh, mesh.faces[i]);
+  });
+}
 
-    const float eps = 0.1;
-    float projection = 0;
-    while (projection < eps) {
-      const auto theta = 2 * pi * random();
-      const auto phi = acos(1 - 2 * random());
-      const auto r =
-          vec3{sin(phi) * cos(theta), sin(phi) * sin(theta), cos(phi)};
+void compute_voronoi_weights(const mesh_geometry& mesh,
+                             std::span<const uint32_t> faces,
+                             vector<gradient_info>& gradient_data) {
+  parallel_for(size_t{0}, faces.size(), [&](size_t i) {
+    gradient_data[faces[i]] = voronoi_weights(mesh, mesh.faces[faces[i]]);
+  });
+}
 
-      u = cross(normal, r);
-      projection = length(u);
+void compute_vertex_tangent_system(
+    const mesh_geometry& mesh, const vector<gradient_info>& gradient_data,
+    vector<illumination_info>& illumination_data) {
+  // Every block of vertices uses its own random oracle.
+  const auto seed = std::random_device{}();
+  const auto tangent_systems = [&](size_t first, size_t last,
+                                   size_t block) {
+    std::mt19937 rng{seed + uint32_t(block)};
+    std::uniform_real_distribution<float> dist{};
+    const auto random = [&]() { return dist(rng); };
+
+    for (size_t i = first; i < last; ++i) {
+      const auto& normal = mesh.vertices[i].normal;
+
+      vec3 u, v;
+
+      const float eps = 0.1;
+      float projection = 0;
+      while (projection < eps) {
+        const auto theta = 2 * pi * random();
+        const auto phi = acos(1 - 2 * random());
+        const auto r =
+            vec3{sin(phi) * cos(theta), sin(phi) * sin(theta), cos(phi)};
+
+        u = cross(normal, r);
+        projection = length(u);
+      }
+
+      u = normalize(u);
+      v = cross(normal, u);
+
+      // assert(abs(length(u) - 1) < 1e-5);
+      // assert(abs(length(v) - 1) < 1e-5);
+      // assert(abs(length(normal) - 1) < 1e-5);
+      // assert(abs(dot(u, v)) < 1e-5);
+      // assert(abs(dot(u, normal)) < 1e-5);
+      // assert(abs(dot(v, normal)) < 1e-5);
+
+      illumination_data[i].u = u;
+      illumination_data[i].v = v;
     }
+  };
+  parallel_for_blocks(size_t{0}, mesh.vertices.size(), tangent_systems);
+}
 
-    u = normalize(u);
-    v = cross(normal, u);
-
-    // assert(abs(length(u) - 1) < 1e-5);
-    // assert(abs(length(v) - 1) < 1e-5);
-    // assert(abs(length(normal) - 1) < 1e-5);
-    // assert(abs(dot(u, v)) < 1e-5);
-    // assert(abs(dot(u, normal)) < 1e-5);
-    // assert(abs(dot(v, normal)) < 1e-5);
-
-    illumination_data[i].u = u;
-    illumination_data[i].v = v;
-  }
+void update_vertex_tangent_system(
+    const mesh_geometry& mesh, std::span<const uint32_t> vertices,
+    vector<illumination_info>& illumination_data) {
+  parallel_for(size_t{0}, vertices.size(), [&](size_t k) {
+    const auto i = vertices[k];
+    const auto& normal = mesh.vertices[i].normal;
+    auto& x = illumination_data[i];
+    // Gram-Schmidt orthogonalization of the previous tangent.
+    // If it nearly became parallel to the normal, the axis
+    // that is most orthogonal to the normal is used instead.
+    auto u = x.u - dot(x.u, normal) * normal;
+    if (length(u) < 0.1f) {
+      const auto a = abs(normal);
+      const auto axis = (a.x <= a.y) && (a.x <= a.z) ? vec3{1, 0, 0}
+                        : (a.y <= a.z)               ? vec3{0, 1, 0}
+                                                     : vec3{0, 0, 1};
+      u = cross(normal, axis);
+    }
+    x.u = normalize(u);
+    x.v = cross(normal, x.u);
+  });
 }
 
-void compute_vertex_light(vec3 light_dir, const model& mesh,
+void compute_vertex_light(vec3 light_dir, const mesh_geometry& mesh,
                           vector<illumination_info>& illumination_data) {
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
+  parallel_for(size_t{0}, mesh.vertices.size(), [&](size_t i) {
     illumination_data[i].light =
         std::abs(dot(mesh.vertices[i].normal, light_dir));
-  }
+  });
 }
 
-void compute_vertex_voronoi_area(const model& mesh,
+void compute_vertex_voronoi_area(const mesh_geometry& mesh,
                                  const vector<gradient_info>& gradient_data,
                                  vector<illumination_info>& illumination_data) {
   for (size_t i = 0; i < mesh.faces.size(); ++i) {
@@ -123,193 +203,337 @@ void compute_vertex_voronoi_area(const model& mesh,
   }
 }
 
-void compute_vertex_light_gradient(
-    const model& mesh, const vector<gradient_info>& gradient_data,
-    vector<illumination_info>& illumination_data) {
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    auto& x = illumination_data[i];
-    x.light_gradient = {};
-    x.light_variation = 0;
-  }
-  for (size_t i = 0; i < mesh.faces.size(); ++i) {
-    const auto& f = mesh.faces[i];
-    const auto& x = mesh.vertices[f[0]].position;
-    const auto& y = mesh.vertices[f[1]].position;
-    const auto& z = mesh.vertices[f[2]].position;
-
-    const auto lx = illumination_data[f[0]].light;
-    const auto ly = illumination_data[f[1]].light;
-    const auto lz = illumination_data[f[2]].light;
-
-    const auto u = y - x;
-    const auto v = z - x;
-
-    const auto dlu = ly - lx;
-    const auto dlv = lz - lx;
-
-    const auto u2 = dot(u, u);
-    const auto v2 = dot(v, v);
-    const auto uv = dot(u, v);
-
-    const auto inv_det = 1 / (u2 * v2 - uv * uv);
-
-    const auto p = (v2 * dlu - uv * dlv) * inv_det;
-    const auto q = (u2 * dlv - uv * dlu) * inv_det;
-
-    // const auto grad = p * u + q * v;
-
-    for (int j = 0; j < 3; ++j) {
-      const auto& bu = illumination_data[f[j]].u;
-      const auto& bv = illumination_data[f[j]].v;
+void compute_vertex_voronoi_area(const mesh_geometry& mesh,
+                                 const vector<gradient_info>& gradient_data,
+                                 const vertex_face_adjacency& adjacency,
+                                 vector<illumination_info>& illumination_data) {
+  parallel_for(size_t{0}, mesh.vertices.size(), [&](size_t i) {
+    float area = 0;
+    for (auto k : adjacency.faces(i)) {
+      const auto& f = mesh.faces[k];
+      const auto j = (f[0] == i) ? 0 : ((f[1] == i) ? 1 : 2);
+      area += gradient_data[k].voronoi_weight[j];
+    }
+    illumination_data[i].voronoi_area = area;
+  });
+}
 
-      const auto buu = dot(bu, u);
-      const auto buv = dot(bu, v);
-      const auto bvu = dot(bv, u);
-      const auto bvv = dot(bv, v);
+void compute_vertex_voronoi_area(const mesh_geometry& mesh,
+                                 const vector<gradient_info>& gradient_data,
+                                 const vertex_face_adjacency& adjacency,
+                                 std::span<const uint32_t> vertices,
+                                 vector<illumination_info>& illumination_data) {
+  parallel_for(size_t{0}, vertices.size(), [&](size_t k) {
+    const auto i = vertices[k];
+    float area = 0;
+    for (auto f : adjacency.faces(i)) {
+      const auto& face = mesh.faces[f];
+      const auto j = (face[0] == i) ? 0 : ((face[1] == i) ? 1 : 2);
+      area += gradient_data[f].voronoi_weight[j];
+    }
+    illumination_data[i].voronoi_area = area;
+  });
+}
 
-      const auto grad = vec2{buu * p + buv * q,  //
-                             bvu * p + bvv * q};
+namespace {
 
-      illumination_data[f[j]].light_gradient +=
-          gradient_data[i].voronoi_weight[j] * grad;
-    }
-  }
+// Vertices without any regular face have no area and flat regions have
+// no light variation. Their values become zero instead of NaN.
+inline auto reciprocal(float x) noexcept -> float {
+  return (x > 0) ? 1 / x : 0.0f;
+}
 
-  float light_variation_max = 0;
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    auto& x = illumination_data[i];
-    x.light_gradient /= x.voronoi_area;
-    x.light_variation = length(x.light_gradient);
-    x.light_gradient /= x.light_variation;
-    light_variation_max = std::max(light_variation_max, x.light_variation);
-  }
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    auto& x = illumination_data[i];
-    x.light_variation /= light_variation_max;
+// Voronoi weighted sum of the face gradients of 'value' around vertex 'i'
+inline auto vertex_gradient(const mesh_geometry& mesh,
+                            const vector<gradient_info>& gradient_data,
+                            const vertex_face_adjacency& adjacency,
+                            const vector<illumination_info>& data,
+                            size_t i,
+                            auto value) -> vec2 {
+  // Face gradients are accumulated in world space
+  // and projected into the tangent system only once.
+  // Their edge terms have been computed once for every face.
+  vec3 result{};
+  for (auto k : adjacency.faces(i)) {
+    const auto& f = mesh.faces[k];
+    const auto j = (f[0] == i) ? 0 : ((f[1] == i) ? 1 : 2);
+    const auto& g = gradient_data[k];
+
+    const auto a = value(f[0]);
+    const auto dlu = value(f[1]) - a;
+    const auto dlv = value(f[2]) - a;
+
+    result += g.voronoi_weight[j] *
+              (dlu * g.edge_gradient[0] + dlv * g.edge_gradient[1]);
   }
+  return vec2{dot(data[i].u, result), dot(data[i].v, result)};
 }
 
-void compute_vertex_light_variation_slope(
-    const model& mesh, const vector<gradient_info>& gradient_data,
-    vector<illumination_info>& illumination_data) {
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    auto& x = illumination_data[i];
-    x.light_variation_slope = 0;
+// Jacobi sweeps with double buffering such that every vertex
+// only reads the values of the previous iteration.
+// The light of every vertex is replaced by the average of itself
+// and the area-weighted mean of its one-ring neighbors.
+// Every sweep spreads the light by one ring. So the unsmoothed light
+// is needed for the vertices up to 'end(iterations)'. Each sweep
+// then leaves out one more of the outer rings until only the vertices
+// up to 'end(0)' remain whose smoothed light is written back.
+void smooth_light(const mesh_geometry& mesh,
+                  const vector<gradient_info>& gradient_data,
+                  const vertex_face_adjacency& adjacency,
+                  vector<illumination_info>& data,
+                  auto vertex,
+                  auto end,
+                  size_t iterations,
+                  const std::function<bool()>& stop) {
+  vector<float> light(mesh.vertices.size());
+  parallel_for_blocks(size_t{0}, end(iterations),
+                      [&](size_t first, size_t last, size_t) {
+                        for (auto k = first; k < last; ++k) {
+                          const auto i = vertex(k);
+                          light[i] = data[i].light;
+                        }
+                      });
+  auto smoothed = light;
+
+  for (size_t n = 0; n < iterations; ++n) {
+    const auto count = end(iterations - n - 1);
+    parallel_for_blocks(size_t{0}, count, [&](size_t first, size_t last,
+                                              size_t) {
+      const denormals_as_zero mode{};
+      for (auto k = first; k < last; ++k) {
+        const auto i = vertex(k);
+        float sum = 0;
+        float weight = 0;
+        for (auto f : adjacency.faces(i)) {
+          const auto& face = mesh.faces[f];
+          const auto j = (face[0] == i) ? 0 : ((face[1] == i) ? 1 : 2);
+          const auto area = gradient_data[f].area;
+          sum += area *
+                 (light[face[(j + 1) % 3]] + light[face[(j + 2) % 3]]) / 2;
+          weight += area;
+        }
+        smoothed[i] = (weight > 0) ? (light[i] + sum / weight) / 2 : light[i];
+      }
+    });
+    swap(light, smoothed);
+    if (stop()) return;
   }
 
-  for (size_t i = 0; i < mesh.faces.size(); ++i) {
-    const auto& f = mesh.faces[i];
-    const auto& x = mesh.vertices[f[0]].position;
-    const auto& y = mesh.vertices[f[1]].position;
-    const auto& z = mesh.vertices[f[2]].position;
-
-    const auto lx = illumination_data[f[0]].light_variation;
-    const auto ly = illumination_data[f[1]].light_variation;
-    const auto lz = illumination_data[f[2]].light_variation;
-
-    const auto u = y - x;
-    const auto v = z - x;
-
-    const auto dlu = ly - lx;
-    const auto dlv = lz - lx;
-
-    const auto u2 = dot(u, u);
-    const auto v2 = dot(v, v);
-    const auto uv = dot(u, v);
-
-    const auto inv_det = 1 / (u2 * v2 - uv * uv);
-
-    const auto p = (v2 * dlu - uv * dlv) * inv_det;
-    const auto q = (u2 * dlv - uv * dlu) * inv_det;
-
-    // const auto grad = p * u + q * v;
-
-    for (int j = 0; j < 3; ++j) {
-      const auto& bu = illumination_data[f[j]].u;
-      const auto& bv = illumination_data[f[j]].v;
-
-      const auto buu = dot(bu, u);
-      const auto buv = dot(bu, v);
-      const auto bvu = dot(bv, u);
-      const auto bvv = dot(bv, v);
-
-      const auto grad = vec2{buu * p + buv * q,  //
-                             bvu * p + bvv * q};
-
-      illumination_data[f[j]].light_variation_slope +=
-          gradient_data[i].voronoi_weight[j] *
-          dot(grad, illumination_data[f[j]].light_gradient);
+  parallel_for_blocks(size_t{0}, end(0), [&](size_t first, size_t last,
+                                             size_t) {
+    for (auto k = first; k < last; ++k) {
+      const auto i = vertex(k);
+      data[i].light = light[i];
     }
-  }
-
-  float light_variation_slope_max = 0;
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    auto& x = illumination_data[i];
-    x.light_variation_slope /= x.voronoi_area;
-    light_variation_slope_max =
-        std::max(light_variation_slope_max, std::abs(x.light_variation_slope));
-  }
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    auto& x = illumination_data[i];
-    x.light_variation_slope /= light_variation_slope_max;
-  }
+  });
 }
 
-void compute_vertex_light_variation_curve(
-    const model& mesh, const vector<gradient_info>& gradient_data,
-    vector<illumination_info>& illumination_data) {
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    auto& x = illumination_data[i];
-    x.light_variation_curve = 0;
+auto fused_illumination(vec3 light_dir,
+                        const mesh_geometry& mesh,
+                        const vector<gradient_info>& gradient_data,
+                        const vertex_face_adjacency& adjacency,
+                        vector<illumination_info>& data,
+                        auto vertex,
+                        auto end,
+                        illumination_scale scale,
+                        size_t light_smoothing,
+                        const std::function<bool()>& cancelled)
+    -> illumination_scale {
+  const std::function<bool()> stop = [&] { return cancelled && cancelled(); };
+  const auto max = [](float x, float y) { return std::max(x, y); };
+
+  // 'end(r)' is the number of vertices whose values are needed 'r' rings
+  // around the result. Every derivative reads one ring of neighbors.
+  // Hence, the light variation is computed up to the second ring and its
+  // slope up to the first one while the curve is only computed for the
+  // result itself. For the full mesh, all of these are the same.
+
+  // Smoothing needs the light of all neighbors in advance.
+  // The light variation reads the smoothed light up to the third ring.
+  if (light_smoothing) {
+    const auto smoothing_end = [&](size_t ring) { return end(3 + ring); };
+    parallel_for_blocks(size_t{0}, smoothing_end(light_smoothing),
+                        [&](size_t first, size_t last, size_t) {
+                          for (auto k = first; k < last; ++k) {
+                            const auto i = vertex(k);
+                            data[i].light = std::abs(
+                                dot(mesh.vertices[i].normal, light_dir));
+                          }
+                        });
+    smooth_light(mesh, gradient_data, adjacency, data, vertex, smoothing_end,
+                 light_smoothing, stop);
+    if (stop()) return {};
   }
+  const auto light = [&](uint32_t v) {
+    return light_smoothing ? data[v].light
+                           : std::abs(dot(mesh.vertices[v].normal, light_dir));
+  };
+
+  // Without smoothing, light values of neighbors are recomputed instead of
+  // being read such that the light does not need a sweep of its own.
+  // Light variation and slope stay unnormalized until the last sweep.
+  // Their gradients only differ by the normalization factor.
+  const auto light_variation_max = parallel_reduce(
+      size_t{0}, end(2), 0.0f,
+      [&](size_t first, size_t last) {
+        const denormals_as_zero mode{};
+        float result = 0;
+        for (auto k = first; k < last; ++k) {
+          const auto i = vertex(k);
+          auto& x = data[i];
+          x.light = light(i);
+          const auto gradient =
+              vertex_gradient(mesh, gradient_data, adjacency, data, i, light) *
+              reciprocal(x.voronoi_area);
+          x.light_variation = length(gradient);
+          x.light_gradient = gradient * reciprocal(x.light_variation);
+          result = std::max(result, x.light_variation);
+        }
+        return result;
+      },
+      max);
+  if (stop()) return {};
+
+  const auto light_variation_slope_max = parallel_reduce(
+      size_t{0}, end(1), 0.0f,
+      [&](size_t first, size_t last) {
+        const denormals_as_zero mode{};
+        float result = 0;
+        for (auto k = first; k < last; ++k) {
+          const auto i = vertex(k);
+          auto& x = data[i];
+          const auto gradient = vertex_gradient(
+              mesh, gradient_data, adjacency, data, i,
+              [&](uint32_t v) { return data[v].light_variation; });
+          x.light_variation_slope =
+              dot(gradient, x.light_gradient) * reciprocal(x.voronoi_area);
+          result = std::max(result, std::abs(x.light_variation_slope));
+        }
+        return result;
+      },
+      max);
+  if (stop()) return {};
+
+  // A given scale replaces the maxima of a selection
+  // such that it is normalized like the full mesh.
+  if (!scale.light_variation)
+    scale = {light_variation_max, light_variation_slope_max};
+  const auto variation_scale = reciprocal(scale.light_variation);
+  const auto slope_scale = reciprocal(scale.light_variation_slope);
+  parallel_for_blocks(size_t{0}, end(0), [&](size_t first, size_t last,
+                                             size_t) {
+    const denormals_as_zero mode{};
+    for (auto k = first; k < last; ++k) {
+      const auto i = vertex(k);
+      auto& x = data[i];
+      const auto gradient = vertex_gradient(
+          mesh, gradient_data, adjacency, data, i,
+          [&](uint32_t v) { return data[v].light_variation_slope; });
+      x.light_variation_curve = dot(gradient, x.light_gradient) *
+                                reciprocal(x.voronoi_area) * slope_scale;
+    }
+  });
+  if (stop()) return {};
+
+  // Intermediate values of the outer rings are normalized as well.
+  // So they never keep values in other units than the rest of the data.
+  const auto slope_end = end(1);
+  parallel_for_blocks(size_t{0}, end(2), [&](size_t first, size_t last,
+                                             size_t) {
+    for (auto k = first; k < last; ++k) {
+      auto& x = data[vertex(k)];
+      x.light_variation *= variation_scale;
+      if (k < slope_end) x.light_variation_slope *= slope_scale;
+    }
+  });
+  return scale;
+}
 
-  for (size_t i = 0; i < mesh.faces.size(); ++i) {
-    const auto& f = mesh.faces[i];
-    const auto& x = mesh.vertices[f[0]].position;
-    const auto& y = mesh.vertices[f[1]].position;
-    const auto& z = mesh.vertices[f[2]].position;
-
-    const auto lx = illumination_data[f[0]].light_variation_slope;
-    const auto ly = illumination_data[f[1]].light_variation_slope;
-    const auto lz = illumination_data[f[2]].light_variation_slope;
-
-    const auto u = y - x;
-    const auto v = z - x;
-
-    const auto dlu = ly - lx;
-    const auto dlv = lz - lx;
-
-    const auto u2 = dot(u, u);
-    const auto v2 = dot(v, v);
-    const auto uv = dot(u, v);
-
-    const auto inv_det = 1 / (u2 * v2 - uv * uv);
-
-    const auto p = (v2 * dlu - uv * dlv) * inv_det;
-    const auto q = (u2 * dlv - uv * dlu) * inv_det;
-
-    const auto grad = p * u + q * v;
-
-    for (int j = 0; j < 3; ++j) {
-      const auto& bu = illumination_data[f[j]].u;
-      const auto& bv = illumination_data[f[j]].v;
+}  // namespace
+
+auto compute_illumination(vec3 light_dir,
+                          const mesh_geometry& mesh,
+                          const vector<gradient_info>& gradient_data,
+                          const vertex_face_adjacency& adjacency,
+                          vector<illumination_info>& illumination_data,
+                          size_t light_smoothing,
+                          const std::function<bool()>& cancelled)
+    -> illumination_scale {
+  const auto count = mesh.vertices.size();
+  return fused_illumination(
+      light_dir, mesh, gradient_data, adjacency, illumination_data,
+      [](size_t k) { return k; }, [count](size_t) { return count; },
+      illumination_scale{}, light_smoothing, cancelled);
+}
 
-      const auto buu = dot(bu, u);
-      const auto buv = dot(bu, v);
-      const auto bvu = dot(bv, u);
-      const auto bvv = dot(bv, v);
+auto compute_illumination(vec3 light_dir,
+                          const mesh_geometry& mesh,
+                          const vector<gradient_info>& gradient_data,
+                          const vertex_face_adjacency& adjacency,
+                          const mesh_selection& selection,
+                          vector<illumination_info>& illumination_data,
+                          illumination_scale scale,
+                          size_t light_smoothing,
+                          const std::function<bool()>& cancelled)
+    -> illumination_scale {
+  return fused_illumination(
+      light_dir, mesh, gradient_data, adjacency, illumination_data,
+      [&](size_t k) { return selection.vertices[k]; },
+      [&](size_t ring) { return selection.ring_end(ring); }, scale,
+      light_smoothing, cancelled);
+}
 
-      const auto grad = vec2{buu * p + buv * q,  //
-                             bvu * p + bvv * q};
+bool face_photic_extremum_line(
+    const mesh_geometry& mesh,
+    const vector<illumination_info>& illumination_data,
+    size_t face,
+    line_segment& segment) {
+  const auto& f = mesh.faces[face];
+  const auto& data = illumination_data;
+
+  float s[3], c[3];
+  for (size_t j = 0; j < 3; ++j) s[j] = data[f[j]].light_variation_slope;
+  // Curves are interpolated along the edges like in the shader.
+  for (size_t j = 0; j < 3; ++j) {
+    const auto k = (j + 1) % 3;
+    c[j] = (std::abs(s[k]) * data[f[j]].light_variation_curve +
+            std::abs(s[j]) * data[f[k]].light_variation_curve) /
+           (std::abs(s[j]) + std::abs(s[k]));
+  }
 
-      illumination_data[f[j]].light_variation_curve +=
-          gradient_data[i].voronoi_weight[j] *
-          dot(grad, illumination_data[f[j]].light_gradient);
-    }
+  // The line strip of the shader has at most two vertices.
+  vec3 p[2];
+  float l[2];
+  size_t n = 0;
+  for (size_t j = 0; (j < 3) && (n < 2); ++j) {
+    const auto k = (j + 1) % 3;
+    if (!((s[j] * s[k] < 0) && (c[j] < 0))) continue;
+    const auto sj = std::abs(s[j]);
+    const auto sk = std::abs(s[k]);
+    p[n] = (sk * mesh.vertices[f[j]].position +
+            sj * mesh.vertices[f[k]].position) /
+           (sj + sk);
+    l[n] = (sk * data[f[j]].light_variation +
+            sj * data[f[k]].light_variation) /
+           (sj + sk);
+    ++n;
   }
+  if (n < 2) return false;
 
-  for (size_t i = 0; i < mesh.vertices.size(); ++i) {
-    auto& x = illumination_data[i];
-    x.light_variation_curve /= x.voronoi_area;
+  segment = {p[0], p[1], l[0], l[1]};
+  return true;
+}
+
+void extract_photic_extremum_lines(
+    const mesh_geometry& mesh,
+    const vector<illumination_info>& illumination_data,
+    float threshold,
+    vector<line_segment>& segments,
+    size_t face_count) {
+  for (size_t i = 0; i < face_count; ++i) {
+    line_segment segment;
+    if (face_photic_extremum_line(mesh, illumination_data, i, segment) &&
+        clip_line_segment(segment, threshold))
+      segments.push_back(segment);
   }
 }
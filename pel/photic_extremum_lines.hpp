@@ -1,4 +1,7 @@
 #pragma once
+#include <functional>
+//
+#include "mesh_clusters.hpp"
 #include "model.hpp"
 #include "utility.hpp"
 
@@ -16,30 +19,173 @@ struct illumination_info {
 struct gradient_info {
   float area;
   float voronoi_weight[3];
+  // Gradients of the barycentric coordinates of the second and third
+  // vertex. The gradient of a linear function on the face is given by
+  // its differences along the edges weighted with these vectors.
+  vec3 edge_gradient[2];
 };
 
-void compute_voronoi_weights(const model& mesh,
+// Zero-area and sliver triangles as well as faces with non-finite vertices
+// are degenerate. Their gradients would divide by a vanishing determinant
+// of the edge vectors and spread inf and NaN over their neighborhood.
+// A face is degenerate if the squared sine of its smallest angle does not
+// exceed the tolerance. Below, the determinant loses most of its precision
+// due to cancellation. The test does not depend on the vertex order.
+constexpr float degenerate_face_tolerance = 1e-5f;
+
+bool is_degenerate_face(const mesh_geometry& mesh,
+                        const mesh_geometry::face& f) noexcept;
+
+// Ascending indices of all faces that are not degenerate
+auto regular_faces(const mesh_geometry& mesh) -> vector<uint32_t>;
+
+// Adjacency of the regular faces which is iterated by the gradient kernels.
+// Degenerate faces are classified and excluded only once. So the kernels
+// neither check nor waste any time on them.
+auto gradient_adjacency(const mesh_geometry& mesh) -> vertex_face_adjacency;
+
+// Number of faces that are missing in an adjacency built from regular faces
+inline auto dropped_face_count(const mesh_geometry& mesh,
+                               const vertex_face_adjacency& adjacency) noexcept
+    -> size_t {
+  return mesh.faces.size() - adjacency.face_indices.size() / 3;
+}
+
+// Degenerate faces get zero area and weights.
+void compute_voronoi_weights(const mesh_geometry& mesh,
+                             vector<gradient_info>& gradient_data);
+
+// Only the given faces are updated.
+void compute_voronoi_weights(const mesh_geometry& mesh,
+                             std::span<const uint32_t> faces,
                              vector<gradient_info>& gradient_data);
 
 void compute_vertex_tangent_system(
-    const model& mesh, const vector<gradient_info>& gradient_data,
+    const mesh_geometry& mesh, const vector<gradient_info>& gradient_data,
     vector<illumination_info>& illumination_data);
 
-void compute_vertex_light(vec3 light_dir, const model& mesh,
-                          vector<illumination_info>& illumination_data);
+// Adapts the tangent systems of the given vertices to their new normals.
+// The previous tangents are projected onto the new tangent planes
+// such that the frames of a deforming mesh change continuously.
+void update_vertex_tangent_system(
+    const mesh_geometry& mesh, std::span<const uint32_t> vertices,
+    vector<illumination_info>& illumination_data);
 
-void compute_vertex_voronoi_area(const model& mesh,
+void compute_vertex_voronoi_area(const mesh_geometry& mesh,
                                  const vector<gradient_info>& gradient_data,
                                  vector<illumination_info>& illumination_data);
 
-void compute_vertex_light_gradient(
-    const model& mesh, const vector<gradient_info>& gradient_data,
-    vector<illumination_info>& illumination_data);
+// Every vertex gathers the weights of its adjacent faces in parallel.
+void compute_vertex_voronoi_area(const mesh_geometry& mesh,
+                                 const vector<gradient_info>& gradient_data,
+                                 const vertex_face_adjacency& adjacency,
+                                 vector<illumination_info>& illumination_data);
 
-void compute_vertex_light_variation_slope(
-    const model& mesh, const vector<gradient_info>& gradient_data,
-    vector<illumination_info>& illumination_data);
+// Only the given vertices are updated.
+void compute_vertex_voronoi_area(const mesh_geometry& mesh,
+                                 const vector<gradient_info>& gradient_data,
+                                 const vertex_face_adjacency& adjacency,
+                                 std::span<const uint32_t> vertices,
+                                 vector<illumination_info>& illumination_data);
 
-void compute_vertex_light_variation_curve(
-    const model& mesh, const vector<gradient_info>& gradient_data,
-    vector<illumination_info>& illumination_data);
+// Unsmoothed light of every vertex without any of its derivatives
+void compute_vertex_light(vec3 light_dir, const mesh_geometry& mesh,
+                          vector<illumination_info>& illumination_data);
+
+// Fused illumination pipeline
+// Computes light, light gradient, light variation and its slope and curve
+// in three parallel sweeps over the vertices and one final normalization.
+// Every vertex gathers the contributions of its adjacent faces. So there are
+// no write conflicts and initialization, accumulation and normalization
+// happen in the same sweep. The maxima are reduced in parallel.
+// Noisy meshes produce many spurious zero crossings of the slope.
+// 'light_smoothing' Jacobi sweeps of area-weighted Laplacian smoothing
+// over the one-ring then filter the light field before differentiation.
+// Each of them costs about as much as a sweep of the light itself.
+// Between the sweeps, 'cancelled' is checked and the computation
+// is aborted with incomplete data if it returns true.
+// Returns the maxima that have been used for the normalization.
+struct illumination_scale {
+  float light_variation{};
+  float light_variation_slope{};
+};
+
+auto compute_illumination(vec3 light_dir,
+                          const mesh_geometry& mesh,
+                          const vector<gradient_info>& gradient_data,
+                          const vertex_face_adjacency& adjacency,
+                          vector<illumination_info>& illumination_data,
+                          size_t light_smoothing = 0,
+                          const std::function<bool()>& cancelled = {})
+    -> illumination_scale;
+
+// Only the vertices of the selected clusters receive valid data.
+// The selection needs three rings around them for the chained derivatives
+// and one more ring for every iteration of the smoothing.
+// Values of these rings are intermediate and must not be relied upon.
+// The maxima of a selection differ from the ones of the full mesh.
+// So a nonzero scale, e.g. of a previous full computation, should be given
+// to normalize the data consistently. Otherwise, the maxima are used.
+auto compute_illumination(vec3 light_dir,
+                          const mesh_geometry& mesh,
+                          const vector<gradient_info>& gradient_data,
+                          const vertex_face_adjacency& adjacency,
+                          const mesh_selection& selection,
+                          vector<illumination_info>& illumination_data,
+                          illumination_scale scale = {},
+                          size_t light_smoothing = 0,
+                          const std::function<bool()>& cancelled = {})
+    -> illumination_scale;
+
+// Segment of a photic extremum line with the light variation at its ends
+struct line_segment {
+  vec3 start;
+  vec3 end;
+  float start_strength;
+  float end_strength;
+};
+
+// Restricts the segment to the part whose linearly interpolated strength
+// reaches the threshold. Returns false if there is no such part.
+inline bool clip_line_segment(line_segment& segment, float threshold) {
+  auto& [p, q, l, m] = segment;
+  if ((l < threshold) && (m < threshold)) return false;
+  if ((l >= threshold) && (m >= threshold)) return true;
+  const auto x = p + (threshold - l) / (m - l) * (q - p);
+  if (l < threshold) {
+    p = x;
+    l = threshold;
+  } else {
+    q = x;
+    m = threshold;
+  }
+  return true;
+}
+
+// Computes the unclipped segment of the photic extremum line
+// that crosses the given face. Returns false if there is none.
+bool face_photic_extremum_line(
+    const mesh_geometry& mesh,
+    const vector<illumination_info>& illumination_data,
+    size_t face,
+    line_segment& segment);
+
+// Extracts the same segments as the geometry shader of the line pass.
+// Instead of discarding fragments, the segments are clipped
+// to the part whose interpolated strength reaches the threshold.
+// Only the first 'face_count' faces of the mesh are processed.
+void extract_photic_extremum_lines(
+    const mesh_geometry& mesh,
+    const vector<illumination_info>& illumination_data,
+    float threshold,
+    vector<line_segment>& segments,
+    size_t face_count);
+
+inline void extract_photic_extremum_lines(
+    const mesh_geometry& mesh,
+    const vector<illumination_info>& illumination_data,
+    float threshold,
+    vector<line_segment>& segments) {
+  extract_photic_extremum_lines(mesh, illumination_data, threshold, segments,
+                                mesh.faces.size());
+}
@@ -1,4 +1,7 @@
 #include "photic_extremum_lines_shader.hpp"
+//
+#include "line_renderer.hpp"
+#include "photic_extremum_lines.hpp"
 
 namespace {
 
@@ -7,6 +10,7 @@ constexpr czstring vertex_shader_text =
 
     "uniform mat4 projection;"
     "uniform mat4 view;"
+    "uniform mat4 model = mat4(1.0);"
     "uniform float shift;"
 
     "layout (location = 0) in vec3 p;"
@@ -16,6 +20,7 @@ constexpr czstring vertex_shader_text =
     "layout (location = 4) in float lv;"
     "layout (location = 5) in float lvs;"
     "layout (location = 6) in float lvc;"
+    "layout (location = 7) in vec3 offset;"
 
     "out vec2 gradient;"
     "out float variation;"
@@ -23,7 +28,8 @@ constexpr czstring vertex_shader_text =
     "out float curve;"
 
     "void main(){"
-    "  gl_Position = projection * (view * vec4(p, 1.0) + vec4(0, 0, shift, 0));"
+    "  vec4 x = model * vec4(p, 1.0) + vec4(offset, 0.0);"
+    "  gl_Position = projection * (view * x + vec4(0, 0, shift, 0));"
     "  gradient = lg;"
     "  variation = lv;"
     "  slope = lvs;"
@@ -103,5 +109,47 @@ auto photic_extremum_lines_shader() -> shader_program {
   vertex_shader vs{vertex_shader_text};
   geometry_shader gs{geometry_shader_text};
   fragment_shader fs{fragment_shader_text};
-  return shader_program{vs, gs, fs};
+  shader_program shader{vs, gs, fs};
+  shader.capture(line_capture_varyings);
+  return shader;
+}
+
+void setup_illumination_locations(const vertex_buffer& buffer,
+                                  const shader_program& shader) {
+  buffer.bind();
+  {
+    const auto location = glGetAttribLocation(shader, "l");
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE,
+                          sizeof(illumination_info),
+                          (void*)offsetof(illumination_info, light));
+  }
+  {
+    const auto location = glGetAttribLocation(shader, "lg");
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, 2, GL_FLOAT, GL_FALSE,
+                          sizeof(illumination_info),
+                          (void*)offsetof(illumination_info, light_gradient));
+  }
+  {
+    const auto location = glGetAttribLocation(shader, "lv");
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(location, 1, GL_FLOAT, GL_FALSE,
+                          sizeof(illumination_info),
+                          (void*)offsetof(illumination_info, light_variation));
+  }
+  {
+    const auto location = glGetAttribLocation(shader, "lvs");
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(
+        location, 1, GL_FLOAT, GL_FALSE, sizeof(illumination_info),
+        (void*)offsetof(illumination_info, light_variation_slope));
+  }
+  {
+    const auto location = glGetAttribLocation(shader, "lvc");
+    glEnableVertexAttribArray(location);
+    glVertexAttribPointer(
+        location, 1, GL_FLOAT, GL_FALSE, sizeof(illumination_info),
+        (void*)offsetof(illumination_info, light_variation_curve));
+  }
 }
@@ -1,4 +1,10 @@
 #pragma once
+#include "buffer.hpp"
 #include "shader.hpp"
 
 auto photic_extremum_lines_shader() -> shader_program;
+
+// Sets up the attributes of the illumination data stored in the given buffer
+// for the currently bound vertex array.
+void setup_illumination_locations(const vertex_buffer& buffer,
+                                  const shader_program& shader);
@@ -0,0 +1,344 @@
+#include "ply_loader.hpp"
+//
+#include <atomic>
+//
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "text_parser.hpp"
+
+using namespace std;
+
+namespace {
+
+enum class ply_type {
+  int8,
+  uint8,
+  int16,
+  uint16,
+  int32,
+  uint32,
+  float32,
+  float64
+};
+
+auto ply_type_from(string_view name) -> ply_type {
+  if ((name == "char") || (name == "int8")) return ply_type::int8;
+  if ((name == "uchar") || (name == "uint8")) return ply_type::uint8;
+  if ((name == "short") || (name == "int16")) return ply_type::int16;
+  if ((name == "ushort") || (name == "uint16")) return ply_type::uint16;
+  if ((name == "int") || (name == "int32")) return ply_type::int32;
+  if ((name == "uint") || (name == "uint32")) return ply_type::uint32;
+  if ((name == "float") || (name == "float32")) return ply_type::float32;
+  if ((name == "double") || (name == "float64")) return ply_type::float64;
+  throw runtime_error("Unknown PLY property type '" + string(name) + "'.");
+}
+
+constexpr auto size_of(ply_type type) -> size_t {
+  switch (type) {
+    case ply_type::int8:
+    case ply_type::uint8:
+      return 1;
+    case ply_type::int16:
+    case ply_type::uint16:
+      return 2;
+    case ply_type::int32:
+    case ply_type::uint32:
+    case ply_type::float32:
+      return 4;
+    case ply_type::float64:
+      return 8;
+  }
+  return 0;
+}
+
+template <typename T>
+inline auto load(const char* data, bool swap_bytes) noexcept -> T {
+  using bits = std::conditional_t<
+      sizeof(T) == 1, uint8_t,
+      std::conditional_t<sizeof(T) == 2, uint16_t,
+                         std::conditional_t<sizeof(T) == 4, uint32_t,
+                                            uint64_t>>>;
+  bits x;
+  std::memcpy(&x, data, sizeof(x));
+  if (swap_bytes) x = std::byteswap(x);
+  return bit_cast<T>(x);
+}
+
+// Reads a value of the given type and converts it to 'T'.
+template <typename T>
+inline auto read(const char* data, ply_type type, bool swap_bytes) noexcept
+    -> T {
+  switch (type) {
+    case ply_type::int8:
+      return T(load<int8_t>(data, swap_bytes));
+    case ply_type::uint8:
+      return T(load<uint8_t>(data, swap_bytes));
+    case ply_type::int16:
+      return T(load<int16_t>(data, swap_bytes));
+    case ply_type::uint16:
+      return T(load<uint16_t>(data, swap_bytes));
+    case ply_type::int32:
+      return T(load<int32_t>(data, swap_bytes));
+    case ply_type::uint32:
+      return T(load<uint32_t>(data, swap_bytes));
+    case ply_type::float32:
+      return T(load<float>(data, swap_bytes));
+    case ply_type::float64:
+      return T(load<double>(data, swap_bytes));
+  }
+  return T{};
+}
+
+struct ply_property {
+  string name{};
+  ply_type type{};
+  bool is_list = false;
+  ply_type count_type{};
+};
+
+struct ply_element {
+  string name{};
+  size_t count{};
+  vector<ply_property> properties{};
+
+  bool has_lists() const noexcept {
+    return any_of(begin(properties), end(properties),
+                  [](const auto& p) { return p.is_list; });
+  }
+
+  // Only meaningful for elements without list properties.
+  auto stride() const noexcept -> size_t {
+    size_t result = 0;
+    for (const auto& p : properties) result += size_of(p.type);
+    return result;
+  }
+
+  // Size of the record starting at the given position.
+  auto record_size(const char* data, bool swap_bytes) const noexcept
+      -> size_t {
+    size_t result = 0;
+    for (const auto& p : properties) {
+      if (!p.is_list) {
+        result += size_of(p.type);
+        continue;
+      }
+      const auto n = read<size_t>(data + result, p.count_type, swap_bytes);
+      result += size_of(p.count_type) + n * size_of(p.type);
+    }
+    return result;
+  }
+};
+
+struct ply_header {
+  vector<ply_element> elements{};
+  bool swap_bytes = false;
+  size_t size = 0;  // in bytes
+};
+
+auto parse_header(string_view text) -> ply_header {
+  const auto end = text.find("end_header");
+  if (!text.starts_with("ply") || (end == string_view::npos))
+    throw runtime_error("Failed to parse PLY header.");
+
+  ply_header header{};
+  text_parser in{text.substr(0, end)};
+  in.skip_line();
+  while (!in.done()) {
+    const auto keyword = in.word();
+    if (keyword == "format") {
+      const auto format = in.word();
+      if (format == "binary_little_endian")
+        header.swap_bytes = (std::endian::native != std::endian::little);
+      else if (format == "binary_big_endian")
+        header.swap_bytes = (std::endian::native != std::endian::big);
+      else
+        throw runtime_error("Only binary PLY files are supported.");
+    } else if (keyword == "element") {
+      ply_element element{string(in.word())};
+      if (!in.parse(element.count))
+        throw runtime_error("Failed to parse PLY element count.");
+      header.elements.push_back(std::move(element));
+    } else if (keyword == "property") {
+      if (header.elements.empty())
+        throw runtime_error("PLY property does not belong to an element.");
+      ply_property property{};
+      auto type = in.word();
+      if (type == "list") {
+        property.is_list = true;
+        property.count_type = ply_type_from(in.word());
+        type = in.word();
+      }
+      property.type = ply_type_from(type);
+      property.name = in.word();
+      header.elements.back().properties.push_back(std::move(property));
+    }
+    in.skip_line();
+  }
+
+  // Binary data starts right after the line containing 'end_header'.
+  header.size = text.find('\n', end);
+  if (header.size == string_view::npos)
+    throw runtime_error("Failed to parse PLY header.");
+  ++header.size;
+  return header;
+}
+
+void load_vertices(const ply_element& element,
+                   const char* data,
+                   bool swap_bytes,
+                   mesh_geometry& mesh) {
+  if (element.has_lists())
+    throw runtime_error("PLY vertices with list properties are not supported.");
+  size_t offset[3]{};
+  ply_type type[3]{};
+  bool found[3]{};
+  size_t position = 0;
+  for (const auto& p : element.properties) {
+    for (size_t i = 0; i < 3; ++i) {
+      if (p.name != "xyz"sv.substr(i, 1)) continue;
+      offset[i] = position;
+      type[i] = p.type;
+      found[i] = true;
+    }
+    position += size_of(p.type);
+  }
+  if (!found[0] || !found[1] || !found[2])
+    throw runtime_error("PLY vertices have no position.");
+
+  const auto stride = element.stride();
+  mesh.vertices.resize(element.count);
+  parallel_for_blocks(0, element.count, [&](size_t first, size_t last, auto) {
+    for (auto i = first; i < last; ++i) {
+      const auto record = data + i * stride;
+      auto& v = mesh.vertices[i];
+      for (size_t j = 0; j < 3; ++j)
+        v.position[j] = read<float>(record + offset[j], type[j], swap_bytes);
+      v.normal = {};
+    }
+  });
+}
+
+// Returns the number of parsed bytes.
+auto load_faces(const ply_element& element,
+                const char* data,
+                size_t size,
+                bool swap_bytes,
+                mesh_geometry& mesh) -> size_t {
+  const auto it =
+      find_if(begin(element.properties), end(element.properties),
+              [](const auto& p) {
+                return p.is_list && ((p.name == "vertex_indices") ||
+                                     (p.name == "vertex_index"));
+              });
+  if (it == end(element.properties))
+    throw runtime_error("PLY faces have no vertex indices.");
+  const auto& indices = *it;
+
+  // Offset of the vertex index list inside a face record
+  // and size of all other properties which must not be lists.
+  size_t list_offset = 0;
+  size_t others = 0;
+  for (const auto& p : element.properties) {
+    if (&p == &indices) {
+      list_offset = others;
+      continue;
+    }
+    if (p.is_list)
+      throw runtime_error("PLY faces with further lists are not supported.");
+    others += size_of(p.type);
+  }
+
+  const auto index_size = size_of(indices.type);
+  const auto count_size = size_of(indices.count_type);
+  const auto read_index = [&](const char* p) {
+    return read<uint32_t>(p, indices.type, swap_bytes);
+  };
+
+  // In the common case of pure triangle meshes, every record has
+  // the same size and all faces can be parsed in parallel.
+  const auto stride = others + count_size + 3 * index_size;
+  if (element.count * stride <= size) {
+    std::atomic<bool> triangles_only{true};
+    mesh.faces.resize(element.count);
+    parallel_for_blocks(0, element.count, [&](size_t first, size_t last,
+                                              auto) {
+      for (auto i = first; i < last; ++i) {
+        const auto list = data + i * stride + list_offset;
+        if (read<size_t>(list, indices.count_type, swap_bytes) != 3) {
+          triangles_only = false;
+          return;
+        }
+        for (size_t j = 0; j < 3; ++j)
+          mesh.faces[i][j] = read_index(list + count_size + j * index_size);
+      }
+    });
+    if (triangles_only) return element.count * stride;
+    mesh.faces.clear();
+  }
+
+  // Otherwise, records have to be visited one after another.
+  size_t offset = 0;
+  for (size_t i = 0; i < element.count; ++i) {
+    if (offset + others + count_size > size)
+      throw runtime_error("PLY file is truncated.");
+    const auto list = data + offset + list_offset;
+    const auto n = read<size_t>(list, indices.count_type, swap_bytes);
+    if (offset + others + count_size + n * index_size > size)
+      throw runtime_error("PLY file is truncated.");
+    const auto index = [&](size_t j) {
+      return read_index(list + count_size + j * index_size);
+    };
+    for (size_t j = 2; j < n; ++j)
+      mesh.faces.push_back({index(0), index(j - 1), index(j)});
+    offset += others + count_size + n * index_size;
+  }
+  return offset;
+}
+
+}  // namespace
+
+void load_ply(czstring file_path, mesh_geometry& mesh) {
+  const mapped_file file{file_path};
+  load_ply(file.view(), mesh);
+}
+
+void load_ply(string_view content, mesh_geometry& mesh) {
+  const auto header = parse_header(content);
+
+  auto data = content.data() + header.size;
+  auto size = content.size() - header.size;
+  for (const auto& element : header.elements) {
+    if (element.name == "vertex") {
+      if (element.count * element.stride() > size)
+        throw runtime_error("PLY file is truncated.");
+      load_vertices(element, data, header.swap_bytes, mesh);
+      data += element.count * element.stride();
+      size -= element.count * element.stride();
+    } else if (element.name == "face") {
+      const auto bytes =
+          load_faces(element, data, size, header.swap_bytes, mesh);
+      data += bytes;
+      size -= bytes;
+    } else if (!element.has_lists()) {
+      const auto bytes = element.count * element.stride();
+      if (bytes > size) throw runtime_error("PLY file is truncated.");
+      data += bytes;
+      size -= bytes;
+    } else {
+      for (size_t i = 0; i < element.count; ++i) {
+        const auto bytes = element.record_size(data, header.swap_bytes);
+        if (bytes > size) throw runtime_error("PLY file is truncated.");
+        data += bytes;
+        size -= bytes;
+      }
+    }
+  }
+
+  const auto vertex_count = mesh.vertices.size();
+  for (const auto& f : mesh.faces)
+    if ((f[0] >= vertex_count) || (f[1] >= vertex_count) ||
+        (f[2] >= vertex_count))
+      throw runtime_error("PLY face index is out of range.");
+
+  compute_vertex_normals(mesh);
+}
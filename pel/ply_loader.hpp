@@ -0,0 +1,10 @@
+#pragma once
+#include "model.hpp"
+#include "utility.hpp"
+
+// Loads the vertex positions and faces of a binary PLY file
+// in little or big endian format. Vertices and faces are parsed
+// in parallel. Faces already reference shared vertices and therefore
+// no welding is needed. Polygons are triangulated as fans.
+void load_ply(czstring file_path, mesh_geometry& mesh);
+void load_ply(std::string_view content, mesh_geometry& mesh);
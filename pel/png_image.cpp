@@ -0,0 +1,51 @@
+#include "png_image.hpp"
+//
+#include <csetjmp>
+#include <cstdio>
+#include <memory>
+//
+#include <png.h>
+
+using namespace std;
+
+void write_png(czstring file_path,
+               int width,
+               int height,
+               std::span<const uint8_t> pixels) {
+  if (pixels.size() < size_t(width) * height * 4)
+    throw runtime_error("Failed to write PNG file '"s + file_path +
+                        "'. Not enough pixel data.");
+
+  unique_ptr<FILE, decltype(&fclose)> file{fopen(file_path, "wb"), &fclose};
+  if (!file)
+    throw runtime_error("Failed to open file '"s + file_path +
+                        "' for writing.");
+
+  auto png =
+      png_create_write_struct(PNG_LIBPNG_VER_STRING, nullptr, nullptr, nullptr);
+  auto info = png ? png_create_info_struct(png) : nullptr;
+  if (!info) {
+    png_destroy_write_struct(&png, nullptr);
+    throw runtime_error("Failed to create PNG write structure.");
+  }
+
+  vector<png_const_bytep> rows(height);
+  for (int i = 0; i < height; ++i)
+    rows[i] = pixels.data() + size_t(height - 1 - i) * width * 4;
+
+  // libpng reports errors by jumping back to this point.
+  // No objects with non-trivial destructors may be created in between.
+  if (setjmp(png_jmpbuf(png))) {
+    png_destroy_write_struct(&png, &info);
+    throw runtime_error("Failed to write PNG file '"s + file_path + "'.");
+  }
+  png_init_io(png, file.get());
+  png_set_IHDR(png, info, width, height, 8, PNG_COLOR_TYPE_RGBA,
+               PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT,
+               PNG_FILTER_TYPE_DEFAULT);
+  png_set_compression_level(png, 1);
+  png_write_info(png, info);
+  png_write_rows(png, const_cast<png_bytepp>(rows.data()), height);
+  png_write_end(png, nullptr);
+  png_destroy_write_struct(&png, &info);
+}
@@ -0,0 +1,10 @@
+#pragma once
+#include "utility.hpp"
+
+// Writes 8-bit RGBA pixels to a PNG file.
+// Rows are given bottom-up as they are returned by 'glReadPixels'.
+// Fast compression is used because images are written in bulk.
+void write_png(czstring file_path,
+               int width,
+               int height,
+               std::span<const uint8_t> pixels);
@@ -0,0 +1,135 @@
+#include "polylines.hpp"
+//
+#include <optional>
+
+using namespace std;
+
+namespace {
+
+struct point_key {
+  int64_t x, y, z;
+  bool operator==(const point_key&) const noexcept = default;
+};
+
+struct point_key_hash {
+  auto operator()(const point_key& k) const noexcept -> size_t {
+    return (uint64_t(k.x) * 73856093) ^ (uint64_t(k.y) * 19349663) ^
+           (uint64_t(k.z) * 83492791);
+  }
+};
+
+}  // namespace
+
+auto chain_line_segments(const vector<line_segment>& segments, float tolerance)
+    -> vector<polyline> {
+  // Ends are identified by the cell of a grid with the given tolerance.
+  const auto key = [tolerance](const vec3& p) {
+    return point_key{int64_t(std::floor(p.x / tolerance + 0.5f)),
+                     int64_t(std::floor(p.y / tolerance + 0.5f)),
+                     int64_t(std::floor(p.z / tolerance + 0.5f))};
+  };
+  // Every end is given by '2 * segment + side'.
+  std::unordered_map<point_key, vector<uint32_t>, point_key_hash> ends{};
+  ends.reserve(2 * segments.size());
+  for (uint32_t i = 0; i < segments.size(); ++i) {
+    ends[key(segments[i].start)].push_back(2 * i);
+    ends[key(segments[i].end)].push_back(2 * i + 1);
+  }
+
+  const auto point = [&](uint32_t end) -> const vec3& {
+    return (end & 1) ? segments[end / 2].end : segments[end / 2].start;
+  };
+  const auto strength = [&](uint32_t end) {
+    return (end & 1) ? segments[end / 2].end_strength
+                     : segments[end / 2].start_strength;
+  };
+  // Returns the other segment end at the same point if it is unique.
+  const auto next = [&](uint32_t end) -> optional<uint32_t> {
+    const auto& shared = ends[key(point(end))];
+    if (shared.size() != 2) return nullopt;
+    return (shared[0] == end) ? shared[1] : shared[0];
+  };
+
+  vector<bool> visited(segments.size(), false);
+  vector<polyline> lines{};
+  // Walks from the given segment end to the other end and beyond.
+  const auto walk = [&](polyline& line, uint32_t end) {
+    while (true) {
+      visited[end / 2] = true;
+      const auto other = end ^ 1;
+      line.points.push_back(point(other));
+      line.strengths.push_back(strength(other));
+      const auto n = next(other);
+      if (!n || visited[*n / 2]) return;
+      end = *n;
+    }
+  };
+  // Open chains are started at their ends first.
+  // Afterwards, only closed loops remain.
+  for (const auto skip_closed : {true, false}) {
+    for (uint32_t i = 0; i < segments.size(); ++i) {
+      if (visited[i]) continue;
+      const auto start = 2 * i;
+      if (skip_closed && next(start) && next(start + 1)) continue;
+      // Begin at the side without continuation.
+      const auto first = next(start) ? start + 1 : start;
+      auto& line = lines.emplace_back();
+      line.points.push_back(point(first));
+      line.strengths.push_back(strength(first));
+      walk(line, first);
+    }
+  }
+  return lines;
+}
+
+void write_obj_lines(czstring file_path, const vector<polyline>& lines) {
+  std::ofstream file{file_path};
+  if (!file) throw runtime_error("Failed to open given OBJ file for writing.");
+  file << "# photic extremum lines\n";
+  for (const auto& line : lines)
+    for (const auto& p : line.points)
+      file << "v " << p.x << ' ' << p.y << ' ' << p.z << '\n';
+  size_t offset = 1;
+  for (const auto& line : lines) {
+    file << 'l';
+    for (size_t i = 0; i < line.points.size(); ++i)
+      file << ' ' << offset + i;
+    file << '\n';
+    offset += line.points.size();
+  }
+}
+
+void write_svg_lines(czstring file_path,
+                     const vector<polyline>& lines,
+                     const camera& cam,
+                     float threshold) {
+  std::ofstream file{file_path};
+  if (!file) throw runtime_error("Failed to open given SVG file for writing.");
+  const auto width = cam.screen_width();
+  const auto height = cam.screen_height();
+  const auto transform = cam.projection_matrix() * cam.view_matrix();
+  file << "<svg xmlns=\"http://www.w3.org/2000/svg\" width=\"" << width
+       << "\" height=\"" << height << "\" viewBox=\"0 0 " << width << ' '
+       << height << "\">\n"
+       << "<rect width=\"100%\" height=\"100%\" fill=\"white\"/>\n"
+       << "<g fill=\"none\" stroke=\"black\" stroke-width=\"1.25\""
+          " stroke-linecap=\"round\" stroke-linejoin=\"round\">\n";
+  for (const auto& line : lines) {
+    float strength = 0;
+    for (auto s : line.strengths) strength += s;
+    strength /= line.strengths.size();
+    constexpr float scale = 0.7f;
+    const auto alpha = std::clamp(
+        scale * (strength - threshold) / (1 - threshold) + 1 - scale, 0.0f,
+        1.0f);
+    file << "<polyline stroke-opacity=\"" << alpha << "\" points=\"";
+    for (const auto& p : line.points) {
+      const auto x = transform * vec4{p, 1};
+      // Normalized device coordinates with the y-axis pointing down
+      file << (x.x / x.w + 1) / 2 * width << ','
+           << (1 - x.y / x.w) / 2 * height << ' ';
+    }
+    file << "\"/>\n";
+  }
+  file << "</g>\n</svg>\n";
+}
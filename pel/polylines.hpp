@@ -0,0 +1,26 @@
+#pragma once
+#include "camera.hpp"
+#include "photic_extremum_lines.hpp"
+#include "utility.hpp"
+
+struct polyline {
+  vector<vec3> points{};
+  vector<float> strengths{};
+};
+
+// Joins segments whose ends coincide up to the given tolerance.
+// Chains are only continued through points shared by exactly two
+// segments. Branching points therefore start new polylines.
+auto chain_line_segments(const vector<line_segment>& segments, float tolerance)
+    -> vector<polyline>;
+
+// Writes the polylines as line elements of a Wavefront OBJ file.
+void write_obj_lines(czstring file_path, const vector<polyline>& lines);
+
+// Writes the polylines projected by the camera as an SVG image of its
+// screen size. Like in the line shader, the opacity of every line grows
+// with its mean strength above the threshold.
+void write_svg_lines(czstring file_path,
+                     const vector<polyline>& lines,
+                     const camera& cam,
+                     float threshold);
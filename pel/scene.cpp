@@ -0,0 +1,277 @@
+#include "scene.hpp"
+//
+#include <filesystem>
+#include <map>
+//
+#include "bulk_reader.hpp"
+#include "mapped_file.hpp"
+#include "model_loader.hpp"
+#include "photic_extremum_lines_shader.hpp"
+#include "task_scheduler.hpp"
+#include "text_parser.hpp"
+
+using namespace std;
+
+auto load_scene_description(czstring file_path) -> scene_description {
+  const mapped_file file{file_path};
+  const auto directory = filesystem::path{file_path}.parent_path();
+  scene_description result{};
+  vector<string> paths{};
+  unordered_map<string, uint32_t> part_indices{};
+
+  text_parser in{file.view()};
+  while (!in.done()) {
+    if (in.line_end()) {
+      in.skip_line();
+      continue;
+    }
+    const auto keyword = in.word();
+    if (keyword.starts_with('#')) {
+      in.skip_line();
+      continue;
+    }
+    if (keyword != "instance")
+      throw runtime_error("Unknown scene keyword '" + string(keyword) + "'.");
+
+    // Absolute paths replace the directory.
+    const auto path =
+        (directory / filesystem::path{in.word()}).lexically_normal().string();
+    vec3 offset;
+    vec3 angles{};
+    float scaling = 1;
+    if (!in.parse(offset) ||
+        (!in.line_end() && (!in.parse(angles) ||
+                            (!in.line_end() && !in.parse(scaling)))) ||
+        !in.line_end())
+      throw runtime_error("Failed to parse scene instance of '" + path +
+                          "'.");
+    in.skip_line();
+
+    const auto [it, inserted] = part_indices.try_emplace(path, paths.size());
+    if (inserted) paths.push_back(path);
+    auto transform = translate(mat4{1.0f}, offset);
+    transform = rotate(transform, glm::radians(angles.z), vec3{0, 0, 1});
+    transform = rotate(transform, glm::radians(angles.y), vec3{0, 1, 0});
+    transform = rotate(transform, glm::radians(angles.x), vec3{1, 0, 0});
+    transform = scale(transform, vec3{scaling});
+    result.instances.push_back({it->second, transform});
+  }
+  if (result.instances.empty())
+    throw runtime_error("Scene does not contain any instances.");
+
+  // Parts are parsed and prepared as soon as their files have been read.
+  result.parts.resize(paths.size());
+  read_files(paths, [&](size_t i, string_view content) {
+    mesh_geometry mesh{};
+    load_mesh_data(paths[i].c_str(), content, mesh);
+    result.parts[i] = make_shared<const prepared_mesh>(std::move(mesh));
+  });
+  return result;
+}
+
+scene::scene(scene_description description)
+    : instance_count{description.instances.size()} {
+  parts.reserve(description.parts.size());
+  vector<pair<vec3, vec3>> part_bounds{};
+  for (auto& mesh : description.parts) {
+    auto& x = parts.emplace_back();
+    x.mesh = std::move(mesh);
+    const auto& geometry = x.mesh->geometry;
+    x.vertex_data.allocate(
+        geometry.vertices.size() * sizeof(geometry.vertices[0]),
+        geometry.vertices.data(), GL_STATIC_DRAW);
+    // Element buffers are bound to vertex arrays. But
+    // 'allocate' uploads their data through another target.
+    x.face_data.allocate(geometry.faces.size() * sizeof(geometry.faces[0]),
+                         geometry.faces.data(), GL_STATIC_DRAW);
+
+    vec3 pmin = geometry.vertices[0].position;
+    vec3 pmax = pmin;
+    for (const auto& v : geometry.vertices) {
+      pmin = min(pmin, v.position);
+      pmax = max(pmax, v.position);
+    }
+    part_bounds.push_back({pmin, pmax});
+  }
+
+  // Instances are grouped by their part and their linear transform.
+  map<pair<uint32_t, array<float, 16>>, size_t> group_indices{};
+  aabb_min = vec3{std::numeric_limits<float>::infinity()};
+  aabb_max = -aabb_min;
+  for (const auto& instance : description.instances) {
+    auto linear = instance.transform;
+    linear[3] = vec4{0, 0, 0, 1};
+    pair<uint32_t, array<float, 16>> key{instance.part, {}};
+    memcpy(key.second.data(), value_ptr(linear), sizeof(key.second));
+    const auto [it, inserted] = group_indices.try_emplace(key, groups.size());
+    if (inserted) {
+      auto& g = groups.emplace_back();
+      g.part = instance.part;
+      g.transform = linear;
+    }
+    groups[it->second].offsets.push_back(vec3{instance.transform[3]});
+
+    const auto [pmin, pmax] = part_bounds[instance.part];
+    for (int i = 0; i < 8; ++i) {
+      const auto corner = vec3{(i & 1) ? pmax.x : pmin.x,
+                               (i & 2) ? pmax.y : pmin.y,
+                               (i & 4) ? pmax.z : pmin.z};
+      const auto p = vec3{instance.transform * vec4{corner, 1}};
+      aabb_min = min(aabb_min, p);
+      aabb_max = max(aabb_max, p);
+    }
+  }
+
+  vector<vector<illumination_info>> data{};
+  for (auto& g : groups) {
+    const auto& mesh = *parts[g.part].mesh;
+    g.offset_data.allocate(g.offsets.size() * sizeof(vec3), g.offsets.data(),
+                           GL_STATIC_DRAW);
+    // The buffer is only allocated here.
+    // Illumination updates overwrite its content.
+    g.illumination_data.allocate(
+        mesh.illumination_data.size() * sizeof(illumination_info), nullptr,
+        GL_DYNAMIC_DRAW);
+    data.push_back(mesh.illumination_data);
+  }
+  results.reset(data);
+  thread = jthread{[this](stop_token stop) { run(stop); }};
+}
+
+void scene::setup(const shader_program& shader) {
+  for (auto& g : groups) {
+    const auto& x = parts[g.part];
+    g.handle.bind();
+    x.vertex_data.bind();
+    x.face_data.bind();
+    {
+      const auto location = glGetAttribLocation(shader, "p");
+      glEnableVertexAttribArray(location);
+      glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE,
+                            sizeof(mesh_geometry::vertex),
+                            (void*)offsetof(mesh_geometry::vertex, position));
+    }
+    {
+      const auto location = glGetAttribLocation(shader, "n");
+      glEnableVertexAttribArray(location);
+      glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE,
+                            sizeof(mesh_geometry::vertex),
+                            (void*)offsetof(mesh_geometry::vertex, normal));
+    }
+    setup_illumination_locations(g.illumination_data, shader);
+    // Every instance advances the offset once.
+    g.offset_data.bind();
+    {
+      const auto location = glGetAttribLocation(shader, "offset");
+      glEnableVertexAttribArray(location);
+      glVertexAttribPointer(location, 3, GL_FLOAT, GL_FALSE, sizeof(vec3),
+                            nullptr);
+      glVertexAttribDivisor(location, 1);
+    }
+  }
+}
+
+void scene::stop() {
+  if (!thread.joinable()) return;
+  thread.request_stop();
+  thread.join();
+}
+
+void scene::request(vec3 light_dir) {
+  {
+    scoped_lock lock{mutex};
+    this->light_dir = light_dir;
+    ++generation;
+  }
+  new_request.notify_one();
+}
+
+void scene::set_light_smoothing(size_t iterations) {
+  scoped_lock lock{mutex};
+  light_smoothing = iterations;
+}
+
+bool scene::update() {
+  if (!results.fetch()) return false;
+  const auto& data = results.front();
+  for (size_t i = 0; i < groups.size(); ++i) {
+    groups[i].illumination_data.bind();
+    glBufferSubData(GL_ARRAY_BUFFER, 0,
+                    data[i].size() * sizeof(illumination_info),
+                    data[i].data());
+  }
+  return true;
+}
+
+void scene::render(shader_program& shader) {
+  shader.bind();
+  draw(shader);
+}
+
+void scene::draw(shader_program& shader) {
+  for (const auto& g : groups) {
+    shader.set("model", g.transform);
+    g.handle.bind();
+    glDrawElementsInstanced(GL_TRIANGLES,
+                            3 * parts[g.part].mesh->geometry.faces.size(),
+                            GL_UNSIGNED_INT, nullptr, g.offsets.size());
+  }
+  shader.set("model", mat4{1.0f});
+}
+
+auto scene::stats() const noexcept -> statistics {
+  statistics result{};
+  result.parts = parts.size();
+  result.instances = instance_count;
+  result.groups = groups.size();
+  for (const auto& x : parts) result.prepared_memory += x.mesh->memory_size();
+  for (const auto& g : groups) {
+    const auto& mesh = *parts[g.part].mesh;
+    result.faces += g.offsets.size() * mesh.geometry.faces.size();
+    result.illuminated_faces += mesh.geometry.faces.size();
+    result.unshared_memory += g.offsets.size() * mesh.memory_size();
+  }
+  return result;
+}
+
+void scene::run(stop_token stop) {
+  uint64_t done = 0;
+  while (true) {
+    vec3 dir;
+    uint64_t current;
+    size_t smoothing;
+    {
+      unique_lock lock{mutex};
+      if (!new_request.wait(lock, stop, [&] { return generation != done; }))
+        return;
+      dir = light_dir;
+      current = generation;
+      smoothing = light_smoothing;
+    }
+    done = current;
+
+    const auto stale = [&] {
+      return stop.stop_requested() ||
+             (generation.load(memory_order_relaxed) != current);
+    };
+
+    // Every group is one task. Large parts are further split
+    // by the parallel loops of the illumination pipeline.
+    auto& data = results.back();
+    task_group tasks{};
+    for (size_t i = 0; i < groups.size(); ++i)
+      tasks.run([&, i] {
+        const auto& g = groups[i];
+        const auto& mesh = *parts[g.part].mesh;
+        // The normals of the part are rotated by the transform.
+        // So the inverse rotation brings the light into its coordinates.
+        const auto local_dir =
+            normalize(transpose(glm::mat3{g.transform}) * dir);
+        compute_illumination(local_dir, mesh.geometry, mesh.gradient_data,
+                             mesh.adjacency, data[i], smoothing, stale);
+      });
+    tasks.wait();
+    if (stale()) continue;
+    results.publish();
+  }
+}
@@ -0,0 +1,125 @@
+#pragma once
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+//
+#include "buffer.hpp"
+#include "mesh_cache.hpp"
+#include "shader.hpp"
+#include "triple_buffer.hpp"
+#include "utility.hpp"
+#include "vertex_array.hpp"
+
+// Parts and instances of an assembly
+// Every part is a prepared mesh that is shared by all of its instances.
+struct scene_description {
+  struct instance {
+    uint32_t part{};
+    // Rotation and uniform scale followed by a translation
+    mat4 transform{1.0f};
+  };
+
+  vector<std::shared_ptr<const prepared_mesh>> parts{};
+  vector<instance> instances{};
+};
+
+// Reads a scene file whose lines place instances of mesh files.
+//   instance <mesh file> <x> <y> <z> [<angle x> <angle y> <angle z> [<scale>]]
+// Angles are given in degrees and applied in the order x, y, z.
+// Relative paths refer to the directory of the scene file.
+// Lines starting with '#' are comments.
+// Every mesh file is only loaded and prepared once.
+// Different files are read asynchronously and prepared concurrently.
+auto load_scene_description(czstring file_path) -> scene_description;
+
+// GPU buffers and illumination of an assembly
+// Instances of the same part with the same rotation and scale form a group.
+// The light is directional. So the instances of a group share their
+// illumination data and are drawn by one instanced call per shader.
+// The illumination data of all groups is computed as one batch of tasks
+// on a thread of its own. Like in the illumination worker, newer requests
+// cancel older ones and results are published through a triple buffer.
+class scene {
+ public:
+  struct statistics {
+    size_t parts{};
+    size_t instances{};
+    size_t groups{};
+    size_t faces{};
+    size_t illuminated_faces{};
+    // Prepared data of the parts with and without sharing
+    size_t prepared_memory{};
+    size_t unshared_memory{};
+  };
+
+  explicit scene(scene_description description);
+  ~scene() { stop(); }
+
+  // Copying is not allowed.
+  scene(const scene&) = delete;
+  scene& operator=(const scene&) = delete;
+
+  // For now, moving is not allowed.
+  scene(scene&&) = delete;
+  scene& operator=(scene&&) = delete;
+
+  // Sets up the attributes of all groups for the given shader.
+  void setup(const shader_program& shader);
+
+  void request(vec3 light_dir);
+  void set_light_smoothing(size_t iterations);
+
+  // Uploads the newest illumination data if there is any.
+  // Returns true if the data has changed.
+  bool update();
+
+  // Draws all groups with the given shader. Afterwards,
+  // its model transform is reset to the identity.
+  void render(shader_program& shader);
+  // Like 'render' but the shader must already be bound,
+  // e.g. while its output is captured.
+  void draw(shader_program& shader);
+
+  auto bounds() const noexcept -> std::pair<vec3, vec3> {
+    return {aabb_min, aabb_max};
+  }
+  auto stats() const noexcept -> statistics;
+
+ private:
+  struct part {
+    std::shared_ptr<const prepared_mesh> mesh{};
+    vertex_buffer vertex_data{};
+    element_buffer face_data{};
+  };
+
+  struct group {
+    uint32_t part{};
+    // Rotation and scale shared by all instances
+    mat4 transform{1.0f};
+    vector<vec3> offsets{};
+    vertex_buffer offset_data{};
+    vertex_buffer illumination_data{};
+    vertex_array handle{};
+  };
+
+  void stop();
+  void run(std::stop_token stop);
+
+  vector<part> parts{};
+  vector<group> groups{};
+  size_t instance_count{};
+  vec3 aabb_min{};
+  vec3 aabb_max{};
+
+  // Illumination data of every group
+  triple_buffer<vector<vector<illumination_info>>> results{};
+
+  std::mutex mutex{};
+  std::condition_variable_any new_request{};
+  vec3 light_dir{};
+  size_t light_smoothing{};
+  std::atomic<uint64_t> generation{0};
+
+  std::jthread thread{};
+};
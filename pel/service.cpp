@@ -0,0 +1,155 @@
+#include "service.hpp"
+//
+#include <sstream>
+//
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+//
+#include "memory_usage.hpp"
+#include "thread_pool.hpp"
+
+using namespace std;
+
+namespace {
+
+// We use this class for RAII functionality and exception safety.
+class file_descriptor {
+ public:
+  explicit file_descriptor(int fd) noexcept : fd{fd} {}
+  ~file_descriptor() {
+    if (fd >= 0) ::close(fd);
+  }
+
+  // Copying is not allowed.
+  file_descriptor(const file_descriptor&) = delete;
+  file_descriptor& operator=(const file_descriptor&) = delete;
+
+  // Moving
+  file_descriptor(file_descriptor&& x) noexcept : fd{x.fd} { x.fd = -1; }
+  file_descriptor& operator=(file_descriptor&& x) noexcept {
+    swap(fd, x.fd);
+    return *this;
+  }
+
+  operator int() const noexcept { return fd; }
+
+ private:
+  int fd = -1;
+};
+
+bool send_all(int fd, std::string_view data) {
+  while (!data.empty()) {
+    // Clients that closed their connection must not terminate the service.
+    const auto n = ::send(fd, data.data(), data.size(), MSG_NOSIGNAL);
+    if (n <= 0) return false;
+    data.remove_prefix(n);
+  }
+  return true;
+}
+
+void serve_connection(mesh_cache& cache, file_descriptor connection) {
+  string buffer{};
+  char chunk[4096];
+  while (true) {
+    const auto n = ::recv(connection, chunk, sizeof(chunk), 0);
+    if (n <= 0) return;
+    buffer.append(chunk, n);
+    size_t first = 0;
+    for (auto last = buffer.find('\n'); last != string::npos;
+         last = buffer.find('\n', first)) {
+      const auto answer = answer_request(
+          cache, std::string_view{buffer}.substr(first, last - first));
+      if (!send_all(connection, answer) || !send_all(connection, "\n"))
+        return;
+      first = last + 1;
+    }
+    buffer.erase(0, first);
+  }
+}
+
+}  // namespace
+
+auto answer_request(mesh_cache& cache, std::string_view request) -> string try {
+  std::istringstream input{string{request}};
+  string command{};
+  input >> command;
+
+  std::ostringstream output{};
+  if (command == "stats") {
+    const auto stats = cache.stats();
+    output << "ok meshes=" << stats.meshes << " memory=" << stats.memory
+           << " hits=" << stats.hits << " misses=" << stats.misses;
+    return output.str();
+  }
+
+  if (command == "lines") {
+    vec3 light_dir;
+    float threshold;
+    if (!(input >> light_dir.x >> light_dir.y >> light_dir.z >> threshold))
+      throw runtime_error("Invalid arguments.");
+    string path{};
+    getline(input >> ws, path);
+    if (path.empty()) throw runtime_error("Missing mesh file path.");
+    if (length(light_dir) == 0) throw runtime_error("Invalid light direction.");
+
+    const auto mesh = cache.get(path);
+    // The prepared data stays untouched such that it can be shared.
+    auto illumination_data = mesh->illumination_data;
+    compute_illumination(normalize(light_dir), mesh->geometry,
+                         mesh->gradient_data, mesh->adjacency,
+                         illumination_data);
+    vector<line_segment> segments{};
+    extract_photic_extremum_lines(mesh->geometry, illumination_data,
+                                  threshold, segments);
+
+    output << "ok " << segments.size();
+    for (const auto& s : segments)
+      output << '\n'
+             << s.start.x << ' ' << s.start.y << ' ' << s.start.z << ' '
+             << s.end.x << ' ' << s.end.y << ' ' << s.end.z << ' '
+             << s.start_strength << ' ' << s.end_strength;
+    return output.str();
+  }
+
+  throw runtime_error("Unknown command '" + command + "'.");
+} catch (const exception& e) {
+  return string{"error "} + e.what();
+}
+
+void run_service(const service_options& options) {
+  file_descriptor server{::socket(AF_UNIX, SOCK_STREAM, 0)};
+  if (server < 0) throw runtime_error("Failed to create socket.");
+
+  sockaddr_un address{};
+  address.sun_family = AF_UNIX;
+  if (options.socket_path.size() >= sizeof(address.sun_path))
+    throw runtime_error("Socket path is too long.");
+  std::strcpy(address.sun_path, options.socket_path.c_str());
+  // A socket file of a previous run would let 'bind' fail.
+  ::unlink(options.socket_path.c_str());
+  if (::bind(server, reinterpret_cast<const sockaddr*>(&address),
+             sizeof(address)) < 0)
+    throw runtime_error("Failed to bind socket to '" + options.socket_path +
+                        "'.");
+  if (::listen(server, SOMAXCONN) < 0)
+    throw runtime_error("Failed to listen on socket.");
+
+  mesh_cache cache{options.memory_budget};
+  thread_pool pool{options.threads};
+  cout << "service:\n"
+       << "socket = " << options.socket_path << '\n'
+       << "threads = " << pool.size() << '\n'
+       << "memory budget = " << mebibytes(options.memory_budget) << " MiB\n"
+       << endl;
+
+  while (true) {
+    const auto fd = ::accept(server, nullptr, nullptr);
+    if (fd < 0) continue;
+    // The function object of the pool has to be copyable.
+    auto connection = make_shared<file_descriptor>(fd);
+    pool.submit([&cache, connection] {
+      serve_connection(cache, std::move(*connection));
+    });
+  }
+}
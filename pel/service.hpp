@@ -0,0 +1,29 @@
+#pragma once
+#include "mesh_cache.hpp"
+#include "parallel.hpp"
+#include "utility.hpp"
+
+struct service_options {
+  string socket_path{};
+  // Upper bound for the memory of cached meshes in bytes
+  size_t memory_budget = size_t{1} << 32;
+  // Number of connections that are served concurrently
+  size_t threads = thread_count();
+};
+
+// Resident service that keeps prepared meshes in memory such that
+// repeated queries only pay for the illumination and the extraction.
+// Clients connect to a Unix domain socket and send requests line by line.
+//
+//   lines <light x> <light y> <light z> <threshold> <mesh file path>
+//     Answers 'ok <n>' followed by n segments, one per line, given by
+//     'x0 y0 z0 x1 y1 z1 strength0 strength1'.
+//   stats
+//     Answers 'ok meshes=<n> memory=<bytes> hits=<n> misses=<n>'.
+//
+// Failed requests are answered by 'error <message>'.
+// The function only returns if the socket can not be set up.
+void run_service(const service_options& options);
+
+// Answers a single request without the trailing newline.
+auto answer_request(mesh_cache& cache, std::string_view request) -> string;
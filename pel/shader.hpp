@@ -212,11 +212,31 @@ class shader_program {
 
   bool exists() const { return glIsProgram(handle) == GL_TRUE; }
 
+  // Records the given outputs of the last shader stage interleaved
+  // into transform feedback buffers. The program is linked again.
+  auto capture(std::span<const czstring> varyings) -> shader_program& {
+    glTransformFeedbackVaryings(handle, varyings.size(), varyings.data(),
+                                GL_INTERLEAVED_ATTRIBS);
+    link(warnings_as_errors);
+    return *this;
+  }
+
   auto set(czstring name, float value) -> shader_program& {
     glUniform1f(glGetUniformLocation(handle, name), value);
     return *this;
   }
 
+  // Integers also select texture units for samplers.
+  auto set(czstring name, int value) -> shader_program& {
+    glUniform1i(glGetUniformLocation(handle, name), value);
+    return *this;
+  }
+
+  auto set(czstring name, vec2 data) -> shader_program& {
+    glUniform2fv(glGetUniformLocation(handle, name), 1, value_ptr(data));
+    return *this;
+  }
+
   auto set(czstring name, mat4 data) -> shader_program& {
     glUniformMatrix4fv(glGetUniformLocation(handle, name), 1, GL_FALSE,
                        value_ptr(data));
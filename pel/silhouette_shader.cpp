@@ -7,18 +7,22 @@ constexpr czstring vertex_shader_text =
 
     "uniform mat4 projection;"
     "uniform mat4 view;"
+    "uniform mat4 model = mat4(1.0);"
 
     "layout (location = 0) in vec3 p;"
     "layout (location = 1) in vec3 n;"
+    "layout (location = 7) in vec3 offset;"
 
     "out vec3 position;"
     "out vec3 normal;"
     "out float sign;"
 
     "void main(){"
-    "  gl_Position = projection * view * vec4(p, 1.0);"
-    "  position = vec3(view * vec4(p, 1.0));"
-    "  normal = vec3(view * vec4(n, 0.0));"
+    "  vec4 x = model * vec4(p, 1.0) + vec4(offset, 0.0);"
+    "  vec3 m = normalize(mat3(model) * n);"
+    "  gl_Position = projection * view * x;"
+    "  position = vec3(view * x);"
+    "  normal = vec3(view * vec4(m, 0.0));"
     "  sign = dot(normal, position);"
     "}";
 
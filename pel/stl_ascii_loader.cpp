@@ -0,0 +1,101 @@
+#include "stl_ascii_loader.hpp"
+//
+#include <exception>
+#include <filesystem>
+//
+#include "mapped_file.hpp"
+#include "parallel.hpp"
+#include "stl_loader.hpp"
+#include "text_parser.hpp"
+
+using namespace std;
+
+bool is_ascii_stl(czstring file_path) {
+  ifstream file{file_path, ios::binary};
+  if (!file.is_open()) throw runtime_error("Failed to open given STL file.");
+  char header[sizeof(stl_binary_format::header)]{};
+  stl_binary_format::size_type count{};
+  file.read(header, sizeof(header));
+  file.read(reinterpret_cast<char*>(&count), sizeof(count));
+  if (!string_view{header, sizeof(header)}.starts_with("solid")) return false;
+  const auto size = filesystem::file_size(file_path);
+  return size != sizeof(header) + sizeof(count) +
+                     size_t(count) *
+                         (sizeof(stl_binary_format::triangle) +
+                          sizeof(stl_binary_format::attribute_byte_count_type));
+}
+
+bool is_ascii_stl(string_view content) noexcept {
+  constexpr auto header_size = sizeof(stl_binary_format::header);
+  stl_binary_format::size_type count{};
+  if (!content.starts_with("solid")) return false;
+  if (content.size() < header_size + sizeof(count)) return true;
+  memcpy(&count, content.data() + header_size, sizeof(count));
+  return content.size() !=
+         header_size + sizeof(count) +
+             size_t(count) *
+                 (sizeof(stl_binary_format::triangle) +
+                  sizeof(stl_binary_format::attribute_byte_count_type));
+}
+
+void load_stl_ascii(czstring file_path,
+                    mesh_geometry& mesh,
+                    const function<void(float)>& progress) {
+  const mapped_file file{file_path};
+  load_stl_ascii(file.view(), mesh, progress);
+}
+
+void load_stl_ascii(string_view text,
+                    mesh_geometry& mesh,
+                    const function<void(float)>& progress) {
+  const auto bounds = line_aligned_chunks(text, thread_count());
+
+  // Every three consecutive vertices of the file form one triangle.
+  // Chunk boundaries do not need to coincide with facet boundaries.
+  struct chunk_data {
+    vector<vec3> vertices{};
+    exception_ptr error{};
+  };
+  vector<chunk_data> chunks(bounds.size() - 1);
+  parallel_for_blocks(0, chunks.size(), [&](size_t first, size_t last, auto) {
+    for (auto i = first; i < last; ++i) {
+      try {
+        text_parser in{text.substr(bounds[i], bounds[i + 1] - bounds[i])};
+        while (!in.done()) {
+          if (in.word() == "vertex") {
+            vec3 v;
+            if (!in.parse(v))
+              throw runtime_error("Failed to parse vertex of STL file.");
+            chunks[i].vertices.push_back(v);
+          }
+          in.skip_line();
+        }
+      } catch (...) {
+        chunks[i].error = current_exception();
+      }
+    }
+  });
+
+  size_t vertex_count = 0;
+  for (const auto& chunk : chunks) {
+    if (chunk.error) rethrow_exception(chunk.error);
+    vertex_count += chunk.vertices.size();
+  }
+  if (vertex_count % 3)
+    throw runtime_error("Vertex count of STL file is no multiple of three.");
+
+  mesh_welder welder{mesh, vertex_count / 3};
+  vec3 triangle[3];
+  size_t corner = 0;
+  for (size_t i = 0; i < chunks.size(); ++i) {
+    for (const auto& v : chunks[i].vertices) {
+      triangle[corner++] = v;
+      if (corner < 3) continue;
+      welder.add(triangle[0], triangle[1], triangle[2]);
+      corner = 0;
+    }
+    chunks[i].vertices = {};
+    if (progress) progress(float(i + 1) / chunks.size());
+  }
+  welder.finish();
+}
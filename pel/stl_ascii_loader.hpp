@@ -0,0 +1,22 @@
+#pragma once
+#include <functional>
+//
+#include "model.hpp"
+#include "utility.hpp"
+
+// Binary STL files may also start with 'solid'.
+// Hence, the file size is compared to the size given by the header.
+bool is_ascii_stl(czstring file_path);
+bool is_ascii_stl(std::string_view content) noexcept;
+
+// Loads an ASCII STL file. The file is split into chunks at line
+// boundaries whose vertices are parsed in parallel. Afterwards, the
+// triangle soup is welded chunk by chunk and every chunk is freed
+// right after it has been welded. If given, 'progress' is called
+// with the fraction of welded chunks after every chunk.
+void load_stl_ascii(czstring file_path,
+                    mesh_geometry& mesh,
+                    const std::function<void(float)>& progress = {});
+void load_stl_ascii(std::string_view text,
+                    mesh_geometry& mesh,
+                    const std::function<void(float)>& progress = {});
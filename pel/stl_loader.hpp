@@ -1,6 +1,7 @@
 #pragma once
 #include <fstream>
 //
+#include "memory_usage.hpp"
 #include "model.hpp"
 #include "utility.hpp"
 
@@ -24,6 +25,20 @@ struct stl_binary_format {
   stl_binary_format() = default;
 
   stl_binary_format(czstring file_path) {
+    read(file_path, [this](std::span<const triangle> chunk, size_t total) {
+      memory_stage stage{"STL triangles"};
+      triangles.reserve(total);
+      triangles.insert(end(triangles), begin(chunk), end(chunk));
+    });
+  }
+
+  // Reads the file chunk by chunk without storing all of its triangles.
+  // The given function is called with every newly read chunk
+  // and the total triangle count. The chunk is only valid during the call.
+  // Hence, the memory needed for reading is bounded by the chunk size.
+  static void read(czstring file_path,
+                   auto&& chunk_callback,
+                   size_t chunk_size = 1 << 16) {
     std::fstream file{file_path, std::ios::in | std::ios::binary};
     if (!file.is_open()) throw runtime_error("Failed to open given STL file.");
 
@@ -37,62 +52,146 @@ struct stl_binary_format {
 
     // Due to padding and alignment issues,
     // we cannot read everything at once.
-    // Hence, we use a simple loop for every triangle.
-    triangles.resize(size);
-    for (auto& t : triangles) {
-      file.read((char*)&t, sizeof(triangle));
+    // Hence, every chunk is read into a raw byte buffer
+    // and then unpacked triangle by triangle.
+    constexpr size_t stride =
+        sizeof(triangle) + sizeof(attribute_byte_count_type);
+    // Allocations of the callback belong to the stage of the caller.
+    vector<char> buffer{};
+    vector<triangle> chunk{};
+    {
+      memory_stage stage{"STL chunks"};
+      buffer.resize(chunk_size * stride);
+      chunk.resize(chunk_size);
+    }
+    for (size_t first = 0; first < size; first += chunk_size) {
+      const auto count = std::min<size_t>(chunk_size, size - first);
+      file.read(buffer.data(), count * stride);
+      if (!file) throw runtime_error("Failed to read triangles of STL file.");
       // Ignore the attribute byte count.
       // There should not be any information anyway.
-      file.ignore(sizeof(attribute_byte_count_type));
+      for (size_t i = 0; i < count; ++i)
+        std::memcpy(&chunk[i], &buffer[i * stride], sizeof(triangle));
+      chunk_callback(std::span<const triangle>{chunk.data(), count},
+                     size_t(size));
+    }
+  }
+
+  // Like 'read' but for the content of a file that is already in memory.
+  static void parse(std::string_view content,
+                    auto&& chunk_callback,
+                    size_t chunk_size = 1 << 16) {
+    constexpr size_t stride =
+        sizeof(triangle) + sizeof(attribute_byte_count_type);
+    size_type size;
+    if (content.size() < sizeof(header) + sizeof(size))
+      throw runtime_error("STL data is truncated.");
+    std::memcpy(&size, content.data() + sizeof(header), sizeof(size));
+    if (content.size() < sizeof(header) + sizeof(size) + size * stride)
+      throw runtime_error("STL data is truncated.");
+    const auto data = content.data() + sizeof(header) + sizeof(size);
+    vector<triangle> chunk{};
+    {
+      memory_stage stage{"STL chunks"};
+      chunk.resize(std::min<size_t>(chunk_size, size));
+    }
+    for (size_t first = 0; first < size; first += chunk_size) {
+      const auto count = std::min<size_t>(chunk_size, size - first);
+      for (size_t i = 0; i < count; ++i)
+        std::memcpy(&chunk[i], &data[(first + i) * stride], sizeof(triangle));
+      chunk_callback(std::span<const triangle>{chunk.data(), count},
+                     size_t(size));
     }
   }
 
   vector<triangle> triangles{};
 };
 
-void transform(const stl_binary_format& stl_data, model& mesh) {
-  std::unordered_map<vec3, size_t, decltype([](const auto& v) -> size_t {
-                       return (bit_cast<uint32_t>(v.x) << 11) ^
-                              (bit_cast<uint32_t>(v.y) << 5) ^
-                              bit_cast<uint32_t>(v.z);
-                     })>
-      position_index{};
-  position_index.reserve(stl_data.triangles.size());
-
-  for (size_t i = 0; i < stl_data.triangles.size(); ++i) {
-    model::face f{};
-    const auto& normal = stl_data.triangles[i].normal;
-    const auto& v = stl_data.triangles[i].vertex;
+// Incrementally welds chunks of a triangle soup into a mesh
+// whose vertices are identified by their exact position.
+// The index is an open-addressing hash table that only stores
+// vertex indices and compares positions directly in the mesh.
+// Its memory overhead is therefore small compared to the mesh itself.
+class mesh_welder {
+ public:
+  // The triangle count is only used to reserve memory.
+  explicit mesh_welder(mesh_geometry& mesh, size_t triangle_count = 0)
+      : mesh{mesh} {
+    mesh.faces.reserve(mesh.faces.size() + triangle_count);
+    // Closed meshes have roughly half as many vertices as triangles.
+    mesh.vertices.reserve(mesh.vertices.size() + triangle_count / 2);
+    rehash(std::bit_ceil(std::max<size_t>(1024, triangle_count)));
+  }
+
+  void add(const vec3& a, const vec3& b, const vec3& c) {
+    const vec3 v[3] = {a, b, c};
+    mesh_geometry::face f{};
     for (size_t j = 0; j < 3; ++j) {
-      const auto k = (j + 1) % 3;
-      const auto l = (j + 2) % 3;
-      const auto p = v[k] - v[j];
-      const auto q = v[l] - v[j];
-      // const auto weight = length(cross(p, q)) / dot(p, p) / dot(q, q);
-      const auto n = cross(p, q) / dot(p, p) / dot(q, q);
-
-      const auto it = position_index.find(v[j]);
-      if (it == end(position_index)) {
-        const int index = mesh.vertices.size();
-        f[j] = index;
-        position_index.emplace(v[j], index);
-        // mesh.vertices.push_back({v[j], normal});
-        // mesh.vertices.push_back({v[j], weight * normal});
-        mesh.vertices.push_back({v[j], n});
-        continue;
-      }
-
-      const auto index = it->second;
-      f[j] = index;
-      // mesh.vertices[index].normal += normal;
-      // mesh.vertices[index].normal += weight * normal;
-      mesh.vertices[index].normal += n;
+      f[j] = vertex_index(v[j]);
+      mesh.vertices[f[j]].normal += corner_normal(v[j], v[(j + 1) % 3],
+                                                  v[(j + 2) % 3]);
     }
-
     mesh.faces.push_back(f);
   }
 
-  for (auto& v : mesh.vertices) {
-    v.normal = normalize(v.normal);
+  void add(std::span<const stl_binary_format::triangle> triangles) {
+    for (const auto& t : triangles) add(t.vertex[0], t.vertex[1], t.vertex[2]);
+  }
+
+  // Normalizes the accumulated vertex normals and frees the index.
+  void finish() {
+    for (auto& v : mesh.vertices) v.normal = normalize(v.normal);
+    index = {};
+  }
+
+ private:
+  static constexpr uint32_t empty = ~uint32_t{};
+
+  static auto hash(const vec3& v) noexcept -> size_t {
+    const auto h = (uint64_t(std::bit_cast<uint32_t>(v.x)) * 73856093) ^
+                   (uint64_t(std::bit_cast<uint32_t>(v.y)) * 19349663) ^
+                   (uint64_t(std::bit_cast<uint32_t>(v.z)) * 83492791);
+    // Fibonacci hashing spreads the bits over the whole range.
+    return h * 0x9e3779b97f4a7c15ull;
+  }
+
+  auto slot(const vec3& v) const noexcept -> size_t {
+    return hash(v) >> (64 - std::countr_zero(index.size()));
+  }
+
+  void insert(uint32_t i) {
+    auto s = slot(mesh.vertices[i].position);
+    while (index[s] != empty) s = (s + 1) & (index.size() - 1);
+    index[s] = i;
+  }
+
+  void rehash(size_t size) {
+    memory_stage stage{"welding index"};
+    index.assign(size, empty);
+    for (uint32_t i = 0; i < mesh.vertices.size(); ++i) insert(i);
+  }
+
+  auto vertex_index(const vec3& position) -> uint32_t {
+    auto s = slot(position);
+    for (; index[s] != empty; s = (s + 1) & (index.size() - 1))
+      if (mesh.vertices[index[s]].position == position) return index[s];
+
+    // Keep the load factor below one half.
+    const uint32_t i = mesh.vertices.size();
+    mesh.vertices.push_back({position, vec3{0.0f}});
+    if (2 * mesh.vertices.size() > index.size())
+      rehash(2 * index.size());
+    else
+      index[s] = i;
+    return i;
   }
+
+  mesh_geometry& mesh;
+  vector<uint32_t> index{};
+};
+
+inline void transform(const stl_binary_format& stl_data, mesh_geometry& mesh) {
+  mesh_welder welder{mesh, stl_data.triangles.size()};
+  welder.add(stl_data.triangles);
+  welder.finish();
 }
@@ -0,0 +1,302 @@
+#include "task_scheduler.hpp"
+//
+#include <charconv>
+#include <cstdlib>
+#include <optional>
+//
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+using namespace std;
+
+namespace {
+
+// Workers know their scheduler to push nested tasks into their own deque.
+thread_local const task_scheduler* current_scheduler = nullptr;
+thread_local size_t current_worker = 0;
+
+#if defined(__linux__)
+constexpr size_t max_core_count = CPU_SETSIZE;
+#else
+constexpr size_t max_core_count = 1024;
+#endif
+
+void check_cores(const vector<size_t>& cores) {
+  for (auto core : cores)
+    if (core >= max_core_count)
+      throw runtime_error("Failed to pin threads to core " + to_string(core) +
+                          ". Cores must be less than " +
+                          to_string(max_core_count) + ".");
+}
+
+// Cores must have been checked before.
+void pin_current_thread(const vector<size_t>& cores) {
+#if defined(__linux__)
+  cpu_set_t set;
+  CPU_ZERO(&set);
+  for (auto core : cores) CPU_SET(core, &set);
+  pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+#endif
+}
+
+// Parses the whole string as non-negative integer.
+bool parse_number(string_view text, size_t& value) {
+  const auto last = text.data() + text.size();
+  const auto [ptr, error] = from_chars(text.data(), last, value);
+  return (error == errc{}) && (ptr == last);
+}
+
+// Parses lists of cores like '0-3,8'.
+auto parse_cores(string_view list) -> vector<size_t> {
+  const auto invalid = [text = string{list}] {
+    return runtime_error("Failed to parse PEL_CORES='" + text +
+                         "'. Expected a list of cores like '0-3,8'.");
+  };
+  vector<size_t> cores{};
+  while (!list.empty()) {
+    const auto comma = list.find(',');
+    const auto item = list.substr(0, comma);
+    list = (comma == string_view::npos) ? string_view{}
+                                        : list.substr(comma + 1);
+    if (item.empty()) continue;
+    const auto dash = item.find('-');
+    size_t first, last;
+    if (!parse_number(item.substr(0, dash), first)) throw invalid();
+    if (dash == string_view::npos)
+      last = first;
+    else if (!parse_number(item.substr(dash + 1), last) || (last < first))
+      throw invalid();
+    check_cores({last});
+    for (auto core = first; core <= last; ++core) cores.push_back(core);
+  }
+  return cores;
+}
+
+auto environment_options() -> task_scheduler::options {
+  task_scheduler::options opts{};
+  if (const auto cores = getenv("PEL_CORES")) {
+    opts.cores = parse_cores(cores);
+    if (!opts.cores.empty()) opts.threads = opts.cores.size();
+  }
+  if (const auto threads = getenv("PEL_THREADS")) {
+    if (!parse_number(threads, opts.threads) || !opts.threads)
+      throw runtime_error("Failed to parse PEL_THREADS='" + string{threads} +
+                          "'. Expected a positive number of threads.");
+  }
+  return opts;
+}
+
+mutex configuration_mutex{};
+optional<task_scheduler::options> configuration{};
+bool scheduler_started = false;
+
+}  // namespace
+
+task_scheduler::task_scheduler(const options& opts) {
+  check_cores(opts.cores);
+  const auto count = std::max<size_t>(1, opts.threads) - 1;
+  workers.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+    workers.push_back(std::make_unique<worker>());
+  for (size_t i = 0; i < count; ++i) {
+    vector<size_t> core{};
+    if (!opts.cores.empty()) core.push_back(opts.cores[i % opts.cores.size()]);
+    workers[i]->thread =
+        std::jthread{[this, i, core](std::stop_token stop) {
+          if (!core.empty()) pin_current_thread(core);
+          run(i, stop);
+        }};
+  }
+}
+
+task_scheduler::~task_scheduler() {
+  for (auto& w : workers) w->thread.request_stop();
+  task_available.notify_all();
+  for (auto& w : workers) w->thread.join();
+}
+
+void task_scheduler::submit(std::function<void()> task,
+                            const task_group* group) {
+  if (workers.empty()) {
+    task();
+    return;
+  }
+  const auto index = (current_scheduler == this)
+                         ? current_worker
+                         : next_worker++ % workers.size();
+  const auto stage = current_memory_stage();
+  {
+    scoped_lock lock{workers[index]->mutex};
+    workers[index]->tasks.push_back({std::move(task), stage, group});
+  }
+  ++queued_tasks;
+  // Sleeping workers check for tasks while holding the mutex.
+  { scoped_lock lock{sleep_mutex}; }
+  task_available.notify_one();
+}
+
+bool task_scheduler::run_pending_task(const task_group* group) {
+  queued_task task;
+  const auto found = (current_scheduler == this)
+                         ? (pop(current_worker, task) ||
+                            steal(current_worker, task, nullptr))
+                         : (group && steal(workers.size(), task, group));
+  if (!found) return false;
+  memory_stage stage{task.stage};
+  task.run();
+  return true;
+}
+
+void task_scheduler::wait(const task_group* group,
+                          const std::function<bool()>& ready) {
+  // Workers also wake up for new tasks. Other threads would
+  // not be able to execute most of them and only wake up when notified.
+  const auto worker = (current_scheduler == this);
+  while (!ready()) {
+    if (run_pending_task(group)) continue;
+    unique_lock lock{sleep_mutex};
+    task_available.wait(
+        lock, [&] { return ready() || (worker && (queued_tasks > 0)); });
+  }
+}
+
+void task_scheduler::notify() {
+  // Waiting threads check their condition while holding the mutex.
+  { scoped_lock lock{sleep_mutex}; }
+  task_available.notify_all();
+}
+
+void task_scheduler::run(size_t index, std::stop_token stop) {
+  current_scheduler = this;
+  current_worker = index;
+  while (!stop.stop_requested()) {
+    if (run_pending_task()) continue;
+    unique_lock lock{sleep_mutex};
+    task_available.wait(lock, stop, [this] { return queued_tasks > 0; });
+  }
+}
+
+bool task_scheduler::pop(size_t index, queued_task& task) {
+  auto& w = *workers[index];
+  scoped_lock lock{w.mutex};
+  if (w.tasks.empty()) return false;
+  task = std::move(w.tasks.back());
+  w.tasks.pop_back();
+  --queued_tasks;
+  return true;
+}
+
+// Without a group, the oldest task is stolen.
+// Otherwise, the oldest task of the given group.
+bool task_scheduler::steal(size_t thief,
+                           queued_task& task,
+                           const task_group* group) {
+  if (!queued_tasks) return false;
+  for (size_t i = 1; i <= workers.size(); ++i) {
+    auto& w = *workers[(thief + i) % workers.size()];
+    scoped_lock lock{w.mutex};
+    const auto it =
+        group ? find_if(begin(w.tasks), end(w.tasks),
+                        [group](const auto& t) { return t.group == group; })
+              : begin(w.tasks);
+    if (it == end(w.tasks)) continue;
+    task = std::move(*it);
+    w.tasks.erase(it);
+    --queued_tasks;
+    return true;
+  }
+  return false;
+}
+
+void configure_scheduler(const task_scheduler::options& opts) {
+  scoped_lock lock{configuration_mutex};
+  if (scheduler_started)
+    throw runtime_error("Failed to configure already running scheduler.");
+  check_cores(opts.cores);
+  configuration = opts;
+  if (!opts.cores.empty()) pin_current_thread(opts.cores);
+}
+
+auto scheduler() -> task_scheduler& {
+  // The scheduler is never destroyed such that threads which are
+  // still running during static destruction can use it.
+  static const auto instance = [] {
+    scoped_lock lock{configuration_mutex};
+    scheduler_started = true;
+    if (!configuration) {
+      configuration = environment_options();
+      if (!configuration->cores.empty())
+        pin_current_thread(configuration->cores);
+    }
+    return new task_scheduler{*configuration};
+  }();
+  return *instance;
+}
+
+task_group::~task_group() {
+  try {
+    wait();
+  } catch (...) {
+  }
+}
+
+void task_group::run(std::function<void()> task) {
+  ++pending;
+  tasks.submit(
+      [this, task = std::move(task)] {
+        exception_ptr failure{};
+        try {
+          task();
+        } catch (...) {
+          failure = current_exception();
+        }
+        finish(failure);
+      },
+      this);
+}
+
+void task_group::finish(std::exception_ptr failure) {
+  // The group may be destroyed as soon as the last task is done.
+  auto& s = tasks;
+  bool done;
+  {
+    scoped_lock lock{mutex};
+    if (failure && !error) error = failure;
+    done = (--pending == 0);
+  }
+  if (done) s.notify();
+}
+
+void task_group::wait() {
+  tasks.wait(this, [this] { return pending == 0; });
+  scoped_lock lock{mutex};
+  if (error) rethrow_exception(std::exchange(error, nullptr));
+}
+
+auto task_graph::add(std::function<void()> task,
+                     std::initializer_list<node> dependencies) -> node {
+  const auto index = nodes.size();
+  auto& n = nodes.emplace_back();
+  n.task = std::move(task);
+  n.dependencies = dependencies.size();
+  for (auto d : dependencies) nodes[d].successors.push_back(index);
+  return index;
+}
+
+void task_graph::run(task_scheduler& s) {
+  task_group group{s};
+  for (auto& n : nodes) n.remaining = n.dependencies;
+  for (node i = 0; i < nodes.size(); ++i)
+    if (!nodes[i].dependencies) schedule(group, i);
+  group.wait();
+}
+
+void task_graph::schedule(task_group& group, node n) {
+  group.run([this, &group, n] {
+    nodes[n].task();
+    for (auto s : nodes[n].successors)
+      if (--nodes[s].remaining == 0) schedule(group, s);
+  });
+}
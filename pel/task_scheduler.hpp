@@ -0,0 +1,151 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+//
+#include "memory_usage.hpp"
+#include "utility.hpp"
+
+class task_group;
+
+// Process-wide set of worker threads with one task deque per worker.
+// Workers execute their own tasks in LIFO order and steal the oldest tasks
+// of other workers when they run out of work. Tasks submitted by other
+// threads are distributed over the workers in round-robin order.
+// Threads that wait for tasks help executing them,
+// so nested parallelism does not block any worker.
+// Other threads only help with the tasks of the group they wait for.
+// Otherwise, e.g. the render thread could get stuck in unrelated work.
+class task_scheduler {
+ public:
+  struct options {
+    // Number of threads that work on tasks, including the waiting thread
+    size_t threads = std::max(1u, std::thread::hardware_concurrency());
+    // If given, worker 'i' is pinned to 'cores[i % cores.size()]'.
+    vector<size_t> cores{};
+  };
+
+  explicit task_scheduler(const options& opts);
+  ~task_scheduler();
+
+  // Copying is not allowed.
+  task_scheduler(const task_scheduler&) = delete;
+  task_scheduler& operator=(const task_scheduler&) = delete;
+
+  // For now, moving is not allowed.
+  task_scheduler(task_scheduler&&) = delete;
+  task_scheduler& operator=(task_scheduler&&) = delete;
+
+  // Number of threads that work on tasks, including the waiting thread
+  auto size() const noexcept -> size_t { return workers.size() + 1; }
+
+  // Without any workers, tasks are executed immediately.
+  void submit(std::function<void()> task, const task_group* group = nullptr);
+
+  // Executes one pending task on the calling thread if there is one.
+  // Workers may execute any task. Other threads only execute
+  // the tasks of the given group.
+  bool run_pending_task(const task_group* group = nullptr);
+
+  // Executes pending tasks like 'run_pending_task' until 'ready' returns
+  // true and sleeps while there are none. Threads that change the result
+  // of 'ready' have to call 'notify()' afterwards.
+  void wait(const task_group* group, const std::function<bool()>& ready);
+  void notify();
+
+ private:
+  // Tasks are executed in the memory stage of their submitting thread.
+  struct queued_task {
+    std::function<void()> run{};
+    memory_stage_id stage{};
+    const task_group* group{};
+  };
+
+  struct worker {
+    std::mutex mutex{};
+    std::deque<queued_task> tasks{};
+    std::jthread thread{};
+  };
+
+  void run(size_t index, std::stop_token stop);
+  bool pop(size_t index, queued_task& task);
+  bool steal(size_t thief, queued_task& task, const task_group* group);
+
+  vector<std::unique_ptr<worker>> workers{};
+  std::atomic<size_t> next_worker{0};
+  std::atomic<size_t> queued_tasks{0};
+
+  // Idle workers sleep until new tasks arrive.
+  // Waiting threads sleep until new tasks arrive or they are notified.
+  std::mutex sleep_mutex{};
+  std::condition_variable_any task_available{};
+};
+
+// Sets the options of the process-wide scheduler. Pinning also restricts
+// the calling thread and the threads it creates afterwards to the cores.
+// Must be called before the first use of 'scheduler()'.
+void configure_scheduler(const task_scheduler::options& opts);
+
+// Process-wide scheduler used by all parallel algorithms.
+// Without explicit configuration, the thread count and the cores are read
+// from the environment variables PEL_THREADS and PEL_CORES, e.g. '0-3,8'.
+auto scheduler() -> task_scheduler&;
+
+// Set of tasks whose completion can be waited for.
+// The first exception thrown by a task is rethrown by 'wait()'.
+class task_group {
+ public:
+  explicit task_group(task_scheduler& s = scheduler()) : tasks{s} {}
+  ~task_group();
+
+  // Copying is not allowed.
+  task_group(const task_group&) = delete;
+  task_group& operator=(const task_group&) = delete;
+
+  // For now, moving is not allowed.
+  task_group(task_group&&) = delete;
+  task_group& operator=(task_group&&) = delete;
+
+  void run(std::function<void()> task);
+
+  // Helps executing pending tasks until all tasks of the group are done.
+  void wait();
+
+ private:
+  void finish(std::exception_ptr failure);
+
+  task_scheduler& tasks;
+  std::atomic<size_t> pending{0};
+  std::mutex mutex{};
+  std::exception_ptr error{};
+};
+
+// Tasks with dependencies that are executed as soon as
+// all of the tasks they depend on have been finished.
+class task_graph {
+ public:
+  using node = size_t;
+
+  // Dependencies must have been added before.
+  auto add(std::function<void()> task,
+           std::initializer_list<node> dependencies = {}) -> node;
+
+  // Executes all tasks and waits for them.
+  void run(task_scheduler& s = scheduler());
+
+ private:
+  struct task_node {
+    std::function<void()> task{};
+    vector<node> successors{};
+    size_t dependencies{};
+    std::atomic<size_t> remaining{};
+  };
+
+  void schedule(task_group& group, node n);
+
+  std::deque<task_node> nodes{};
+};
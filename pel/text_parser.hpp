@@ -0,0 +1,77 @@
+#pragma once
+#include <cctype>
+#include <charconv>
+//
+#include "utility.hpp"
+
+// Splits the given text into at most 'count' chunks that start at the
+// beginning of a line. Returns the offsets of all chunk boundaries
+// including zero and the size of the text.
+inline auto line_aligned_chunks(std::string_view text, size_t count)
+    -> vector<size_t> {
+  vector<size_t> bounds{0};
+  for (size_t i = 1; i < count; ++i) {
+    auto offset = std::max(bounds.back(), i * text.size() / count);
+    offset = text.find('\n', offset);
+    if (offset == std::string_view::npos) break;
+    if (offset + 1 > bounds.back()) bounds.push_back(offset + 1);
+  }
+  if (bounds.back() != text.size()) bounds.push_back(text.size());
+  return bounds;
+}
+
+// Minimal cursor over line-based text formats.
+// Numbers are parsed by 'std::from_chars' which neither allocates
+// nor depends on the locale and is therefore fast enough
+// to parse several hundred megabytes per second on every thread.
+struct text_parser {
+  text_parser(std::string_view text) noexcept
+      : it{text.data()}, last{text.data() + text.size()} {}
+
+  bool done() const noexcept { return it == last; }
+
+  void skip_space() noexcept {
+    while ((it != last) && ((*it == ' ') || (*it == '\t') || (*it == '\r')))
+      ++it;
+  }
+
+  void skip_line() noexcept {
+    while ((it != last) && (*it != '\n')) ++it;
+    if (it != last) ++it;
+  }
+
+  bool line_end() noexcept {
+    skip_space();
+    return (it == last) || (*it == '\n');
+  }
+
+  // Skips the rest of the current word.
+  void skip_word() noexcept {
+    while ((it != last) && !std::isspace(static_cast<unsigned char>(*it)))
+      ++it;
+  }
+
+  // Returns the next whitespace-separated word of the current line.
+  auto word() noexcept -> std::string_view {
+    skip_space();
+    const auto first = it;
+    skip_word();
+    return {first, size_t(it - first)};
+  }
+
+  bool parse(auto& value) noexcept {
+    skip_space();
+    if ((it != last) && (*it == '+')) ++it;
+    const auto [ptr, error] = std::from_chars(it, last, value);
+    if (error != std::errc{}) return false;
+    it = ptr;
+    return true;
+  }
+
+  bool parse(vec3& v) noexcept {
+    return parse(v.x) && parse(v.y) && parse(v.z);
+  }
+
+  const char* it;
+  const char* last;
+};
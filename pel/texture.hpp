@@ -0,0 +1,26 @@
+#pragma once
+#include "utility.hpp"
+
+class texture {
+ public:
+  texture() { glGenTextures(1, &handle); }
+  ~texture() { glDeleteTextures(1, &handle); }
+
+  // Copying is not allowed.
+  texture(const texture&) = delete;
+  texture& operator=(const texture&) = delete;
+
+  // Moving
+  texture(texture&& x) : handle{x.handle} { x.handle = 0; }
+  texture& operator=(texture&& x) {
+    swap(handle, x.handle);
+    return *this;
+  }
+
+  operator GLuint() const { return handle; }
+
+  void bind() const { glBindTexture(GL_TEXTURE_2D, handle); }
+
+  // private:
+  GLuint handle{};  // value zero is ignored
+};
@@ -0,0 +1,31 @@
+#include "thread_pool.hpp"
+
+using namespace std;
+
+thread_pool::thread_pool(size_t count) {
+  threads.reserve(count);
+  for (size_t i = 0; i < count; ++i)
+    threads.emplace_back([this](std::stop_token stop) { run(stop); });
+}
+
+void thread_pool::submit(std::function<void()> task) {
+  {
+    scoped_lock lock{mutex};
+    tasks.push(std::move(task));
+  }
+  task_available.notify_one();
+}
+
+void thread_pool::run(std::stop_token stop) {
+  while (true) {
+    std::function<void()> task;
+    {
+      unique_lock lock{mutex};
+      if (!task_available.wait(lock, stop, [this] { return !tasks.empty(); }))
+        return;
+      task = std::move(tasks.front());
+      tasks.pop();
+    }
+    task();
+  }
+}
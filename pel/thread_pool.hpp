@@ -0,0 +1,38 @@
+#pragma once
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
+//
+#include "parallel.hpp"
+#include "utility.hpp"
+
+// Fixed set of threads that execute submitted tasks in submission order.
+// Remaining tasks are dropped when the pool is destroyed.
+class thread_pool {
+ public:
+  explicit thread_pool(size_t count = thread_count());
+
+  // Copying is not allowed.
+  thread_pool(const thread_pool&) = delete;
+  thread_pool& operator=(const thread_pool&) = delete;
+
+  // For now, moving is not allowed.
+  thread_pool(thread_pool&&) = delete;
+  thread_pool& operator=(thread_pool&&) = delete;
+
+  void submit(std::function<void()> task);
+
+  auto size() const noexcept -> size_t { return threads.size(); }
+
+ private:
+  void run(std::stop_token stop);
+
+  std::mutex mutex{};
+  std::condition_variable_any task_available{};
+  std::queue<std::function<void()>> tasks{};
+
+  // Threads are joined before the queue is destroyed.
+  vector<std::jthread> threads{};
+};
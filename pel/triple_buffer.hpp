@@ -0,0 +1,51 @@
+#pragma once
+#include <atomic>
+//
+#include "utility.hpp"
+
+// Lock-free triple buffer for exactly one producer and one consumer thread.
+// The producer owns the back slot and the consumer owns the front slot.
+// Publishing swaps the back slot with the middle one and marks it as fresh.
+// Fetching swaps the middle slot with the front one if it is fresh.
+// Neither of the threads ever waits for the other one
+// and the consumer always reads the newest completed data.
+template <typename T>
+class triple_buffer {
+ public:
+  triple_buffer() = default;
+
+  // Resets all slots to the given value.
+  // Must not be called while producer or consumer are active.
+  void reset(const T& value) {
+    for (auto& slot : slots) slot = value;
+    back_index = 0;
+    middle.store(1, std::memory_order_relaxed);
+    front_index = 2;
+  }
+
+  // Producer Interface
+  auto back() noexcept -> T& { return slots[back_index]; }
+  void publish() noexcept {
+    back_index = middle.exchange(back_index | fresh_bit,  //
+                                 std::memory_order_acq_rel) &
+                 index_mask;
+  }
+
+  // Consumer Interface
+  bool fetch() noexcept {
+    if (!(middle.load(std::memory_order_relaxed) & fresh_bit)) return false;
+    front_index =
+        middle.exchange(front_index, std::memory_order_acq_rel) & index_mask;
+    return true;
+  }
+  auto front() const noexcept -> const T& { return slots[front_index]; }
+
+ private:
+  static constexpr uint8_t fresh_bit = 0b100;
+  static constexpr uint8_t index_mask = 0b011;
+
+  array<T, 3> slots{};
+  uint8_t back_index = 0;
+  std::atomic<uint8_t> middle{1};
+  uint8_t front_index = 2;
+};
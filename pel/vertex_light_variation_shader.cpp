@@ -7,6 +7,7 @@ constexpr czstring vertex_shader_text =
 
     "uniform mat4 projection;"
     "uniform mat4 view;"
+    "uniform mat4 model = mat4(1.0);"
 
     "layout (location = 0) in vec3 p;"
     "layout (location = 1) in vec3 n;"
@@ -14,11 +15,13 @@ constexpr czstring vertex_shader_text =
     "layout (location = 3) in vec2 lg;"
     "layout (location = 4) in float lv;"
     "layout (location = 5) in float lvs;"
+    "layout (location = 7) in vec3 offset;"
 
     "out float light;"
 
     "void main(){"
-    "  gl_Position = projection * view * vec4(p, 1.0);"
+    "  vec4 x = model * vec4(p, 1.0) + vec4(offset, 0.0);"
+    "  gl_Position = projection * view * x;"
     "  light = 1 - pow(1 - lv, 100);"
     "}";
 
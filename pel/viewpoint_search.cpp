@@ -0,0 +1,202 @@
+#include "viewpoint_search.hpp"
+//
+#include <algorithm>
+//
+#include "geodesic_grid.hpp"
+#include "parallel.hpp"
+
+using namespace std;
+
+namespace {
+
+struct view_measures {
+  float line_length{};
+  float contour_length{};
+  float visible_area{};
+};
+
+void add(view_measures& x, const view_measures& y) noexcept {
+  x.line_length += y.line_length;
+  x.contour_length += y.contour_length;
+  x.visible_area += y.visible_area;
+}
+
+// Measures the view in the given direction and the one in its opposite
+// direction. Both share the illumination and the contours. Every face
+// contributes its area and its line to the side that it is facing.
+auto measure_views(vec3 dir,
+                   const mesh_geometry& mesh,
+                   const vector<illumination_info>& data,
+                   float threshold) -> pair<view_measures, view_measures> {
+  using result = pair<view_measures, view_measures>;
+  return parallel_reduce(
+      size_t{0}, mesh.faces.size(), result{},
+      [&](size_t first, size_t last) {
+        result r{};
+        for (auto i = first; i < last; ++i) {
+          const auto& f = mesh.faces[i];
+          vec3 p[3];
+          for (size_t j = 0; j < 3; ++j) p[j] = mesh.vertices[f[j]].position;
+          // The length of the cross product is twice the area of the face.
+          const auto facing = dot(cross(p[1] - p[0], p[2] - p[0]), dir);
+          auto& side = (facing < 0) ? r.first : r.second;
+          side.visible_area += 0.5f * abs(facing);
+
+          line_segment segment;
+          if (face_photic_extremum_line(mesh, data, i, segment) &&
+              clip_line_segment(segment, threshold))
+            side.line_length +=
+                0.5f * (segment.start_strength + segment.end_strength) *
+                distance(segment.start, segment.end);
+
+          // Contour points are interpolated like in the contour shader.
+          float s[3];
+          for (size_t j = 0; j < 3; ++j)
+            s[j] = dot(mesh.vertices[f[j]].normal, dir);
+          vec3 x[2];
+          size_t n = 0;
+          for (size_t j = 0; (j < 3) && (n < 2); ++j) {
+            const auto k = (j + 1) % 3;
+            // Also skips vertices without a valid normal.
+            if (!(s[j] * s[k] < 0)) continue;
+            x[n++] = (abs(s[k]) * p[j] + abs(s[j]) * p[k]) /
+                     (abs(s[j]) + abs(s[k]));
+          }
+          if (n == 2) {
+            const auto length = distance(x[0], x[1]);
+            r.first.contour_length += length;
+            r.second.contour_length += length;
+          }
+        }
+        return r;
+      },
+      [](result x, const result& y) {
+        add(x.first, y.first);
+        add(x.second, y.second);
+        return x;
+      });
+}
+
+}  // namespace
+
+auto search_viewpoints(const mesh_geometry& mesh,
+                       const vector<gradient_info>& gradient_data,
+                       const vertex_face_adjacency& adjacency,
+                       const vector<illumination_info>& illumination_data,
+                       const viewpoint_search_options& options)
+    -> vector<viewpoint> {
+  const geodesic_grid grid{options.subdivisions};
+
+  // Large meshes are also split by the parallel loops of every pass.
+  // For small meshes, the parallel evaluation of candidates dominates.
+  vector<vector<illumination_info>> scratch(thread_count());
+  const auto evaluate = [&](const vector<vec3>& dirs) {
+    vector<pair<view_measures, view_measures>> result(dirs.size());
+    parallel_for_blocks(
+        size_t{0}, dirs.size(), scratch.size(),
+        [&](size_t first, size_t last, size_t block) {
+          auto& data = scratch[block];
+          if (data.empty()) data = illumination_data;
+          for (auto k = first; k < last; ++k) {
+            compute_illumination(dirs[k], mesh, gradient_data, adjacency,
+                                 data, options.light_smoothing);
+            result[k] = measure_views(dirs[k], mesh, data, options.threshold);
+          }
+        });
+    return result;
+  };
+
+  vector<size_t> indices{};
+  vector<vec3> dirs{};
+  for (size_t i = 0; i < grid.size(); ++i) {
+    if (grid.antipode(i) < i) continue;
+    indices.push_back(i);
+    dirs.push_back(grid.direction(i));
+  }
+  const auto pairs = evaluate(dirs);
+  vector<view_measures> measures(grid.size());
+  for (size_t k = 0; k < indices.size(); ++k) {
+    measures[indices[k]] = pairs[k].first;
+    measures[grid.antipode(indices[k])] = pairs[k].second;
+  }
+
+  view_measures scale{};
+  for (const auto& m : measures) {
+    scale.line_length = max(scale.line_length, m.line_length);
+    scale.contour_length = max(scale.contour_length, m.contour_length);
+    scale.visible_area = max(scale.visible_area, m.visible_area);
+  }
+  const auto normalized = [](float x, float max) {
+    return (max > 0) ? x / max : 0.0f;
+  };
+  const auto make_viewpoint = [&](vec3 dir, const view_measures& m) {
+    viewpoint v{};
+    v.direction = dir;
+    // The eye lies in the opposite direction.
+    v.azimuth = atan2(-dir.x, dir.z);
+    v.altitude = asin(clamp(-dir.y, -1.0f, 1.0f));
+    v.line_length = m.line_length;
+    v.contour_length = m.contour_length;
+    v.visible_area = m.visible_area;
+    v.score =
+        options.line_weight * normalized(m.line_length, scale.line_length) +
+        options.contour_weight *
+            normalized(m.contour_length, scale.contour_length) +
+        options.area_weight * normalized(m.visible_area, scale.visible_area);
+    return v;
+  };
+
+  // Views are taken by descending score if they are not too close
+  // to one of the views that have already been taken.
+  const auto select = [&](vector<viewpoint> candidates, size_t count) {
+    ranges::sort(candidates, [](const auto& x, const auto& y) {
+      return x.score > y.score;
+    });
+    const auto min_cos = cos(options.separation);
+    vector<viewpoint> result{};
+    for (const auto& c : candidates) {
+      if (result.size() == count) break;
+      if (ranges::any_of(result, [&](const auto& v) {
+            return dot(v.direction, c.direction) > min_cos;
+          }))
+        continue;
+      result.push_back(c);
+    }
+    return result;
+  };
+
+  vector<viewpoint> candidates{};
+  for (size_t i = 0; i < grid.size(); ++i)
+    candidates.push_back(make_viewpoint(grid.direction(i), measures[i]));
+  // More views than needed are refined because
+  // their order may change during the refinement.
+  auto views = select(candidates, 2 * options.count);
+
+  // Every view probes six neighbors on a circle around it
+  // and moves to the best one if that is better than itself.
+  auto step = grid.spacing() / 2;
+  for (size_t s = 0; s < options.refinement_steps; ++s, step /= 2) {
+    vector<vec3> probes{};
+    for (const auto& v : views) {
+      const auto d = v.direction;
+      const auto t1 = normalize(
+          cross(d, (abs(d.x) < 0.9f) ? vec3{1, 0, 0} : vec3{0, 1, 0}));
+      const auto t2 = cross(d, t1);
+      for (size_t a = 0; a < 6; ++a) {
+        const auto angle = float(a) * pi / 3;
+        probes.push_back(normalize(
+            cos(step) * d + sin(step) * (cos(angle) * t1 + sin(angle) * t2)));
+      }
+    }
+    const auto results = evaluate(probes);
+    for (size_t k = 0; k < probes.size(); ++k) {
+      const auto probe = make_viewpoint(probes[k], results[k].first);
+      auto& v = views[k / 6];
+      if (probe.score > v.score) v = probe;
+    }
+  }
+  // Refined views may converge to the same maximum. Then, the remaining
+  // views are filled up by coarse candidates with lower scores.
+  views.insert(end(views), begin(candidates), end(candidates));
+  return select(std::move(views), options.count);
+}
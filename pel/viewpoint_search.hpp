@@ -0,0 +1,58 @@
+#pragma once
+#include "mesh_clusters.hpp"
+#include "model.hpp"
+#include "photic_extremum_lines.hpp"
+#include "utility.hpp"
+
+struct viewpoint_search_options {
+  // The coarse candidates are the directions of a geodesic grid.
+  // Three subdivisions give 642 directions.
+  size_t subdivisions = 3;
+  // Number of returned views
+  size_t count = 4;
+  // Returned views are at least this angle in radians apart.
+  float separation = 0.5f;
+  // Every refinement step halves the distance of the probed neighbors.
+  size_t refinement_steps = 3;
+  // Parameters of the photic extremum lines
+  float threshold = 0.01f;
+  size_t light_smoothing = 0;
+  // Weights of the measures. Every measure is divided by its maximum
+  // over the coarse candidates such that the weights are comparable.
+  float line_weight = 1.0f;
+  float contour_weight = 0.5f;
+  float area_weight = 0.5f;
+};
+
+// Candidate view with the measures that make up its score.
+// The light always comes from the eye like in the interactive application.
+struct viewpoint {
+  // Looking direction towards the mesh
+  vec3 direction{};
+  // Horizontal coordinates of the eye for 'orbit_camera'
+  float azimuth{};
+  float altitude{};
+  float score{};
+  // Length of the visible photic extremum lines weighted by their strength
+  float line_length{};
+  // Length of the contours of the interpolated vertex normals
+  float contour_length{};
+  // Projected area of all faces that face the eye
+  float visible_area{};
+};
+
+// Searches the view sphere for the directions with the highest scores.
+// Views are treated as orthographic and occlusion is ignored.
+// So the measures only depend on the direction and every candidate
+// needs one illumination pass. Lighting is symmetric with respect to
+// the light direction. Hence, the coarse candidates share the pass with
+// their antipodes. Candidates are evaluated in parallel, each thread on
+// its own copy of the illumination data. The best coarse candidates are
+// then refined by hill climbing over their neighbors on the sphere.
+// Returns at most 'count' views sorted by descending score.
+auto search_viewpoints(const mesh_geometry& mesh,
+                       const vector<gradient_info>& gradient_data,
+                       const vertex_face_adjacency& adjacency,
+                       const vector<illumination_info>& illumination_data,
+                       const viewpoint_search_options& options = {})
+    -> vector<viewpoint>;
@@ -7,11 +7,14 @@ constexpr czstring vertex_shader_text =
 
     "uniform mat4 projection;"
     "uniform mat4 view;"
+    "uniform mat4 model = mat4(1.0);"
 
     "layout (location = 0) in vec3 p;"
+    "layout (location = 7) in vec3 offset;"
 
     "void main(){"
-    "  gl_Position = projection * view * vec4(p, 1.0);"
+    "  vec4 x = model * vec4(p, 1.0) + vec4(offset, 0.0);"
+    "  gl_Position = projection * view * x;"
     "}";
 
 constexpr czstring fragment_shader_text =